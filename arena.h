@@ -0,0 +1,132 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <vector>
+#include <new>
+
+// hands out space for objects of T and its subclasses from big chunks, so making one is
+// cheap, they end up next to each other, and the arena destroys whatever's left all at once.
+// deleting an object before that runs its destructor and lets the arena reuse the space.
+template <class T>
+class Arena
+{
+public:
+    Arena() {}
+    ~Arena();
+
+    void * allocate(size_t size);
+    // take back the space of an object that's already been destroyed
+    static void release(void * object);
+
+private:
+    // in front of every object
+    struct Header {
+        size_t size; // including the header
+        Arena * arena; // NULL once the object is destroyed
+    };
+    struct Chunk {
+        char * memory;
+        size_t used;
+        size_t size;
+    };
+    enum { CHUNK_SIZE = 64 * 1024, ALIGNMENT = 8 };
+    static size_t aligned(size_t size) { return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; }
+
+    std::vector<Chunk> m_chunks;
+    // released space, by size in units of ALIGNMENT
+    std::vector<std::vector<Header *> > m_free;
+
+    // copying one would destroy everything twice
+    Arena(const Arena &);
+    Arena & operator=(const Arena &);
+};
+
+template <class T>
+Arena<T>::~Arena() {
+    for (int i = 0; i < (int)m_chunks.size(); i++) {
+        Chunk & chunk = m_chunks[i];
+        for (size_t offset = 0; offset < chunk.used;) {
+            Header * header = (Header *) (chunk.memory + offset);
+            if (header->arena != NULL)
+                ((T *) (chunk.memory + offset + aligned(sizeof(Header))))->~T();
+            offset += header->size;
+        }
+        free(chunk.memory);
+    }
+}
+
+template <class T>
+void * Arena<T>::allocate(size_t size) {
+    size_t total = aligned(sizeof(Header)) + aligned(size);
+    size_t units = total / ALIGNMENT;
+    if (units < m_free.size() && ! m_free[units].empty()) {
+        Header * header = m_free[units].back();
+        m_free[units].pop_back();
+        header->arena = this;
+        return (char *) header + aligned(sizeof(Header));
+    }
+    if (m_chunks.empty() || m_chunks.back().size - m_chunks.back().used < total) {
+        Chunk chunk;
+        chunk.size = total > (size_t)CHUNK_SIZE ? total : (size_t)CHUNK_SIZE;
+        chunk.memory = (char *) malloc(chunk.size);
+        chunk.used = 0;
+        m_chunks.push_back(chunk);
+    }
+    Chunk & chunk = m_chunks.back();
+    Header * header = (Header *) (chunk.memory + chunk.used);
+    header->size = total;
+    header->arena = this;
+    chunk.used += total;
+    return (char *) header + aligned(sizeof(Header));
+}
+
+template <class T>
+void Arena<T>::release(void * object) {
+    if (object == NULL)
+        return;
+    Header * header = (Header *) ((char *) object - aligned(sizeof(Header)));
+    Arena * arena = header->arena;
+    header->arena = NULL;
+    size_t units = header->size / ALIGNMENT;
+    if (units >= arena->m_free.size())
+        arena->m_free.resize(units + 1);
+    arena->m_free[units].push_back(header);
+}
+
+// lets a standard container take the space for its nodes from an Arena, so they sit in
+// its chunks and go away with it. containers using the same arena can splice into each other.
+template <class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+    typedef T * pointer;
+    typedef const T * const_pointer;
+    typedef T & reference;
+    typedef const T & const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+    template <class U> struct rebind { typedef ArenaAllocator<U> other; };
+
+    ArenaAllocator(Arena<char> & arena) : m_arena(&arena) {}
+    template <class U> ArenaAllocator(const ArenaAllocator<U> & other) : m_arena(other.arena()) {}
+
+    pointer allocate(size_type count, const void * = 0) { return (pointer) m_arena->allocate(count * sizeof(T)); }
+    void deallocate(pointer object, size_type) { Arena<char>::release(object); }
+    void construct(pointer object, const T & value) { new ((void *) object) T(value); }
+    void destroy(pointer object) { object->~T(); }
+    pointer address(reference value) const { return &value; }
+    const_pointer address(const_reference value) const { return &value; }
+    size_type max_size() const { return (size_t)-1 / sizeof(T); }
+
+    Arena<char> * arena() const { return m_arena; }
+    template <class U> bool operator==(const ArenaAllocator<U> & other) const { return m_arena == other.arena(); }
+    template <class U> bool operator!=(const ArenaAllocator<U> & other) const { return m_arena != other.arena(); }
+
+private:
+    Arena<char> * m_arena;
+};
+
+#endif // ARENA_H
@@ -0,0 +1,92 @@
+#ifndef BIT_VECTOR_H
+#define BIT_VECTOR_H
+
+#include <cstddef>
+#include <vector>
+
+// a fixed size set of small integers, one bit each
+class BitVector
+{
+public:
+    BitVector() : m_size(0) {}
+    BitVector(int size) : m_words((size + 31) / 32, 0), m_size(size) {}
+
+    int size() const { return m_size; }
+    bool test(int index) const { return (m_words[index / 32] >> (index % 32)) & 1; }
+    void set(int index) { m_words[index / 32] |= 1u << (index % 32); }
+    void reset(int index) { m_words[index / 32] &= ~(1u << (index % 32)); }
+    // turn off every bit
+    void clear();
+    bool any() const;
+
+    // returns whether any bit got turned on
+    bool union_with(const BitVector & other);
+    void subtract(const BitVector & other);
+    void intersect(const BitVector & other);
+
+    // the first bit that's on at or after index, -1 if there isn't one
+    int next(int index) const;
+
+    bool operator==(const BitVector & other) const { return m_words == other.m_words; }
+    bool operator!=(const BitVector & other) const { return m_words != other.m_words; }
+private:
+    std::vector<unsigned int> m_words;
+    int m_size;
+};
+
+// these go through plain pointers so that they're fast without optimization too
+
+inline void BitVector::clear() {
+    unsigned int * words = m_words.empty() ? NULL : &m_words[0];
+    for (int i = 0, count = m_words.size(); i < count; i++)
+        words[i] = 0;
+}
+
+inline bool BitVector::any() const {
+    const unsigned int * words = m_words.empty() ? NULL : &m_words[0];
+    for (int i = 0, count = m_words.size(); i < count; i++) {
+        if (words[i] != 0)
+            return true;
+    }
+    return false;
+}
+
+inline bool BitVector::union_with(const BitVector & other) {
+    unsigned int * words = m_words.empty() ? NULL : &m_words[0];
+    const unsigned int * other_words = other.m_words.empty() ? NULL : &other.m_words[0];
+    unsigned int changed = 0;
+    for (int i = 0, count = m_words.size(); i < count; i++) {
+        changed |= other_words[i] & ~words[i];
+        words[i] |= other_words[i];
+    }
+    return changed != 0;
+}
+
+inline void BitVector::subtract(const BitVector & other) {
+    unsigned int * words = m_words.empty() ? NULL : &m_words[0];
+    const unsigned int * other_words = other.m_words.empty() ? NULL : &other.m_words[0];
+    for (int i = 0, count = m_words.size(); i < count; i++)
+        words[i] &= ~other_words[i];
+}
+
+inline void BitVector::intersect(const BitVector & other) {
+    unsigned int * words = m_words.empty() ? NULL : &m_words[0];
+    const unsigned int * other_words = other.m_words.empty() ? NULL : &other.m_words[0];
+    for (int i = 0, count = m_words.size(); i < count; i++)
+        words[i] &= other_words[i];
+}
+
+inline int BitVector::next(int index) const {
+    if (index >= m_size)
+        return -1;
+    int word_index = index / 32;
+    unsigned int word = m_words[word_index] & (~0u << (index % 32));
+    while (word == 0) {
+        if (++word_index == (int)m_words.size())
+            return -1;
+        word = m_words[word_index];
+    }
+    return word_index * 32 + __builtin_ctz(word);
+}
+
+#endif // BIT_VECTOR_H
@@ -1,6 +1,8 @@
 #include "code_generation.h"
+#include "arena.h"
 #include "insensitive_map.h"
-#include "two_way_map.h"
+#include "dataflow.h"
+#include "interpreter.h"
 #include "utils.h"
 
 #include <vector>
@@ -9,32 +11,91 @@
 #include <iostream>
 #include <list>
 #include <sstream>
+#include <algorithm>
+#include <ctime>
+#include <iomanip>
+#include <cstring>
 
 int g_next_unique_label = 0;
 int getNextUniqueLabel() {
     return g_next_unique_label++;
 }
 int get_class_size_in_bytes(std::string class_name, SymbolTable *symbol_table);
+void print_class_layout(std::ostream & out, std::string class_name, SymbolTable * symbol_table);
+void insert_class_pointer_offsets(std::string class_name, SymbolTable * symbol_table, std::vector<int> & pointer_offsets);
+void print_garbage_collector(std::ostream & out);
+
+// every heap block starts with the address of its layout (with the mark bit in bit 0) and its size
+const int heap_header_size = 8;
+// how much memory the program asks for when it starts. the heap grows from there in chunks from sbrk.
+const int initial_heap_size = 64 * 1024;
+int get_array_size_in_bytes(ArrayType * array_type);
+int get_array_element_size_in_bytes(ArrayType * array_type);
+// quotes and backslashes escaped, the same way for both graphviz and JSON
+std::string escaped(std::string text);
+std::string quoted(std::string text);
 
 class MethodGenerator {
 public:
-    MethodGenerator(std::string class_name, FunctionDeclaration * function_declaration, SymbolTable * symbol_table) :
+    MethodGenerator(std::string class_name, FunctionDeclaration * function_declaration, SymbolTable * symbol_table, bool bounds_check) :
         m_register_count(0),
         m_class_name(class_name),
         m_function_declaration(function_declaration),
-        m_symbol_table(symbol_table) {}
+        m_symbol_table(symbol_table),
+        m_bounds_check(bounds_check),
+        m_stack_allocation_size(0),
+        m_work(0),
+        m_work_limit(0),
+        m_deadline(0) {}
     void generate();
     void build_basic_blocks();
-    void value_numbering();
-    void calculate_mangle_sets();
     void dependency_management();
+    void loop_invariant_code_motion();
+    // give every register exactly one assignment, merging values with phis where control flow meets
+    void construct_ssa();
+    // turn the phis back into copies, sharing registers wherever that makes the copies go away
+    void destruct_ssa();
+    // in ssa form, find registers that are always the same constant and branches that always go
+    // the same way, following only the paths that can actually happen. the rest of the blocks go away.
+    void sparse_conditional_constant_propagation();
+    // in ssa form, reuse values computed in dominating blocks and fold constants
+    void global_value_numbering();
+    // in ssa form, remove the array bounds checks that can never fail
+    void bounds_check_elimination();
+    // in ssa form, turn multiplications by loop counters into additions every time around the loop,
+    // and test those instead of the counter when we can
+    void induction_variable_strength_reduction();
     void block_deletion();
+    // put objects and arrays that never leave this method in its stack frame instead of on the heap
+    void stack_allocation();
     void compute_addresses();
     void compress_registers();
+    // what's left of the method, for the pass statistics
+    int instruction_count();
+    int block_count();
+    // the passes that go a loop at a time count the whole method as work for each loop, and skip
+    // the rest of the loops once that gets past work_limit or clock() gets past deadline. 0 for never.
+    void set_budget(long long work_limit, clock_t deadline) { m_work = 0; m_work_limit = work_limit; m_deadline = deadline; }
+    long long work() { return m_work; }
+
+    // insert the (class, method) pairs this method calls into the list
+    void insert_called_methods(std::list<std::pair<std::string, std::string> > & called_methods);
+    // insert the lowercase names of the classes this method makes objects of
+    void insert_allocated_classes(std::set<std::string> & allocated_classes);
+    // everything that determines the generated code except the method's name.
+    // methods with equal fingerprints can share one body.
+    std::string fingerprint();
 
     void print_basic_blocks(std::ostream & out);
     void print_control_flow_graph(std::ostream & out);
+    // one graphviz cluster per method, a node per block, an edge per edge
+    void print_control_flow_dot(std::ostream & out, std::string label);
+    void print_ir_json(std::ostream & out, std::string label);
     void print_assembly(std::ostream & out);
+    // where this method's frame keeps pointers, for the garbage collector
+    void print_frame_layout(std::ostream & out, std::string label);
+    // the finished method, flattened out for -run-ir
+    void translate(IrMethod & method, std::string label);
 
 private:
     struct Instruction {
@@ -52,16 +113,42 @@ private:
             WRITE_POINTER,
             READ_POINTER,
             ALLOCATE_ARRAY,
+            PHI,
+            BOUNDS_CHECK,
         };
         Type type;
 
         Instruction(Type type) : type(type) {}
+        virtual ~Instruction() {}
+        // instructions live in their method's arena. delete still runs the destructor;
+        // the space comes back when the method generator goes away.
+        void * operator new(size_t size, Arena<Instruction> & arena) { return arena.allocate(size); }
+        void operator delete(void * instruction) { Arena<Instruction>::release(instruction); }
+        void operator delete(void * instruction, Arena<Instruction> &) { Arena<Instruction>::release(instruction); }
         // insert the indexes registers you read (rvalues) in this instruction
         virtual void insertReadRegisters(std::set<int> & used_list) = 0;
         // insert the indexes registers you mangle (lvalues) in this instruction
         virtual void insertMangledRegisters(std::set<int> & mangled_list) = 0;
-        // remap the register indexes used to a new value based on a vector lookup
-        virtual void remapRegisters(std::vector<int> & map) = 0;
+        // remap the register indexes you read to new values based on a vector lookup
+        virtual void remapReadRegisters(std::vector<int> & map) = 0;
+        // remap the register indexes you mangle to new values based on a vector lookup
+        virtual void remapMangledRegisters(std::vector<int> & map) = 0;
+        // remap every register index used
+        void remapRegisters(std::vector<int> & map) {
+            remapReadRegisters(map);
+            remapMangledRegisters(map);
+        }
+        // the dataflow passes call these for every instruction, so the common
+        // instructions skip the std::set
+        // set the bits of the registers you read in this instruction
+        virtual void setReadRegisters(BitVector & used_bits) {
+            std::set<int> used_list;
+            insertReadRegisters(used_list);
+            for (std::set<int>::iterator it = used_list.begin(); it != used_list.end(); ++it)
+                used_bits.set(*it);
+        }
+        // the register you mangle in this instruction, -1 if none. there's never more than one.
+        virtual int mangledRegister() { return -1; }
 
         virtual void print(std::ostream & out) = 0;
     };
@@ -70,7 +157,6 @@ private:
     public:
         enum Type {
             REGISTER, // int
-            VALUE_NUMBER, // string
             CONST_INT, // int
             CONST_BOOL, // bool
             CONST_REAL, // float
@@ -81,37 +167,37 @@ private:
             bool _bool;
             float _float;
         };
-        std::string _string;
 
-        // don't use this, stupid face
-        Variant(){}
+        // don't use this, stupid face. it's only here for containers and values that get assigned later,
+        // and it's 0 so copying one around is never reading garbage.
+        Variant() : type(CONST_INT), _int(0) {}
         Variant(int _int, Type type) : type(type), _int(_int) {}
         Variant(bool _bool) : type(CONST_BOOL), _bool(_bool) {}
         Variant(float _float) : type(CONST_REAL), _float(_float) {}
-        Variant(std::string _string) : type(VALUE_NUMBER), _string(_string) {}
 
-        std::string str() {
-            std::stringstream ss;
+        void print(std::ostream & out) const {
             switch (type) {
                 case REGISTER:
-                    ss << "$" << _int;
-                    break;
-                case VALUE_NUMBER:
-                    ss << _string;
+                    out << "$" << _int;
                     break;
                 case CONST_INT:
-                    ss << _int;
+                    out << _int;
                     break;
                 case CONST_BOOL:
-                    ss << (_bool ? "true" : "false");
+                    out << (_bool ? "true" : "false");
                     break;
                 case CONST_REAL:
-                    ss.setf(std::ios::showpoint);
-                    ss << _float;
-                    ss.unsetf(std::ios::showpoint);
+                    out.setf(std::ios::showpoint);
+                    out << _float;
+                    out.unsetf(std::ios::showpoint);
                     break;
             }
-            return ss.str();
+        }
+        // straight into the stream. the assembly has one of these in a comment for every operand,
+        // and building a string for each one took most of the time at -O0.
+        friend std::ostream & operator<<(std::ostream & out, const Variant & value) {
+            value.print(out);
+            return out;
         }
 
         bool operator< (Variant right) const {
@@ -126,8 +212,6 @@ private:
                     return _bool < right._bool;
                 case CONST_REAL: // float
                     return _float < right._float;
-                case VALUE_NUMBER: // string
-                    return _string < right._string;
                 }
             }
             assert(false);
@@ -146,8 +230,6 @@ private:
                     return _bool == right._bool;
                 case CONST_REAL: // float
                     return _float == right._float;
-                case VALUE_NUMBER: // string
-                    return _string == right._string;
                 }
             }
             assert(false);
@@ -174,16 +256,17 @@ private:
 
         virtual void insertMangledRegisters(std::set<int> &mangled_list) {}
 
-        virtual void remapRegisters(std::vector<int> & map) {
+        void remapReadRegisters(std::vector<int> & map) {
             for (int i = 0; i < (int)parameters.size(); i++)
                 if (parameters[i].type == Variant::REGISTER)
                     parameters[i]._int = map[parameters[i]._int];
         }
+        virtual void remapMangledRegisters(std::vector<int> & map) {}
         virtual void print(std::ostream &out) {
             out << class_name << "::" << method_name << "(";
-            out << parameters[0].str();
+            out << parameters[0];
             for (int i=1; i<(int)parameters.size(); ++i) {
-                out << ", " << parameters[i].str();
+                out << ", " << parameters[i];
             }
             out << ")";
         }
@@ -196,16 +279,18 @@ private:
             this->type = NON_VOID_METHOD_CALL;
         }
 
-        void remapRegisters(std::vector<int> &map) {
+        void remapMangledRegisters(std::vector<int> &map) {
             dest._int = map[dest._int];
-            MethodCallInstruction::remapRegisters(map);
         }
         void insertMangledRegisters(std::set<int> &mangled_list) {
             if (dest.type == Variant::REGISTER)
                 mangled_list.insert(dest._int);
         }
+        int mangledRegister() {
+            return dest.type == Variant::REGISTER ? dest._int : -1;
+        }
         void print(std::ostream &out) {
-            out << dest.str() << " = ";
+            out << dest << " = ";
             MethodCallInstruction::print(out);
         }
     };
@@ -219,20 +304,30 @@ private:
             if (source.type == Variant::REGISTER)
                 used_list.insert(source._int);
         }
+        void setReadRegisters(BitVector & used_bits) {
+            if (source.type == Variant::REGISTER)
+                used_bits.set(source._int);
+        }
 
         void insertMangledRegisters(std::set<int> & mangled_list) {
             if (dest.type == Variant::REGISTER)
                 mangled_list.insert(dest._int);
         }
+        int mangledRegister() {
+            return dest.type == Variant::REGISTER ? dest._int : -1;
+        }
 
-        void remapRegisters(std::vector<int> & map) {
-            if (dest.type == Variant::REGISTER)
-                dest._int = map[dest._int];
+        void remapReadRegisters(std::vector<int> & map) {
             if (source.type == Variant::REGISTER)
                 source._int = map[source._int];
         }
+
+        void remapMangledRegisters(std::vector<int> & map) {
+            if (dest.type == Variant::REGISTER)
+                dest._int = map[dest._int];
+        }
         void print(std::ostream &out) {
-            out << dest.str() << " = " << source.str();
+            out << dest << " = " << source;
         }
     };
 
@@ -251,11 +346,6 @@ private:
         OperatorInstruction(Variant dest, Variant left, Operator _operator, Variant right) :
             Instruction(OPERATOR), dest(dest), left(left), _operator(_operator), right(right) {}
 
-        std::string str() {
-            std::stringstream ss;
-            ss << dest.str() << " = " << left.str() << " " << operator_str() << " " << right.str();
-            return ss.str();
-        }
 
         std::string operator_str() {
             switch (_operator) {
@@ -297,22 +387,34 @@ private:
             if (right.type == Variant::REGISTER)
                 used_list.insert(right._int);
         }
+        void setReadRegisters(BitVector & used_bits) {
+            if (left.type == Variant::REGISTER)
+                used_bits.set(left._int);
+            if (right.type == Variant::REGISTER)
+                used_bits.set(right._int);
+        }
 
         void insertMangledRegisters(std::set<int> & mangled_list) {
             if (dest.type == Variant::REGISTER)
                 mangled_list.insert(dest._int);
         }
+        int mangledRegister() {
+            return dest.type == Variant::REGISTER ? dest._int : -1;
+        }
 
-        void remapRegisters(std::vector<int> & map) {
-            if (dest.type == Variant::REGISTER)
-                dest._int = map[dest._int];
+        void remapReadRegisters(std::vector<int> & map) {
             if (left.type == Variant::REGISTER)
                 left._int = map[left._int];
             if (right.type == Variant::REGISTER)
                 right._int = map[right._int];
         }
+
+        void remapMangledRegisters(std::vector<int> & map) {
+            if (dest.type == Variant::REGISTER)
+                dest._int = map[dest._int];
+        }
         void print(std::ostream &out) {
-            out << str();
+            out << dest << " = " << left << " " << operator_str() << " " << right;
         }
     };
 
@@ -333,28 +435,38 @@ private:
             if (source.type == Variant::REGISTER)
                 used_list.insert(source._int);
         }
+        void setReadRegisters(BitVector & used_bits) {
+            if (source.type == Variant::REGISTER)
+                used_bits.set(source._int);
+        }
 
         void insertMangledRegisters(std::set<int> & mangled_list) {
             if (dest.type == Variant::REGISTER)
                 mangled_list.insert(dest._int);
         }
+        int mangledRegister() {
+            return dest.type == Variant::REGISTER ? dest._int : -1;
+        }
 
 
-        void remapRegisters(std::vector<int> & map) {
-            if (dest.type == Variant::REGISTER)
-                dest._int = map[dest._int];
+        void remapReadRegisters(std::vector<int> & map) {
             if (source.type == Variant::REGISTER)
                 source._int = map[source._int];
         }
+
+        void remapMangledRegisters(std::vector<int> & map) {
+            if (dest.type == Variant::REGISTER)
+                dest._int = map[dest._int];
+        }
         void print(std::ostream &out) {
-            out << dest.str() << " = ";
+            out << dest << " = ";
             if (_operator == UnaryInstruction::NEGATE)
                 out << "-";
             else if (_operator == UnaryInstruction::NOT)
                 out << "!";
             else
                 assert(false);
-            out << source.str();
+            out << source;
         }
     };
 
@@ -368,15 +480,20 @@ private:
             if (condition.type == Variant::REGISTER)
                 used_list.insert(condition._int);
         }
+        void setReadRegisters(BitVector & used_bits) {
+            if (condition.type == Variant::REGISTER)
+                used_bits.set(condition._int);
+        }
 
         void insertMangledRegisters(std::set<int> & mangled_list) {}
 
-        void remapRegisters(std::vector<int> & map) {
+        void remapReadRegisters(std::vector<int> & map) {
             if (condition.type == Variant::REGISTER)
                 condition._int = map[condition._int];
         }
+        void remapMangledRegisters(std::vector<int> & map) {}
         void print(std::ostream &out) {
-            out << "if !" << condition.str() << " goto " << goto_index;
+            out << "if !" << condition << " goto " << goto_index;
         }
     };
 
@@ -387,20 +504,33 @@ private:
 
         void insertReadRegisters(std::set<int> & used_list) {}
         void insertMangledRegisters(std::set<int> & mangled_list) {}
-        void remapRegisters(std::vector<int> & map) {}
+        void remapReadRegisters(std::vector<int> & map) {}
+        void remapMangledRegisters(std::vector<int> & map) {}
         void print(std::ostream &out) {
             out << "goto " << goto_index;
         }
     };
 
     struct ReturnInstruction : public Instruction {
-        ReturnInstruction() : Instruction(RETURN) {}
+        bool has_value;
+        Variant value; // what goes in $v0, if has_value
+        ReturnInstruction() : Instruction(RETURN), has_value(false) {}
+        ReturnInstruction(Variant value) : Instruction(RETURN), has_value(true), value(value) {}
 
-        void insertReadRegisters(std::set<int> & used_list) {}
+        void insertReadRegisters(std::set<int> & used_list) {
+            if (has_value && value.type == Variant::REGISTER)
+                used_list.insert(value._int);
+        }
         void insertMangledRegisters(std::set<int> & mangled_list) {}
-        void remapRegisters(std::vector<int> & map) {}
+        void remapReadRegisters(std::vector<int> & map) {
+            if (has_value && value.type == Variant::REGISTER)
+                value._int = map[value._int];
+        }
+        void remapMangledRegisters(std::vector<int> & map) {}
         void print(std::ostream &out) {
             out << "return";
+            if (has_value)
+                out << " " << value;
         }
     };
 
@@ -412,22 +542,29 @@ private:
             if (value.type == Variant::REGISTER)
                 used_list.insert(value._int);
         }
+        void setReadRegisters(BitVector & used_bits) {
+            if (value.type == Variant::REGISTER)
+                used_bits.set(value._int);
+        }
 
         void insertMangledRegisters(std::set<int> & mangled_list) {}
 
-        void remapRegisters(std::vector<int> & map) {
+        void remapReadRegisters(std::vector<int> & map) {
             if (value.type == Variant::REGISTER)
                 value._int = map[value._int];
         }
+        void remapMangledRegisters(std::vector<int> & map) {}
         void print(std::ostream &out) {
-            out << "print " << value.str();
+            out << "print " << value;
         }
     };
 
     struct AllocateObjectInstruction : public Instruction {
         Variant dest;
         std::string class_name;
-        AllocateObjectInstruction(Variant dest, std::string class_name) : Instruction(ALLOCATE_OBJECT), dest(dest), class_name(class_name) {}
+        // where in the frame it goes, or -1 for the heap
+        int stack_offset;
+        AllocateObjectInstruction(Variant dest, std::string class_name) : Instruction(ALLOCATE_OBJECT), dest(dest), class_name(class_name), stack_offset(-1) {}
 
         void insertReadRegisters(std::set<int> & used_list) {}
 
@@ -435,13 +572,20 @@ private:
             if (dest.type == Variant::REGISTER)
                 mangled_list.insert(dest._int);
         }
+        int mangledRegister() {
+            return dest.type == Variant::REGISTER ? dest._int : -1;
+        }
 
-        void remapRegisters(std::vector<int> & map) {
+        void remapReadRegisters(std::vector<int> & map) {}
+
+        void remapMangledRegisters(std::vector<int> & map) {
             if (dest.type == Variant::REGISTER)
                 dest._int = map[dest._int];
         }
         void print(std::ostream &out) {
-            out << dest.str() << " = new " << class_name;
+            out << dest << " = new " << class_name;
+            if (stack_offset != -1)
+                out << " at $sp+" << stack_offset;
         }
     };
 
@@ -456,17 +600,24 @@ private:
             if (pointer.type == Variant::REGISTER)
                 used_list.insert(pointer._int);
         }
+        void setReadRegisters(BitVector & used_bits) {
+            if (source.type == Variant::REGISTER)
+                used_bits.set(source._int);
+            if (pointer.type == Variant::REGISTER)
+                used_bits.set(pointer._int);
+        }
 
         void insertMangledRegisters(std::set<int> & mangled_list) {}
 
-        void remapRegisters(std::vector<int> & map) {
+        void remapReadRegisters(std::vector<int> & map) {
             if (pointer.type == Variant::REGISTER)
                 pointer._int = map[pointer._int];
             if (source.type == Variant::REGISTER)
                 source._int = map[source._int];
         }
+        void remapMangledRegisters(std::vector<int> & map) {}
         void print(std::ostream &out) {
-            out << "*" << pointer.str() << " = " << source.str();
+            out << "*" << pointer << " = " << source;
         }
     };
 
@@ -479,20 +630,30 @@ private:
             if (source_pointer.type == Variant::REGISTER)
                 used_list.insert(source_pointer._int);
         }
+        void setReadRegisters(BitVector & used_bits) {
+            if (source_pointer.type == Variant::REGISTER)
+                used_bits.set(source_pointer._int);
+        }
 
         void insertMangledRegisters(std::set<int> & mangled_list) {
             if (dest.type == Variant::REGISTER)
                 mangled_list.insert(dest._int);
         }
+        int mangledRegister() {
+            return dest.type == Variant::REGISTER ? dest._int : -1;
+        }
 
-        void remapRegisters(std::vector<int> & map) {
-            if (dest.type == Variant::REGISTER)
-                dest._int = map[dest._int];
+        void remapReadRegisters(std::vector<int> & map) {
             if (source_pointer.type == Variant::REGISTER)
                 source_pointer._int = map[source_pointer._int];
         }
+
+        void remapMangledRegisters(std::vector<int> & map) {
+            if (dest.type == Variant::REGISTER)
+                dest._int = map[dest._int];
+        }
         void print(std::ostream &out) {
-            out << dest.str() << " = *" << source_pointer.str();
+            out << dest << " = *" << source_pointer;
         }
     };
 
@@ -500,7 +661,12 @@ private:
     struct AllocateArrayInstruction : public Instruction {
         Variant dest;
         int size; // bytes
-        AllocateArrayInstruction(Variant dest, int size) : Instruction(ALLOCATE_ARRAY), dest(dest), size(size) {}
+        // whether the elements are pointers the garbage collector has to follow
+        bool references;
+        // where in the frame it goes, or -1 for the heap
+        int stack_offset;
+        AllocateArrayInstruction(Variant dest, int size, bool references) :
+            Instruction(ALLOCATE_ARRAY), dest(dest), size(size), references(references), stack_offset(-1) {}
 
         void insertReadRegisters(std::set<int> & used_list) {}
 
@@ -508,16 +674,100 @@ private:
             if (dest.type == Variant::REGISTER)
                 mangled_list.insert(dest._int);
         }
+        int mangledRegister() {
+            return dest.type == Variant::REGISTER ? dest._int : -1;
+        }
 
-        void remapRegisters(std::vector<int> & map) {
+        void remapReadRegisters(std::vector<int> & map) {}
+
+        void remapMangledRegisters(std::vector<int> & map) {
+            if (dest.type == Variant::REGISTER)
+                dest._int = map[dest._int];
+        }
+        void print(std::ostream &out) {
+            out << dest << " = new " << (references ? "pointer" : "byte") << "[" << size << "]";
+            if (stack_offset != -1)
+                out << " at $sp+" << stack_offset;
+        }
+    };
+
+
+    // stop the program with an error if index isn't in min..max
+    struct BoundsCheckInstruction : public Instruction {
+        Variant index;
+        int min;
+        int max;
+        int line_number;
+
+        BoundsCheckInstruction(Variant index, int min, int max, int line_number) :
+            Instruction(BOUNDS_CHECK), index(index), min(min), max(max), line_number(line_number) {}
+
+        void insertReadRegisters(std::set<int> & used_list) {
+            if (index.type == Variant::REGISTER)
+                used_list.insert(index._int);
+        }
+        void setReadRegisters(BitVector & used_bits) {
+            if (index.type == Variant::REGISTER)
+                used_bits.set(index._int);
+        }
+
+        void insertMangledRegisters(std::set<int> & mangled_list) {}
+
+        void remapReadRegisters(std::vector<int> & map) {
+            if (index.type == Variant::REGISTER)
+                index._int = map[index._int];
+        }
+        void remapMangledRegisters(std::vector<int> & map) {}
+        void print(std::ostream &out) {
+            out << "check " << index << " in " << min << ".." << max << " on line " << line_number;
+        }
+    };
+
+    // only exists in ssa form. always at the start of a block.
+    struct PhiInstruction : public Instruction {
+        Variant dest;
+        // the value to use when arriving from each parent (indexes in m_basic_blocks)
+        std::vector<int> parents;
+        std::vector<Variant> sources;
+        PhiInstruction(Variant dest) : Instruction(PHI), dest(dest) {}
+
+        void insertReadRegisters(std::set<int> & used_list) {
+            for (int i = 0; i < (int)sources.size(); i++)
+                if (sources[i].type == Variant::REGISTER)
+                    used_list.insert(sources[i]._int);
+        }
+
+        void insertMangledRegisters(std::set<int> & mangled_list) {
+            if (dest.type == Variant::REGISTER)
+                mangled_list.insert(dest._int);
+        }
+        int mangledRegister() {
+            return dest.type == Variant::REGISTER ? dest._int : -1;
+        }
+
+        void remapReadRegisters(std::vector<int> & map) {
+            for (int i = 0; i < (int)sources.size(); i++)
+                if (sources[i].type == Variant::REGISTER)
+                    sources[i]._int = map[sources[i]._int];
+        }
+
+        void remapMangledRegisters(std::vector<int> & map) {
             if (dest.type == Variant::REGISTER)
                 dest._int = map[dest._int];
         }
         void print(std::ostream &out) {
-            out << dest.str() << " = new byte[" << size << "]";
+            out << dest << " = phi(";
+            for (int i = 0; i < (int)sources.size(); i++) {
+                if (i > 0)
+                    out << ", ";
+                out << "block_" << parents[i] << ": " << sources[i];
+            }
+            out << ")";
         }
     };
 
+    // a block's instructions. the list nodes come from the method's node arena, not malloc.
+    typedef std::list<Instruction *, ArenaAllocator<Instruction *> > InstructionList;
 
     struct BasicBlock {
         // indexes in m_instructions
@@ -527,19 +777,229 @@ private:
         int jump_child;
         int fallthrough_child;
         std::set<int> parents;
-        std::list<Instruction *> instructions;
-        std::set<int> mangled_registers;
-        std::set<int> used_registers;
-
-        // for detecting loops during mangle set calculations
-        bool is_destination;
-        bool is_source;
+        InstructionList instructions;
 
         bool deleted;
-        // maps registers to value number/ constant
-        TwoWayMap<int, Variant> value_numbers;
 
-        BasicBlock(int start, int end) : start(start), end(end), is_destination(false), is_source(false), deleted(false) {}
+        BasicBlock(int start, int end, Arena<char> & node_arena) : start(start), end(end), instructions(node_arena), deleted(false) {}
+        void * operator new(size_t size, Arena<BasicBlock> & arena) { return arena.allocate(size); }
+        void operator delete(void * block) { Arena<BasicBlock>::release(block); }
+        void operator delete(void * block, Arena<BasicBlock> &) { Arena<BasicBlock>::release(block); }
+    };
+
+    // an operator or unary instruction, in terms of value numbers
+    struct ValueExpression {
+        int type;
+        int _operator;
+        int left;
+        int right; // -1 for unary
+        ValueExpression() {}
+        ValueExpression(int type, int _operator, int left, int right) : type(type), _operator(_operator), left(left), right(right) {}
+
+        bool operator== (const ValueExpression & other) const {
+            return type == other.type && _operator == other._operator && left == other.left && right == other.right;
+        }
+        unsigned int hash() const {
+            unsigned int hash = type;
+            hash = hash * 31 + _operator;
+            hash = hash * 0x9e3779b1 + left;
+            hash = hash * 0x9e3779b1 + right;
+            return hash ^ (hash >> 15);
+        }
+    };
+
+    // value number of each expression. open addressing, so that looking up every
+    // instruction in value numbering doesn't allocate anything.
+    class ExpressionTable {
+    public:
+        ExpressionTable() : m_slots(64), m_count(0) {}
+
+        // -1 if it's not in there
+        int find(const ValueExpression & expression) {
+            int mask = m_slots.size() - 1;
+            for (int i = expression.hash() & mask; m_slots[i].value != -1; i = (i + 1) & mask) {
+                if (m_slots[i].expression == expression)
+                    return m_slots[i].value;
+            }
+            return -1;
+        }
+        void insert(const ValueExpression & expression, int value) {
+            if ((m_count + 1) * 2 > (int)m_slots.size())
+                grow();
+            int mask = m_slots.size() - 1;
+            int i = expression.hash() & mask;
+            for (; m_slots[i].value != -1; i = (i + 1) & mask) {
+                if (m_slots[i].expression == expression) {
+                    m_slots[i].value = value;
+                    return;
+                }
+            }
+            m_slots[i].expression = expression;
+            m_slots[i].value = value;
+            m_count++;
+        }
+        void erase(const ValueExpression & expression) {
+            int mask = m_slots.size() - 1;
+            int i = expression.hash() & mask;
+            for (; m_slots[i].value != -1; i = (i + 1) & mask) {
+                if (m_slots[i].expression == expression)
+                    break;
+            }
+            if (m_slots[i].value == -1)
+                return;
+            // pull back anything after it that would have been found here, so the
+            // empty slot doesn't cut a search short
+            for (int j = (i + 1) & mask; m_slots[j].value != -1; j = (j + 1) & mask) {
+                int home = m_slots[j].expression.hash() & mask;
+                if (((j - home) & mask) >= ((j - i) & mask)) {
+                    m_slots[i] = m_slots[j];
+                    i = j;
+                }
+            }
+            m_slots[i].value = -1;
+            m_count--;
+        }
+    private:
+        struct Slot {
+            ValueExpression expression;
+            int value; // -1 for empty
+            Slot() : value(-1) {}
+        };
+        // always a power of 2, and at most half full
+        std::vector<Slot> m_slots;
+        int m_count;
+
+        void grow() {
+            std::vector<Slot> old_slots(m_slots.size() * 2);
+            old_slots.swap(m_slots);
+            m_count = 0;
+            for (int i = 0; i < (int)old_slots.size(); i++) {
+                if (old_slots[i].value != -1)
+                    insert(old_slots[i].expression, old_slots[i].value);
+            }
+        }
+    };
+
+    // what global_value_numbering knows so far
+    struct ValueNumbers {
+        // value number of each register, -1 until we get to its assignment
+        std::vector<int> register_value;
+        // for each value number, the constant or register to use for it. the register
+        // is always assigned in a block that dominates everywhere the value is available.
+        std::vector<Variant> leader;
+        std::map<Variant, int> constant_value;
+        // expressions computed in the dominator tree above us
+        ExpressionTable expression_value;
+    };
+
+    // what sparse_conditional_constant_propagation knows about a register
+    struct LatticeValue {
+        enum State {
+            UNKNOWN, // no assignment to it has run yet
+            CONSTANT,
+            VARYING,
+        };
+        State state;
+        Variant constant;
+
+        LatticeValue() : state(UNKNOWN) {}
+        LatticeValue(State state) : state(state) {}
+        LatticeValue(Variant constant) : state(CONSTANT), constant(constant) {}
+    };
+
+    // registers that destruct_ssa has decided can share a stack slot
+    struct RegisterClasses {
+        std::vector<int> representative;
+        std::vector<std::set<int> > members;
+        // every register that some member is live at the same time as
+        std::vector<std::set<int> > interference;
+    };
+
+    // the smallest and largest values a register can have, as far as bounds_check_elimination can tell
+    struct ValueRange {
+        long long min;
+        long long max;
+
+        ValueRange(long long min, long long max) : min(min), max(max) {}
+    };
+
+    // what bounds_check_elimination needs to know about the whole method
+    struct RangeAnalysis {
+        std::vector<int> immediate_dominator;
+        std::vector<std::vector<int> > dominator_children;
+        // the instruction that assigns each register and its block, or NULL and -1
+        std::vector<Instruction *> definitions;
+        std::vector<int> definition_block;
+        // the range that the checks dominating where we are have made sure of
+        std::map<Variant, ValueRange> checked;
+    };
+
+    // a register that is always scale * basic + offset inside a loop, where basic
+    // is a phi in the header that goes up by the same constant every time around
+    struct InductionVariable {
+        int basic;
+        int scale;
+        Variant offset; // available at the end of the block in front of the header
+        int reduced; // the header phi that replaced it, or -1
+
+        InductionVariable() {}
+        InductionVariable(int basic, int scale, Variant offset) : basic(basic), scale(scale), offset(offset), reduced(-1) {}
+    };
+
+    // which registers are live at the top and bottom of each block. only registers that
+    // are live across some block boundary get a bit, so big methods don't need huge sets.
+    struct Liveness {
+        // the register for each bit
+        std::vector<int> registers;
+        // the bit for each register, or -1
+        std::vector<int> bits;
+        std::vector<BitVector> in;
+        std::vector<BitVector> out;
+
+        bool is_live_in(int block_index, int register_index) {
+            return bits[register_index] != -1 && in[block_index].test(bits[register_index]);
+        }
+        // live is indexed by register, and has to be big enough for all of them
+        void get_live_in(int block_index, BitVector & live) { expand(in[block_index], live); }
+        void get_live_out(int block_index, BitVector & live) { expand(out[block_index], live); }
+        void expand(BitVector & bits, BitVector & live) {
+            live.clear();
+            for (int bit = bits.next(0); bit != -1; bit = bits.next(bit + 1))
+                live.set(registers[bit]);
+        }
+    };
+
+    // an assignment to a register, for reaching definitions
+    struct Definition {
+        Instruction * instruction;
+        int register_index;
+        int block_index;
+        Definition(Instruction * instruction, int register_index, int block_index) :
+            instruction(instruction), register_index(register_index), block_index(block_index) {}
+    };
+
+    struct Loop {
+        // index in m_basic_blocks of the only block entered from outside the loop
+        int header;
+        // indexes in m_basic_blocks, including the header
+        std::set<int> blocks;
+    };
+
+    // dominators and loops of the control flow graph, worked out the first time a pass asks
+    // and kept until something changes the edges
+    struct ControlFlow {
+        bool valid;
+        // -1 for the entry and for blocks that can't be reached
+        std::vector<int> immediate_dominator;
+        // only the blocks that can be reached, entry first
+        std::vector<int> reverse_postorder;
+        std::vector<std::vector<int> > dominator_children;
+        // in reverse postorder of their headers
+        std::vector<Loop> loops;
+        // index in loops of the next loop out from each loop, or -1
+        std::vector<int> loop_parent;
+
+        ControlFlow() : valid(false) {}
     };
 
     enum RegisterType {
@@ -549,18 +1009,31 @@ private:
         POINTER,
     };
 
-    typedef std::list<Instruction *> InstructionList;
+    // everything the instructions and blocks below point to. the blocks give their
+    // list nodes back to m_node_arena when they go, so it has to outlive them.
+    Arena<Instruction> m_instruction_arena;
+    Arena<char> m_node_arena;
+    Arena<BasicBlock> m_block_arena;
 
     std::vector<Instruction *> m_instructions;
     OrderedInsensitiveMap<Variant> m_variable_numbers;
     int m_register_count;
-    int m_unique_value_count;
     std::vector<BasicBlock *> m_basic_blocks;
     std::string m_class_name;
     FunctionDeclaration * m_function_declaration;
 
     std::vector<RegisterType> m_register_type;
     SymbolTable * m_symbol_table;
+    // check array indexes at run time
+    bool m_bounds_check;
+    // the space stack_allocation took in the frame between the return address and the registers,
+    // and where in there the garbage collector has to look for pointers
+    int m_stack_allocation_size;
+    std::vector<int> m_stack_pointer_offsets;
+    ControlFlow m_control_flow;
+    long long m_work;
+    long long m_work_limit;
+    clock_t m_deadline;
 
 private:
     Variant next_available_register(RegisterType type);
@@ -576,39 +1049,81 @@ private:
     Variant gen_primary_expression(PrimaryExpression * primary_expression);
     Variant gen_variable_access(VariableAccess * variable);
     Variant gen_initialize_array(TypeDenoter * type);
+    void gen_copy_array(Variant dest_pointer, Variant source_pointer, ArrayType * array_type);
 
     void gen_assignment(VariableAccess * variable, Variant source);
     void link_parent_and_child(int parent_index, int jump_child, int fallthrough_child);
 
     void print_instruction(std::ostream & out, int address, Instruction * instruction);
+    // the pieces of fingerprint()
+    void write_fingerprint(std::ostream & out, Variant value);
+    void write_fingerprint(std::ostream & out, std::string text);
+    void write_fingerprint(std::ostream & out, Instruction * instruction);
 
-    Variant get_value_number(BasicBlock * block, Variant register_or_const);
-    Variant inline_value(BasicBlock * block, Variant register_or_const);
-    Instruction * constant_folded(BasicBlock * block, OperatorInstruction * instruction);
+    Instruction * constant_folded(OperatorInstruction * instruction);
 
-    CopyInstruction * make_copy(BasicBlock * block, OperatorInstruction * operator_instruction);
+    CopyInstruction * make_copy(OperatorInstruction * operator_instruction);
     bool operands_same(OperatorInstruction * instruction);
     bool right_constant_is(OperatorInstruction * instruction, int constant);
     bool left_constant_is(OperatorInstruction * instruction, int constant);
-    CopyInstruction * make_immediate(BasicBlock * block, OperatorInstruction * operator_instruction, int constant);
-    CopyInstruction * make_immediate(BasicBlock * block, OperatorInstruction * operator_instruction, float constant);
-    CopyInstruction * make_immediate(BasicBlock * block, OperatorInstruction * operator_instruction, bool constant);
-    CopyInstruction * make_immediate(BasicBlock * block, UnaryInstruction * operator_instruction, int constant);
-    CopyInstruction * make_immediate(BasicBlock * block, UnaryInstruction * operator_instruction, float constant);
-    CopyInstruction * make_immediate(BasicBlock * block, UnaryInstruction * operator_instruction, bool constant);
-    CopyInstruction * constant_expression_evaluated(BasicBlock * block, OperatorInstruction * operator_instruction);
-    CopyInstruction * constant_expression_evaluated(BasicBlock * block, UnaryInstruction * operator_instruction);
-    std::string next_unique_value();
-    std::string hash_operator_instruction(BasicBlock * block, OperatorInstruction * instruction);
-    void basic_block_value_numbering(BasicBlock * block);
-    std::string hash_operand(BasicBlock * block, Variant operand);
+    CopyInstruction * make_immediate(OperatorInstruction * operator_instruction, int constant);
+    CopyInstruction * make_immediate(OperatorInstruction * operator_instruction, float constant);
+    CopyInstruction * make_immediate(OperatorInstruction * operator_instruction, bool constant);
+    CopyInstruction * make_immediate(UnaryInstruction * operator_instruction, int constant);
+    CopyInstruction * make_immediate(UnaryInstruction * operator_instruction, float constant);
+    CopyInstruction * make_immediate(UnaryInstruction * operator_instruction, bool constant);
+    CopyInstruction * constant_expression_evaluated(OperatorInstruction * operator_instruction);
+    CopyInstruction * constant_expression_evaluated(UnaryInstruction * operator_instruction);
     RegisterType type_denoter_to_register_type(TypeDenoter * type);
-    void calculate_mangle_set(int block_index);
-    void calculate_downward_mangle_set(int block_index);
-    void calculate_upward_mangle_set(int block_index);
+    void value_number_block(int block_index, std::vector<std::vector<int> > & dominator_children, ValueNumbers & values);
+    int get_value_number(ValueNumbers & values, Variant register_or_const);
+    Variant get_leader(ValueNumbers & values, Variant register_or_const);
+    int next_value_number(ValueNumbers & values, Variant leader);
+    void insert_assigned_registers(std::set<int> & assigned);
+    void reduce_induction_variables(Loop & loop, std::vector<int> & reverse_postorder);
+    void eliminate_bounds_checks(int block_index, RangeAnalysis & analysis);
+    // the definitions and dominators calculate_value_range looks at, as the method is now
+    void calculate_range_analysis(RangeAnalysis & analysis);
+    // whether scale * value + offset comes out the same in 32 bits as it really is, for everything in the ranges
+    bool scaled_range_fits(ValueRange range, int scale, ValueRange offset);
+    ValueRange calculate_value_range(Variant value, int block_index, RangeAnalysis & analysis, int depth);
+    void apply_branch_conditions(ValueRange & range, int register_index, int block_index, RangeAnalysis & analysis, int depth);
+    void narrow_value_range(ValueRange & range, int register_index, Variant condition, bool truth, int block_index, RangeAnalysis & analysis, int depth);
+    Variant insert_preheader_operation(BasicBlock * block, Variant left, OperatorInstruction::Operator _operator, Variant right, RegisterType type);
+    void remove_dead_ssa_code();
+    LatticeValue get_lattice_value(std::vector<LatticeValue> & values, Variant register_or_const);
+    LatticeValue evaluate_lattice_value(std::vector<LatticeValue> & values, Instruction * instruction);
+    bool lower_lattice_value(LatticeValue & value, LatticeValue other);
+    bool mark_edge_executable(int parent_index, int child_index, std::set<std::pair<int, int> > & executable_edges, std::vector<bool> & executable_blocks);
+    void calculate_live_registers(Liveness & liveness);
+    void calculate_reaching_definitions(std::set<int> & blocks, std::vector<Definition> & definitions, std::vector<BitVector> & reaching_in);
+    void step_live_registers(Instruction * instruction, BitVector & live);
+    ControlFlow & control_flow();
+    void invalidate_control_flow();
+    bool over_budget() { return (m_work_limit != 0 && m_work > m_work_limit) || (m_deadline != 0 && clock() > m_deadline); }
+    void find_natural_loops(ControlFlow & control_flow);
+    int insert_block(int index);
+    int insert_preheader(Loop & loop);
+    void update_control_flow_for_preheader(int preheader);
+    bool hoist_loop_invariants(Loop & loop);
+    void calculate_this_field_pointers(std::set<int> & field_pointers);
+    void calculate_parents();
+    void calculate_postorder(int block_index, std::vector<bool> & visited, std::vector<int> & order);
+    void calculate_dominators(std::vector<int> & immediate_dominator, std::vector<int> & reverse_postorder);
+    void calculate_dominance_frontiers(std::vector<int> & immediate_dominator, std::vector<int> & reverse_postorder, std::vector<std::set<int> > & frontiers);
+    void rename_ssa_registers(int block_index, std::vector<std::vector<int> > & dominator_children, std::vector<int> & current_version, std::map<Instruction *, int> & phi_variables);
+    int find_register_class(RegisterClasses & classes, int register_index);
+    bool coalesce_registers(RegisterClasses & classes, int left, int right);
+    int split_edge(int parent_index, int child_index);
+    void insert_parallel_copies(BasicBlock * block, std::vector<std::pair<int, Variant> > & copies);
+    int parameter_register_count();
     void delete_block(int index);
     void loadValue(std::ostream & out, Variant source_value, std::string dest_register);
     void storeRegister(std::ostream & out, int dest_register_number, std::string source_register);
+    void allocateHeap(std::ostream & out, int dest_register_number, int size, std::string layout_label);
+    void allocateStack(std::ostream & out, int dest_register_number, int size, int stack_offset);
+    // the frame slot translate uses for a register or constant
+    int get_ir_slot(IrMethod & method, std::map<Variant, int> & constant_slots, Variant value);
     int get_stack_space();
 
     TypeDenoter * get_class_type(VariableAccess * variable_access);
@@ -617,6 +1132,7 @@ private:
     Variant gen_attribute_pointer(AttributeDesignator * attribute);
     Variant gen_array_pointer(IndexedVariable * indexed_variable, ArrayType * type);
     TypeDenoter * variable_access_type(VariableAccess * variable_access);
+    int variable_access_line_number(VariableAccess * variable_access);
     int get_stack_variable_offset_in_bytes(int variable_number);
 
 };
@@ -626,7 +1142,511 @@ MethodGenerator::Variant MethodGenerator::next_available_register(RegisterType t
     return Variant(m_register_count++, Variant::REGISTER);
 }
 
-void generate_code(Program * program, SymbolTable * symbol_table, bool debug, bool disable_optimization, bool skip_lame_stuff) {
+void print_garbage_collector(std::ostream & out)
+{
+    // allocate $a0 bytes when the current free span doesn't have room. returns the block in $t0
+    // with $fp just past it, and expects the caller's frame at $sp and its return address in $ra.
+    out << "_gc_allocate:" << std::endl;
+    out << "sw $ra, gc_return_address" << std::endl;
+    out << "sub $fp, $fp, $a0" << std::endl;
+    out << "move $s5, $a0" << std::endl;
+    // what's left of the span becomes a free block so the heap can be walked
+    out << "sub $t0, $s7, $fp" << std::endl;
+    out << "beq $t0, $0, _gc_allocate_search" << std::endl;
+    out << "sw $0, 0($fp)" << std::endl;
+    out << "sw $t0, 4($fp)" << std::endl;
+    out << "_gc_allocate_search:" << std::endl;
+    out << "move $s7, $fp" << std::endl;
+    out << "jal _gc_find_span" << std::endl;
+    out << "bne $v0, $0, _gc_allocate_done" << std::endl;
+    out << "jal _gc_collect" << std::endl;
+    out << "lw $t0, heap_base" << std::endl;
+    out << "sw $t0, heap_cursor" << std::endl;
+    // grow instead if less than a quarter of the heap came free, so collections don't keep getting closer together
+    out << "lw $t1, heap_end" << std::endl;
+    out << "sub $t1, $t1, $t0" << std::endl;
+    out << "srl $t1, $t1, 2" << std::endl;
+    out << "sltu $t1, $v1, $t1" << std::endl;
+    out << "bne $t1, $0, _gc_allocate_grow" << std::endl;
+    out << "jal _gc_find_span" << std::endl;
+    out << "bne $v0, $0, _gc_allocate_done" << std::endl;
+    out << "_gc_allocate_grow:" << std::endl;
+    // ask sbrk for as much again as the heap already has, and at least enough for this block
+    out << "lw $t0, heap_base" << std::endl;
+    out << "lw $t1, heap_end" << std::endl;
+    out << "sub $a0, $t1, $t0" << std::endl;
+    out << "sltu $t2, $a0, $s5" << std::endl;
+    out << "beq $t2, $0, _gc_allocate_sbrk" << std::endl;
+    out << "move $a0, $s5" << std::endl;
+    out << "_gc_allocate_sbrk:" << std::endl;
+    out << "addi $a0, $a0, 8" << std::endl;
+    out << "li $v0, 9" << std::endl;
+    out << "syscall" << std::endl;
+    // the new memory has to carry straight on from the end of the heap
+    out << "lw $t1, heap_end" << std::endl;
+    out << "sub $t2, $v0, $t1" << std::endl;
+    out << "sltiu $t2, $t2, 16" << std::endl;
+    out << "beq $t2, $0, _gc_allocate_out_of_memory" << std::endl;
+    out << "add $t0, $v0, $a0" << std::endl;
+    out << "li $t2, -8" << std::endl;
+    out << "and $t0, $t0, $t2" << std::endl;
+    out << "sub $t2, $t0, $t1" << std::endl;
+    out << "sw $0, 0($t1)" << std::endl;
+    out << "sw $t2, 4($t1)" << std::endl;
+    out << "sw $t0, heap_end" << std::endl;
+    out << "sw $t1, heap_cursor" << std::endl;
+    out << "jal _gc_find_span" << std::endl;
+    out << "bne $v0, $0, _gc_allocate_done" << std::endl;
+    out << "_gc_allocate_out_of_memory:" << std::endl;
+    out << "la $a0, out_of_memory_text" << std::endl;
+    out << "li $v0, 4" << std::endl;
+    out << "syscall" << std::endl;
+    out << "li $v0, 10" << std::endl;
+    out << "syscall" << std::endl;
+    out << "_gc_allocate_done:" << std::endl;
+    out << "move $t0, $fp" << std::endl;
+    out << "add $fp, $fp, $s5" << std::endl;
+    out << "lw $ra, gc_return_address" << std::endl;
+    out << "jr $ra" << std::endl;
+
+    // look after heap_cursor for a free block of at least $s5 bytes to allocate from
+    out << "_gc_find_span:" << std::endl;
+    out << "lw $t0, heap_cursor" << std::endl;
+    out << "lw $t1, heap_end" << std::endl;
+    out << "_gc_find_span_loop:" << std::endl;
+    out << "sltu $t2, $t0, $t1" << std::endl;
+    out << "beq $t2, $0, _gc_find_span_fail" << std::endl;
+    out << "lw $t2, 0($t0)" << std::endl;
+    out << "lw $t3, 4($t0)" << std::endl;
+    out << "bne $t2, $0, _gc_find_span_next" << std::endl;
+    out << "sltu $t4, $t3, $s5" << std::endl;
+    out << "bne $t4, $0, _gc_find_span_next" << std::endl;
+    out << "move $fp, $t0" << std::endl;
+    out << "add $s7, $t0, $t3" << std::endl;
+    out << "sw $s7, heap_cursor" << std::endl;
+    out << "li $v0, 1" << std::endl;
+    out << "jr $ra" << std::endl;
+    out << "_gc_find_span_next:" << std::endl;
+    out << "add $t0, $t0, $t3" << std::endl;
+    out << "j _gc_find_span_loop" << std::endl;
+    out << "_gc_find_span_fail:" << std::endl;
+    out << "sw $t0, heap_cursor" << std::endl;
+    out << "li $v0, 0" << std::endl;
+    out << "jr $ra" << std::endl;
+
+    // mark everything reachable from the pointer slots of the frames on the stack, then sweep the
+    // rest into zeroed free blocks, returning how many bytes are free in $v1. $s0 and $s1 are the heap, $s2 the first frame, $s3 a bitmap of
+    // where blocks start (a bit for every 8 bytes) and $s4 the bottom of the mark stack below it.
+    out << "_gc_collect:" << std::endl;
+    out << "sw $ra, gc_collect_return_address" << std::endl;
+    out << "lw $s0, heap_base" << std::endl;
+    out << "lw $s1, heap_end" << std::endl;
+    out << "move $s2, $sp" << std::endl;
+    out << "sub $t0, $s1, $s0" << std::endl;
+    out << "srl $t0, $t0, 8" << std::endl;
+    out << "addi $t0, $t0, 1" << std::endl;
+    out << "sll $t0, $t0, 2" << std::endl;
+    out << "sub $sp, $sp, $t0" << std::endl;
+    out << "move $s3, $sp" << std::endl;
+    out << "move $s4, $sp" << std::endl;
+    out << "move $t0, $s3" << std::endl;
+    out << "_gc_collect_clear_bitmap:" << std::endl;
+    out << "beq $t0, $s2, _gc_collect_blocks" << std::endl;
+    out << "sw $0, 0($t0)" << std::endl;
+    out << "addi $t0, $t0, 4" << std::endl;
+    out << "j _gc_collect_clear_bitmap" << std::endl;
+    out << "_gc_collect_blocks:" << std::endl;
+    out << "move $t0, $s0" << std::endl;
+    out << "_gc_collect_block_loop:" << std::endl;
+    out << "beq $t0, $s1, _gc_collect_roots" << std::endl;
+    out << "sub $t1, $t0, $s0" << std::endl;
+    out << "srl $t1, $t1, 3" << std::endl;
+    out << "srl $t2, $t1, 5" << std::endl;
+    out << "sll $t2, $t2, 2" << std::endl;
+    out << "add $t2, $t2, $s3" << std::endl;
+    out << "andi $t3, $t1, 31" << std::endl;
+    out << "li $t4, 1" << std::endl;
+    out << "sllv $t4, $t4, $t3" << std::endl;
+    out << "lw $t5, 0($t2)" << std::endl;
+    out << "or $t5, $t5, $t4" << std::endl;
+    out << "sw $t5, 0($t2)" << std::endl;
+    out << "lw $t3, 4($t0)" << std::endl;
+    out << "add $t0, $t0, $t3" << std::endl;
+    out << "j _gc_collect_block_loop" << std::endl;
+    out << "_gc_collect_roots:" << std::endl;
+    out << "move $a1, $s2" << std::endl;
+    out << "lw $a2, gc_return_address" << std::endl;
+    out << "_gc_collect_frame:" << std::endl;
+    // the method table is in address order, so the frame belongs to the last method starting before its return address
+    out << "la $t0, _gc_method_table" << std::endl;
+    out << "lw $t1, 0($t0)" << std::endl;
+    out << "addi $t0, $t0, 4" << std::endl;
+    out << "li $a3, 0" << std::endl;
+    out << "_gc_collect_method_loop:" << std::endl;
+    out << "beq $t1, $0, _gc_collect_method_found" << std::endl;
+    out << "lw $t2, 0($t0)" << std::endl;
+    out << "sltu $t3, $a2, $t2" << std::endl;
+    out << "bne $t3, $0, _gc_collect_method_found" << std::endl;
+    out << "lw $a3, 4($t0)" << std::endl;
+    out << "addi $t0, $t0, 8" << std::endl;
+    out << "addi $t1, $t1, -1" << std::endl;
+    out << "j _gc_collect_method_loop" << std::endl;
+    out << "_gc_collect_method_found:" << std::endl;
+    out << "beq $a3, $0, _gc_collect_mark" << std::endl;
+    out << "lw $t1, 4($a3)" << std::endl;
+    out << "addi $t0, $a3, 8" << std::endl;
+    out << "_gc_collect_slot_loop:" << std::endl;
+    out << "beq $t1, $0, _gc_collect_next_frame" << std::endl;
+    out << "lw $t2, 0($t0)" << std::endl;
+    out << "add $t2, $t2, $a1" << std::endl;
+    out << "lw $a0, 0($t2)" << std::endl;
+    out << "jal _gc_mark_value" << std::endl;
+    out << "addi $t0, $t0, 4" << std::endl;
+    out << "addi $t1, $t1, -1" << std::endl;
+    out << "j _gc_collect_slot_loop" << std::endl;
+    out << "_gc_collect_next_frame:" << std::endl;
+    out << "lw $a2, 0($a1)" << std::endl;
+    out << "lw $t2, 0($a3)" << std::endl;
+    out << "add $a1, $a1, $t2" << std::endl;
+    out << "j _gc_collect_frame" << std::endl;
+    out << "_gc_collect_mark:" << std::endl;
+    out << "beq $sp, $s4, _gc_collect_sweep" << std::endl;
+    out << "lw $a1, 0($sp)" << std::endl;
+    out << "addi $sp, $sp, 4" << std::endl;
+    out << "lw $a3, 0($a1)" << std::endl;
+    out << "li $t0, -2" << std::endl;
+    out << "and $a3, $a3, $t0" << std::endl;
+    out << "lw $t1, 4($a1)" << std::endl;
+    out << "add $a2, $a1, $t1" << std::endl;
+    out << "addi $a1, $a1, 8" << std::endl;
+    out << "lw $t1, 0($a3)" << std::endl;
+    out << "slt $t2, $t1, $0" << std::endl;
+    out << "bne $t2, $0, _gc_collect_mark_all" << std::endl;
+    out << "addi $t0, $a3, 4" << std::endl;
+    out << "_gc_collect_field_loop:" << std::endl;
+    out << "beq $t1, $0, _gc_collect_mark" << std::endl;
+    out << "lw $t2, 0($t0)" << std::endl;
+    out << "add $t2, $t2, $a1" << std::endl;
+    out << "sltu $t3, $t2, $a2" << std::endl;
+    out << "beq $t3, $0, _gc_collect_next_field" << std::endl;
+    out << "lw $a0, 0($t2)" << std::endl;
+    out << "jal _gc_mark_value" << std::endl;
+    out << "_gc_collect_next_field:" << std::endl;
+    out << "addi $t0, $t0, 4" << std::endl;
+    out << "addi $t1, $t1, -1" << std::endl;
+    out << "j _gc_collect_field_loop" << std::endl;
+    out << "_gc_collect_mark_all:" << std::endl;
+    out << "beq $a1, $a2, _gc_collect_mark" << std::endl;
+    out << "lw $a0, 0($a1)" << std::endl;
+    out << "jal _gc_mark_value" << std::endl;
+    out << "addi $a1, $a1, 4" << std::endl;
+    out << "j _gc_collect_mark_all" << std::endl;
+    out << "_gc_collect_sweep:" << std::endl;
+    out << "move $sp, $s2" << std::endl;
+    out << "move $t0, $s0" << std::endl;
+    out << "li $t1, 0" << std::endl;
+    out << "li $v1, 0" << std::endl;
+    out << "_gc_collect_sweep_loop:" << std::endl;
+    out << "beq $t0, $s1, _gc_collect_done" << std::endl;
+    out << "lw $t2, 0($t0)" << std::endl;
+    out << "lw $t3, 4($t0)" << std::endl;
+    out << "andi $t4, $t2, 1" << std::endl;
+    out << "beq $t4, $0, _gc_collect_free" << std::endl;
+    out << "xori $t2, $t2, 1" << std::endl;
+    out << "sw $t2, 0($t0)" << std::endl;
+    out << "li $t1, 0" << std::endl;
+    out << "add $t0, $t0, $t3" << std::endl;
+    out << "j _gc_collect_sweep_loop" << std::endl;
+    out << "_gc_collect_free:" << std::endl;
+    out << "add $v1, $v1, $t3" << std::endl;
+    // free blocks are all zeros, so allocating from them doesn't have to clear anything
+    out << "beq $t2, $0, _gc_collect_join" << std::endl;
+    out << "addi $t4, $t0, 8" << std::endl;
+    out << "add $t5, $t0, $t3" << std::endl;
+    out << "_gc_collect_clear_block:" << std::endl;
+    out << "beq $t4, $t5, _gc_collect_join" << std::endl;
+    out << "sw $0, 0($t4)" << std::endl;
+    out << "addi $t4, $t4, 4" << std::endl;
+    out << "j _gc_collect_clear_block" << std::endl;
+    out << "_gc_collect_join:" << std::endl;
+    out << "sw $0, 0($t0)" << std::endl;
+    out << "add $t4, $t0, $t3" << std::endl;
+    out << "beq $t1, $0, _gc_collect_first_free" << std::endl;
+    out << "sw $0, 4($t0)" << std::endl;
+    out << "lw $t5, 4($t1)" << std::endl;
+    out << "add $t5, $t5, $t3" << std::endl;
+    out << "sw $t5, 4($t1)" << std::endl;
+    out << "move $t0, $t4" << std::endl;
+    out << "j _gc_collect_sweep_loop" << std::endl;
+    out << "_gc_collect_first_free:" << std::endl;
+    out << "move $t1, $t0" << std::endl;
+    out << "move $t0, $t4" << std::endl;
+    out << "j _gc_collect_sweep_loop" << std::endl;
+    out << "_gc_collect_done:" << std::endl;
+    out << "lw $ra, gc_collect_return_address" << std::endl;
+    out << "jr $ra" << std::endl;
+
+    // if $a0 points anywhere into a block that hasn't been marked yet, mark it and push it on the mark stack
+    out << "_gc_mark_value:" << std::endl;
+    out << "sltu $t5, $a0, $s0" << std::endl;
+    out << "bne $t5, $0, _gc_mark_value_done" << std::endl;
+    out << "sltu $t5, $a0, $s1" << std::endl;
+    out << "beq $t5, $0, _gc_mark_value_done" << std::endl;
+    out << "sub $t5, $a0, $s0" << std::endl;
+    out << "srl $t5, $t5, 3" << std::endl;
+    out << "srl $t6, $t5, 5" << std::endl;
+    out << "sll $t6, $t6, 2" << std::endl;
+    out << "add $t6, $t6, $s3" << std::endl;
+    out << "lw $t7, 0($t6)" << std::endl;
+    out << "andi $t8, $t5, 31" << std::endl;
+    out << "li $t9, 2" << std::endl;
+    out << "sllv $t9, $t9, $t8" << std::endl;
+    out << "addi $t9, $t9, -1" << std::endl;
+    out << "and $t7, $t7, $t9" << std::endl;
+    out << "sub $t5, $t5, $t8" << std::endl;
+    out << "_gc_mark_value_word:" << std::endl;
+    out << "bne $t7, $0, _gc_mark_value_bit" << std::endl;
+    out << "addi $t6, $t6, -4" << std::endl;
+    out << "addi $t5, $t5, -32" << std::endl;
+    out << "lw $t7, 0($t6)" << std::endl;
+    out << "j _gc_mark_value_word" << std::endl;
+    out << "_gc_mark_value_bit:" << std::endl;
+    out << "li $t8, 31" << std::endl;
+    out << "_gc_mark_value_find:" << std::endl;
+    out << "srlv $t9, $t7, $t8" << std::endl;
+    out << "bne $t9, $0, _gc_mark_value_block" << std::endl;
+    out << "addi $t8, $t8, -1" << std::endl;
+    out << "j _gc_mark_value_find" << std::endl;
+    out << "_gc_mark_value_block:" << std::endl;
+    out << "add $t5, $t5, $t8" << std::endl;
+    out << "sll $t5, $t5, 3" << std::endl;
+    out << "add $t5, $t5, $s0" << std::endl;
+    out << "lw $t6, 0($t5)" << std::endl;
+    out << "beq $t6, $0, _gc_mark_value_done" << std::endl;
+    out << "andi $t7, $t6, 1" << std::endl;
+    out << "bne $t7, $0, _gc_mark_value_done" << std::endl;
+    out << "ori $t6, $t6, 1" << std::endl;
+    out << "sw $t6, 0($t5)" << std::endl;
+    out << "addi $sp, $sp, -4" << std::endl;
+    out << "sw $t5, 0($sp)" << std::endl;
+    out << "_gc_mark_value_done:" << std::endl;
+    out << "jr $ra" << std::endl;
+}
+
+// one step of the optimizer. the addresses get computed again after every one.
+struct OptimizationPass {
+    const char * name;
+    void (MethodGenerator::*run)();
+    // whether it works on SSA form
+    bool ssa;
+    // whether it leaves behind registers that nothing uses anymore
+    bool compress_registers;
+    // what -p2 calls the code it leaves behind, NULL to not show it
+    const char * title;
+    // whether -p2 shows it even with -s
+    bool always_shown;
+    // whether it's quick enough for -O1 and for methods over their budget.
+    // the passes that work on whole loops take the longest.
+    bool local;
+};
+
+// these two happen around the SSA passes whenever there are any
+const OptimizationPass construct_ssa_pass = {"construct-ssa", &MethodGenerator::construct_ssa, true, false, "3 Address Code In SSA Form", false, true};
+const OptimizationPass destruct_ssa_pass = {"destruct-ssa", &MethodGenerator::destruct_ssa, false, true, NULL, false, true};
+// the ones -fpasses and -fno- can name, in the order they usually run
+const OptimizationPass optimization_passes[] = {
+    {"constant-propagation", &MethodGenerator::sparse_conditional_constant_propagation, true, false, "3 Address Code After Constant Propagation", false, false},
+    {"value-numbering", &MethodGenerator::global_value_numbering, true, false, "3 Address Code After Value Numbering", false, true},
+    {"bounds-check-elimination", &MethodGenerator::bounds_check_elimination, true, false, "3 Address Code After Bounds Check Elimination", false, false},
+    {"strength-reduction", &MethodGenerator::induction_variable_strength_reduction, true, false, "3 Address Code After Strength Reduction", false, false},
+    {"dependency-management", &MethodGenerator::dependency_management, false, true, "3 Address Code After Dependency Management", false, true},
+    {"loop-invariant-code-motion", &MethodGenerator::loop_invariant_code_motion, false, false, "3 Address Code After Loop Invariant Code Motion", false, false},
+    {"block-deletion", &MethodGenerator::block_deletion, false, true, "3 Address Code After Block Deletion", true, true},
+    {"stack-allocation", &MethodGenerator::stack_allocation, false, false, "3 Address Code After Stack Allocation", false, false},
+};
+const int optimization_pass_count = sizeof(optimization_passes) / sizeof(optimization_passes[0]);
+// what -Os runs: everything but loop invariant code motion. it only moves code into a new
+// preheader block in front of the loop, so it never takes an instruction away, and it's the
+// only pass that gave any of the test programs more blocks.
+const char * const size_passes[] = {"constant-propagation", "value-numbering", "bounds-check-elimination",
+    "strength-reduction", "dependency-management", "block-deletion", "stack-allocation"};
+const int size_pass_count = sizeof(size_passes) / sizeof(size_passes[0]);
+
+const OptimizationPass * find_optimization_pass(std::string name) {
+    for (int i = 0; i < optimization_pass_count; i++) {
+        if (name.compare(optimization_passes[i].name) == 0)
+            return &optimization_passes[i];
+    }
+    return NULL;
+}
+
+bool is_optimization_pass(std::string name) {
+    return find_optimization_pass(name) != NULL;
+}
+
+// runs the optimization passes over each method and keeps count of what they did
+class PassManager {
+public:
+    PassManager(CodeGenerationOptions & options);
+    // returns why the method only got the local passes, or "" if it got all of them
+    std::string optimize(MethodGenerator * generator, std::ostream & debug_out);
+    // every pass that ran, totalled over all the methods
+    void print_statistics(std::ostream & out);
+
+private:
+    struct Statistics {
+        int runs;
+        // negative when it added some
+        int instructions_removed;
+        int blocks_deleted;
+        clock_t time;
+
+        Statistics() : runs(0), instructions_removed(0), blocks_deleted(0), time(0) {}
+    };
+    CodeGenerationOptions & m_options;
+    // how many times we go through the SSA passes before giving up on them settling down
+    int m_max_rounds;
+    std::vector<const OptimizationPass *> m_ssa_passes;
+    std::vector<const OptimizationPass *> m_passes;
+    std::map<std::string, Statistics> m_statistics;
+    // the names in m_statistics in the order they first ran
+    std::vector<std::string> m_statistics_order;
+    // for the method we're on: why it's over its budget, or "" if it isn't, and when its time is up
+    std::string m_over_budget;
+    clock_t m_deadline;
+
+    bool within_budget(const OptimizationPass & pass) { return pass.local || m_over_budget.empty(); }
+    // returns whether it left fewer instructions or blocks than it found
+    bool run(const OptimizationPass & pass, MethodGenerator * generator, std::ostream & debug_out);
+};
+
+PassManager::PassManager(CodeGenerationOptions & options) :
+    m_options(options),
+    m_max_rounds(4),
+    m_deadline(0)
+{
+    if (options.optimization_level == OPTIMIZE_LOCAL && ! options.iterate_passes)
+        m_max_rounds = 1;
+
+    std::vector<const OptimizationPass *> pipeline;
+    if (options.passes_given) {
+        for (int i = 0; i < (int)options.passes.size(); i++)
+            pipeline.push_back(find_optimization_pass(options.passes[i]));
+    } else if (options.optimization_level == OPTIMIZE_LOCAL) {
+        for (int i = 0; i < optimization_pass_count; i++) {
+            if (optimization_passes[i].local)
+                pipeline.push_back(&optimization_passes[i]);
+        }
+    } else if (options.optimization_level == OPTIMIZE_SIZE) {
+        for (int i = 0; i < size_pass_count; i++)
+            pipeline.push_back(find_optimization_pass(size_passes[i]));
+    } else {
+        for (int i = 0; i < optimization_pass_count; i++)
+            pipeline.push_back(&optimization_passes[i]);
+    }
+    for (int i = 0; i < (int)pipeline.size(); i++) {
+        const OptimizationPass * pass = pipeline[i];
+        if (options.disabled_passes.count(pass->name))
+            continue;
+        // no checks to eliminate
+        if (pass->run == &MethodGenerator::bounds_check_elimination && ! options.bounds_check)
+            continue;
+        // the SSA ones all have to happen before we get out of SSA form
+        if (pass->ssa)
+            m_ssa_passes.push_back(pass);
+        else
+            m_passes.push_back(pass);
+    }
+}
+
+std::string PassManager::optimize(MethodGenerator * generator, std::ostream & debug_out) {
+    // the loop passes would take forever on methods this big
+    std::stringstream over_budget;
+    if (m_options.method_instruction_limit > 0 && generator->instruction_count() > m_options.method_instruction_limit)
+        over_budget << "has " << generator->instruction_count() << " instructions";
+    else if (m_options.method_block_limit > 0 && generator->block_count() > m_options.method_block_limit)
+        over_budget << "has " << generator->block_count() << " blocks";
+    m_over_budget = over_budget.str();
+    m_deadline = 0;
+    if (m_options.method_time_limit > 0)
+        m_deadline = clock() + (clock_t)(m_options.method_time_limit * CLOCKS_PER_SEC);
+    generator->set_budget(m_options.method_work_limit, m_deadline);
+
+    bool any_ssa_passes = false;
+    for (int i = 0; i < (int)m_ssa_passes.size(); i++) {
+        if (within_budget(*m_ssa_passes[i]))
+            any_ssa_passes = true;
+    }
+    if (any_ssa_passes) {
+        run(construct_ssa_pass, generator, debug_out);
+        for (int round = 0; round < m_max_rounds; round++) {
+            bool removed_anything = false;
+            for (int i = 0; i < (int)m_ssa_passes.size(); i++) {
+                if (within_budget(*m_ssa_passes[i]) && run(*m_ssa_passes[i], generator, debug_out))
+                    removed_anything = true;
+            }
+            // -O1 doesn't go around again either
+            if (! removed_anything || ! m_over_budget.empty())
+                break;
+        }
+        run(destruct_ssa_pass, generator, debug_out);
+    }
+    for (int i = 0; i < (int)m_passes.size(); i++) {
+        if (within_budget(*m_passes[i]))
+            run(*m_passes[i], generator, debug_out);
+    }
+    return m_over_budget;
+}
+
+bool PassManager::run(const OptimizationPass & pass, MethodGenerator * generator, std::ostream & debug_out) {
+    int instruction_count = generator->instruction_count();
+    int block_count = generator->block_count();
+    clock_t start = clock();
+
+    (generator->*pass.run)();
+    generator->compute_addresses();
+    if (pass.compress_registers)
+        generator->compress_registers();
+
+    if (! m_statistics.count(pass.name))
+        m_statistics_order.push_back(pass.name);
+    Statistics & statistics = m_statistics[pass.name];
+    int instructions_removed = instruction_count - generator->instruction_count();
+    int blocks_deleted = block_count - generator->block_count();
+    statistics.runs++;
+    statistics.instructions_removed += instructions_removed;
+    statistics.blocks_deleted += blocks_deleted;
+    statistics.time += clock() - start;
+    if (m_over_budget.empty()) {
+        std::stringstream over_budget;
+        if (m_options.method_work_limit > 0 && generator->work() > m_options.method_work_limit)
+            over_budget << "went over " << m_options.method_work_limit << " instructions of work in its loops";
+        else if (m_deadline != 0 && clock() > m_deadline)
+            over_budget << "took more than " << m_options.method_time_limit << " seconds";
+        m_over_budget = over_budget.str();
+    }
+
+    if (m_options.debug && pass.title != NULL && (pass.always_shown || ! m_options.skip_lame_stuff)) {
+        debug_out << pass.title << std::endl;
+        debug_out << "--------------------------" << std::endl;
+        generator->print_basic_blocks(debug_out);
+        debug_out << "--------------------------" << std::endl;
+    }
+    return instructions_removed > 0 || blocks_deleted > 0;
+}
+
+void PassManager::print_statistics(std::ostream & out) {
+    out << std::left << std::setw(28) << "pass" << std::right << std::setw(6) << "runs" << std::setw(22) << "instructions removed"
+        << std::setw(16) << "blocks deleted" << std::setw(10) << "seconds" << std::endl;
+    for (int i = 0; i < (int)m_statistics_order.size(); i++) {
+        Statistics & statistics = m_statistics[m_statistics_order[i]];
+        out << std::left << std::setw(28) << m_statistics_order[i] << std::right << std::setw(6) << statistics.runs
+            << std::setw(22) << statistics.instructions_removed << std::setw(16) << statistics.blocks_deleted
+            << std::setw(10) << std::fixed << std::setprecision(3) << (double)statistics.time / CLOCKS_PER_SEC << std::endl;
+    }
+}
+
+void generate_code(Program * program, SymbolTable * symbol_table, CodeGenerationOptions & options) {
     std::stringstream debug_out;
     std::stringstream asm_out;
 
@@ -634,112 +1654,500 @@ void generate_code(Program * program, SymbolTable * symbol_table, bool debug, bo
     asm_out << ".data" << std::endl;
     asm_out << "true_text: .asciiz \"true\"" << std::endl;
     asm_out << "false_text: .asciiz \"false\"" << std::endl;
-    asm_out << "heap_start: .word 0" << std::endl;
+    if (options.bounds_check)
+        asm_out << "bounds_error_text: .asciiz \"ERROR: array index out of bounds on line \"" << std::endl;
+    asm_out << "out_of_memory_text: .asciiz \"ERROR: out of memory\\n\"" << std::endl;
+    asm_out << "heap_base: .word 0" << std::endl;
+    asm_out << "heap_end: .word 0" << std::endl;
+    asm_out << "heap_cursor: .word 0" << std::endl;
+    asm_out << "gc_return_address: .word 0" << std::endl;
+    asm_out << "gc_collect_return_address: .word 0" << std::endl;
+    // arrays either hold nothing but pointers or no pointers at all
+    asm_out << "_layout_references: .word -1" << std::endl;
+    asm_out << "_layout_values: .word 0" << std::endl;
 
     asm_out << ".text" << std::endl;
     asm_out << "main:" << std::endl;
-    asm_out << "la $fp, heap_start" << std::endl;
+    // $fp is where the next heap block goes and $s7 is where the free span it's in ends
+    asm_out << "li $a0, " << initial_heap_size + 8 << std::endl;
+    asm_out << "li $v0, 9" << std::endl;
+    asm_out << "syscall" << std::endl;
+    asm_out << "addi $v0, $v0, 7" << std::endl;
+    asm_out << "li $t0, -8" << std::endl;
+    asm_out << "and $fp, $v0, $t0" << std::endl;
+    asm_out << "li $t0, " << initial_heap_size << std::endl;
+    asm_out << "add $s7, $fp, $t0" << std::endl;
+    asm_out << "sw $fp, heap_base" << std::endl;
+    asm_out << "sw $s7, heap_end" << std::endl;
+    asm_out << "sw $s7, heap_cursor" << std::endl;
 
     asm_out << "jal _entrypoint__entrypoint" << std::endl;
 
     asm_out << std::endl << "# quit" << std::endl;
     asm_out << "li $v0, 10" << std::endl;
     asm_out << "syscall" << std::endl;
+
+    print_garbage_collector(asm_out);
+
+    if (options.bounds_check) {
+        // a failed bounds check jumps here with the line number in $a0
+        asm_out << "_bounds_error:" << std::endl;
+        asm_out << "move $t0, $a0" << std::endl;
+        asm_out << "la $a0, bounds_error_text" << std::endl;
+        asm_out << "li $v0, 4" << std::endl;
+        asm_out << "syscall" << std::endl;
+        asm_out << "move $a0, $t0" << std::endl;
+        asm_out << "li $v0, 1" << std::endl;
+        asm_out << "syscall" << std::endl;
+        asm_out << "li $a0, 10" << std::endl;
+        asm_out << "li $v0, 11" << std::endl;
+        asm_out << "syscall" << std::endl;
+        asm_out << "li $v0, 10" << std::endl;
+        asm_out << "syscall" << std::endl;
+    }
+
+    // generate the methods reachable from the entry point. anything that's never
+    // called (including every method of a class that's never instantiated) is skipped.
+    std::map<std::string, MethodGenerator *> generators;
+    std::set<std::string> allocated_classes;
+    std::list<std::pair<std::string, std::string> > pending_methods;
+    pending_methods.push_back(std::pair<std::string, std::string>("_entrypoint", "_entrypoint"));
+    while (! pending_methods.empty()) {
+        std::string class_name = Utils::to_lower(pending_methods.front().first);
+        std::string method_name = Utils::to_lower(pending_methods.front().second);
+        pending_methods.pop_front();
+        std::string label = class_name + "_" + method_name;
+        if (generators.count(label))
+            continue;
+
+        FunctionDeclaration * function_declaration = symbol_table->get(class_name)->function_symbols->get(method_name)->function_declaration;
+        MethodGenerator * generator = new MethodGenerator(class_name, function_declaration, symbol_table, options.bounds_check);
+        generator->generate();
+        generator->insert_called_methods(pending_methods);
+        generator->insert_allocated_classes(allocated_classes);
+        generators[label] = generator;
+    }
+
+    // optimize them in declaration order
+    PassManager pass_manager(options);
+    std::vector<std::string> method_labels;
     for (ClassList * class_list_node = program->class_list; class_list_node != NULL; class_list_node = class_list_node->next) {
         ClassDeclaration * class_declaration = class_list_node->item;
         for (FunctionDeclarationList * function_list_node = class_declaration->class_block->function_list; function_list_node != NULL; function_list_node = function_list_node->next) {
             FunctionDeclaration * function_declaration = function_list_node->item;
+            std::string label = Utils::to_lower(class_declaration->identifier->text) + "_" + Utils::to_lower(function_declaration->identifier->text);
+            if (! generators.count(label))
+                continue;
+            MethodGenerator * generator = generators[label];
+            method_labels.push_back(label);
+
+            if (options.debug) {
+                debug_out << "Method " << class_declaration->identifier->text << "." << function_declaration->identifier->text << std::endl;
+                debug_out << "--------------------------" << std::endl;
+            }
 
-            debug_out << "Method " << class_declaration->identifier->text << "." << function_declaration->identifier->text << std::endl;
-            debug_out << "--------------------------" << std::endl;
-
-            MethodGenerator generator(Utils::to_lower(class_declaration->identifier->text), function_declaration, symbol_table);
-            generator.generate();
-            generator.build_basic_blocks();
+            generator->build_basic_blocks();
 
-            if (!skip_lame_stuff) {
+            if (options.debug && !options.skip_lame_stuff) {
                 debug_out << "3 Address Code" << std::endl;
                 debug_out << "--------------------------" << std::endl;
-                generator.print_basic_blocks(debug_out);
+                generator->print_basic_blocks(debug_out);
                 debug_out << "--------------------------" << std::endl;
 
                 debug_out << "Control Flow Graph" << std::endl;
                 debug_out << "--------------------------" << std::endl;
-                generator.print_control_flow_graph(debug_out);
+                generator->print_control_flow_graph(debug_out);
                 debug_out << "--------------------------" << std::endl;
             }
 
-            if (! disable_optimization) {
-                generator.calculate_mangle_sets();
-                generator.value_numbering();
-                generator.compress_registers();
-
-                if (!skip_lame_stuff) {
-                    debug_out << "3 Address Code After Value Numbering" << std::endl;
-                    debug_out << "--------------------------" << std::endl;
-                    generator.print_basic_blocks(debug_out);
-                    debug_out << "--------------------------" << std::endl;
-                }
-
-                generator.dependency_management();
-                generator.compute_addresses();
-                generator.compress_registers();
-
-                if (!skip_lame_stuff) {
-                    debug_out << "3 Address Code After Dependency Management" << std::endl;
-                    debug_out << "--------------------------" << std::endl;
-                    generator.print_basic_blocks(debug_out);
-                    debug_out << "--------------------------" << std::endl;
+            if (options.optimization_level != OPTIMIZE_NONE) {
+                std::string over_budget = pass_manager.optimize(generator, debug_out);
+                if (! over_budget.empty()) {
+                    std::cerr << "WARNING: line " << function_declaration->identifier->line_number << ": method " <<
+                        class_declaration->identifier->text << "." << function_declaration->identifier->text << " " <<
+                        over_budget << ", so it only got the quick optimizations" << std::endl;
                 }
-
-                generator.block_deletion();
-                generator.compute_addresses();
-                generator.compress_registers();
-                debug_out << "3 Address Code After Block Deletion" << std::endl;
-                debug_out << "--------------------------" << std::endl;
-                generator.print_basic_blocks(debug_out);
-                debug_out << "--------------------------" << std::endl;
             }
+        }
+    }
+    if (options.pass_statistics)
+        pass_manager.print_statistics(std::cerr);
+
+    // somebody else's tooling wants the intermediate code instead of the assembly, or to run it right here
+    if (options.output_format != OUTPUT_ASSEMBLY) {
+        // standard output has to be nothing but the document (or what the program printed)
+        if (options.debug)
+            std::cerr << debug_out.str();
+        if (options.output_format == OUTPUT_CFG_DOT) {
+            std::cout << "digraph program {" << std::endl;
+            for (int i = 0; i < (int)method_labels.size(); i++)
+                generators[method_labels[i]]->print_control_flow_dot(std::cout, method_labels[i]);
+            std::cout << "}" << std::endl;
+        } else if (options.output_format == OUTPUT_RUN_IR) {
+            std::vector<IrMethod> methods(method_labels.size());
+            for (int i = 0; i < (int)method_labels.size(); i++)
+                generators[method_labels[i]]->translate(methods[i], method_labels[i]);
+            run_ir(methods, "_entrypoint__entrypoint", std::cout);
+        } else {
+            std::cout << "{\"methods\": [";
+            for (int i = 0; i < (int)method_labels.size(); i++) {
+                std::cout << (i > 0 ? "," : "") << std::endl;
+                generators[method_labels[i]]->print_ir_json(std::cout, method_labels[i]);
+            }
+            std::cout << std::endl << "]}" << std::endl;
+        }
+        for (int i = 0; i < (int)method_labels.size(); i++)
+            delete generators[method_labels[i]];
+        return;
+    }
+
+    // fold methods that compiled to the same code. the first one in declaration order
+    // keeps the body and the others become extra labels on it.
+    std::map<std::string, std::string> fingerprint_to_label;
+    std::map<std::string, std::list<std::string> > aliases;
+    for (int i = 0; i < (int)method_labels.size(); i++) {
+        std::string label = method_labels[i];
+        if (options.optimization_level == OPTIMIZE_NONE) {
+            aliases[label];
+            continue;
+        }
+        std::string fingerprint = generators[label]->fingerprint();
+        if (fingerprint_to_label.count(fingerprint)) {
+            aliases[fingerprint_to_label[fingerprint]].push_back(label);
+        } else {
+            fingerprint_to_label[fingerprint] = label;
+            aliases[label];
+        }
+    }
 
-            generator.print_assembly(asm_out);
+    // the garbage collector finds each frame's method by looking for its return address in here
+    std::stringstream method_table;
+    int method_count = 0;
+    for (int i = 0; i < (int)method_labels.size(); i++) {
+        std::string label = method_labels[i];
+        MethodGenerator * generator = generators[label];
+        if (aliases.count(label)) {
+            for (std::list<std::string>::iterator it = aliases[label].begin(); it != aliases[label].end(); ++it)
+                asm_out << *it << ":" << std::endl;
+            generator->print_assembly(asm_out);
+            asm_out << ".data" << std::endl;
+            generator->print_frame_layout(asm_out, label);
+            asm_out << ".text" << std::endl;
+            method_table << ", " << label << ", _frame_" << label;
+            method_count++;
         }
+        delete generator;
     }
+    asm_out << ".data" << std::endl;
+    // only the classes that something we generated allocates need a layout
+    for (ClassList * class_list_node = program->class_list; class_list_node != NULL; class_list_node = class_list_node->next) {
+        std::string class_name = class_list_node->item->identifier->text;
+        if (allocated_classes.count(Utils::to_lower(class_name)))
+            print_class_layout(asm_out, class_name, symbol_table);
+    }
+    asm_out << "_gc_method_table: .word " << method_count << method_table.str() << std::endl;
 
-    if (debug)
+    if (options.debug)
         std::cout << debug_out.str();
 
     std::cout << asm_out.str();
 }
 
-int MethodGenerator::get_stack_variable_offset_in_bytes(int variable_number)
-{
-    return get_stack_space() - variable_number * 4 - 4;
-}
-
-void MethodGenerator::loadValue(std::ostream & out, Variant source_value, std::string dest_register)
+void MethodGenerator::insert_called_methods(std::list<std::pair<std::string, std::string> > & called_methods)
 {
-    if (source_value.type == Variant::CONST_BOOL) {
-        out << "li " << dest_register << ", " << (source_value._bool ? 1 : 0) << std::endl;
-    } else if (source_value.type == Variant::CONST_INT) {
-        out << "li " << dest_register << ", " << source_value._int << std::endl;
-    } else if (source_value.type == Variant::REGISTER) {
-        out << "lw " << dest_register << ", " << get_stack_variable_offset_in_bytes(source_value._int) << "($sp)" << std::endl;
-    } else {
-        assert(false);
+    for (int i = 0; i < (int)m_instructions.size(); i++) {
+        Instruction * instruction = m_instructions[i];
+        if (instruction->type == Instruction::METHOD_CALL || instruction->type == Instruction::NON_VOID_METHOD_CALL) {
+            MethodCallInstruction * method_call_instruction = (MethodCallInstruction *) instruction;
+            called_methods.push_back(std::pair<std::string, std::string>(method_call_instruction->class_name, method_call_instruction->method_name));
+        }
     }
 }
 
-void MethodGenerator::storeRegister(std::ostream & out, int dest_register_number, std::string source_register)
+void MethodGenerator::insert_allocated_classes(std::set<std::string> & allocated_classes)
 {
-    out << "sw " << source_register << ", " << get_stack_variable_offset_in_bytes(dest_register_number) << "($sp)" << std::endl;
+    for (int i = 0; i < (int)m_instructions.size(); i++) {
+        Instruction * instruction = m_instructions[i];
+        if (instruction->type == Instruction::ALLOCATE_OBJECT)
+            allocated_classes.insert(Utils::to_lower(((AllocateObjectInstruction *) instruction)->class_name));
+    }
 }
 
-int MethodGenerator::get_stack_space()
+std::string MethodGenerator::fingerprint()
 {
-    return
-        // a slot for each register (all types are the same size: 4 bytes)
-        m_register_count * 4 +
-        // a slot for return address (4 bytes)
+    // addresses in the 3 address code are relative to the method, so labels and
+    // stack offsets come out the same for any two methods with the same code.
+    // blocks fall through to the next one that isn't deleted, so those stay in.
+    std::stringstream ss;
+    ss << m_register_count << " " << m_stack_allocation_size << " " << m_basic_blocks.size() << "\n";
+    for (int i = 0; i < m_register_count; i++)
+        ss << m_register_type[i] << " ";
+    ss << "\n";
+    for (int i = 0; i < (int)m_stack_pointer_offsets.size(); i++)
+        ss << m_stack_pointer_offsets[i] << " ";
+    ss << "\n";
+    for (unsigned int b = 0; b < m_basic_blocks.size(); b++) {
+        BasicBlock * block = m_basic_blocks[b];
+        if (block->deleted) {
+            ss << "deleted\n";
+            continue;
+        }
+        ss << "block\n";
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+            write_fingerprint(ss, *it);
+            // jumps go to the block, not to goto_index
+            if ((*it)->type == Instruction::IF || (*it)->type == Instruction::GOTO)
+                ss << " " << block->jump_child;
+            ss << "\n";
+        }
+    }
+    return ss.str();
+}
+
+// print() is for people, and leaves things out and rounds reals. these write every field
+// that can change the assembly, each after a space, and the fingerprint is only as good as they are.
+void MethodGenerator::write_fingerprint(std::ostream & out, Variant value)
+{
+    out << " " << value.type << ":";
+    switch (value.type) {
+        case Variant::REGISTER:
+        case Variant::CONST_INT:
+            out << value._int;
+            break;
+        case Variant::CONST_BOOL:
+            out << value._bool;
+            break;
+        case Variant::CONST_REAL:
+        {
+            unsigned int bits;
+            std::memcpy(&bits, &value._float, sizeof(bits));
+            out << bits;
+            break;
+        }
+    }
+}
+
+void MethodGenerator::write_fingerprint(std::ostream & out, std::string text)
+{
+    out << " " << text.size() << ":" << text;
+}
+
+void MethodGenerator::write_fingerprint(std::ostream & out, Instruction * instruction)
+{
+    out << instruction->type;
+    switch (instruction->type) {
+        case Instruction::COPY:
+        {
+            CopyInstruction * copy_instruction = (CopyInstruction *) instruction;
+            write_fingerprint(out, copy_instruction->dest);
+            write_fingerprint(out, copy_instruction->source);
+            break;
+        }
+        case Instruction::OPERATOR:
+        {
+            OperatorInstruction * operator_instruction = (OperatorInstruction *) instruction;
+            write_fingerprint(out, operator_instruction->dest);
+            write_fingerprint(out, operator_instruction->left);
+            out << " " << operator_instruction->_operator;
+            write_fingerprint(out, operator_instruction->right);
+            break;
+        }
+        case Instruction::UNARY:
+        {
+            UnaryInstruction * unary_instruction = (UnaryInstruction *) instruction;
+            write_fingerprint(out, unary_instruction->dest);
+            out << " " << unary_instruction->_operator;
+            write_fingerprint(out, unary_instruction->source);
+            break;
+        }
+        case Instruction::IF:
+        {
+            IfInstruction * if_instruction = (IfInstruction *) instruction;
+            write_fingerprint(out, if_instruction->condition);
+            break;
+        }
+        case Instruction::GOTO:
+            break;
+        case Instruction::RETURN:
+        {
+            ReturnInstruction * return_instruction = (ReturnInstruction *) instruction;
+            out << " " << return_instruction->has_value;
+            if (return_instruction->has_value)
+                write_fingerprint(out, return_instruction->value);
+            break;
+        }
+        case Instruction::PRINT:
+        {
+            PrintInstruction * print_instruction = (PrintInstruction *) instruction;
+            write_fingerprint(out, print_instruction->value);
+            break;
+        }
+        case Instruction::NON_VOID_METHOD_CALL:
+        {
+            NonVoidMethodCallInstruction * method_call_instruction = (NonVoidMethodCallInstruction *) instruction;
+            write_fingerprint(out, method_call_instruction->dest);
+        }
+        // fall through
+        case Instruction::METHOD_CALL:
+        {
+            MethodCallInstruction * method_call_instruction = (MethodCallInstruction *) instruction;
+            write_fingerprint(out, method_call_instruction->class_name);
+            write_fingerprint(out, method_call_instruction->method_name);
+            out << " " << method_call_instruction->parameters.size();
+            for (int i = 0; i < (int)method_call_instruction->parameters.size(); i++)
+                write_fingerprint(out, method_call_instruction->parameters[i]);
+            break;
+        }
+        case Instruction::ALLOCATE_OBJECT:
+        {
+            AllocateObjectInstruction * allocate_instruction = (AllocateObjectInstruction *) instruction;
+            write_fingerprint(out, allocate_instruction->dest);
+            write_fingerprint(out, allocate_instruction->class_name);
+            out << " " << allocate_instruction->stack_offset;
+            break;
+        }
+        case Instruction::WRITE_POINTER:
+        {
+            WritePointerInstruction * write_instruction = (WritePointerInstruction *) instruction;
+            write_fingerprint(out, write_instruction->pointer);
+            write_fingerprint(out, write_instruction->source);
+            break;
+        }
+        case Instruction::READ_POINTER:
+        {
+            ReadPointerInstruction * read_instruction = (ReadPointerInstruction *) instruction;
+            write_fingerprint(out, read_instruction->dest);
+            write_fingerprint(out, read_instruction->source_pointer);
+            break;
+        }
+        case Instruction::ALLOCATE_ARRAY:
+        {
+            AllocateArrayInstruction * allocate_instruction = (AllocateArrayInstruction *) instruction;
+            write_fingerprint(out, allocate_instruction->dest);
+            out << " " << allocate_instruction->size << " " << allocate_instruction->references << " " << allocate_instruction->stack_offset;
+            break;
+        }
+        case Instruction::PHI:
+        {
+            PhiInstruction * phi_instruction = (PhiInstruction *) instruction;
+            write_fingerprint(out, phi_instruction->dest);
+            out << " " << phi_instruction->sources.size();
+            for (int i = 0; i < (int)phi_instruction->sources.size(); i++) {
+                out << " " << phi_instruction->parents[i];
+                write_fingerprint(out, phi_instruction->sources[i]);
+            }
+            break;
+        }
+        case Instruction::BOUNDS_CHECK:
+        {
+            BoundsCheckInstruction * check_instruction = (BoundsCheckInstruction *) instruction;
+            write_fingerprint(out, check_instruction->index);
+            out << " " << check_instruction->min << " " << check_instruction->max << " " << check_instruction->line_number;
+            break;
+        }
+    }
+}
+
+int MethodGenerator::parameter_register_count()
+{
+    int count = 1; // this
+    for (VariableDeclarationList * variable_list = m_function_declaration->parameter_list; variable_list != NULL; variable_list = variable_list->next) {
+        for (IdentifierList * id_list = variable_list->item->id_list; id_list != NULL; id_list = id_list->next)
+            count++;
+    }
+    return count;
+}
+
+int MethodGenerator::get_stack_variable_offset_in_bytes(int variable_number)
+{
+    return get_stack_space() - variable_number * 4 - 4;
+}
+
+void MethodGenerator::loadValue(std::ostream & out, Variant source_value, std::string dest_register)
+{
+    if (source_value.type == Variant::CONST_BOOL) {
+        out << "li " << dest_register << ", " << (source_value._bool ? 1 : 0) << std::endl;
+    } else if (source_value.type == Variant::CONST_INT) {
+        out << "li " << dest_register << ", " << source_value._int << std::endl;
+    } else if (source_value.type == Variant::REGISTER) {
+        out << "lw " << dest_register << ", " << get_stack_variable_offset_in_bytes(source_value._int) << "($sp)" << std::endl;
+    } else {
+        assert(false);
+    }
+}
+
+void MethodGenerator::allocateHeap(std::ostream & out, int dest_register_number, int size, std::string layout_label)
+{
+    // bump $fp through the current free span, and only call the allocator when it's used up
+    int block_size = (heap_header_size + size + 7) & ~7;
+    out << "move $t0, $fp" << std::endl;
+    // addi only has room for 16 bits, and a whole multidimensional array can be a lot bigger
+    if (block_size < 32768) {
+        out << "addi $fp, $fp, " << block_size << std::endl;
+    } else {
+        out << "li $t1, " << block_size << std::endl;
+        out << "add $fp, $fp, $t1" << std::endl;
+    }
+    int done_label = getNextUniqueLabel();
+    out << "sltu $t1, $s7, $fp" << std::endl;
+    out << "beq $t1, $0, l" << done_label << std::endl;
+    out << "li $a0, " << block_size << std::endl;
+    out << "jal _gc_allocate" << std::endl;
+    out << "l" << done_label << ":" << std::endl;
+    out << "la $t1, " << layout_label << std::endl;
+    out << "sw $t1, 0($t0)" << std::endl;
+    out << "li $t1, " << block_size << std::endl;
+    out << "sw $t1, 4($t0)" << std::endl;
+    out << "addi $t0, $t0, " << heap_header_size << std::endl;
+    storeRegister(out, dest_register_number, "$t0");
+}
+
+void MethodGenerator::allocateStack(std::ostream & out, int dest_register_number, int size, int stack_offset)
+{
+    // the frame has whatever was there before, and the heap would have been zeros
+    if (size <= 64) {
+        for (int i = 0; i < size; i += 4)
+            out << "sw $0, " << stack_offset + i << "($sp)" << std::endl;
+    } else {
+        int loop_label = getNextUniqueLabel();
+        out << "addi $t0, $sp, " << stack_offset << std::endl;
+        out << "addi $t1, $sp, " << stack_offset + size << std::endl;
+        out << "l" << loop_label << ":" << std::endl;
+        out << "sw $0, 0($t0)" << std::endl;
+        out << "addi $t0, $t0, 4" << std::endl;
+        out << "bne $t0, $t1, l" << loop_label << std::endl;
+    }
+    out << "addi $t0, $sp, " << stack_offset << std::endl;
+    storeRegister(out, dest_register_number, "$t0");
+}
+
+void MethodGenerator::print_frame_layout(std::ostream & out, std::string label)
+{
+    std::vector<int> pointer_offsets;
+    for (int i = 0; i < m_register_count; i++) {
+        if (m_register_type[i] == POINTER)
+            pointer_offsets.push_back(get_stack_variable_offset_in_bytes(i));
+    }
+    pointer_offsets.insert(pointer_offsets.end(), m_stack_pointer_offsets.begin(), m_stack_pointer_offsets.end());
+    out << "_frame_" << label << ": .word " << get_stack_space() << ", " << pointer_offsets.size();
+    for (int i = 0; i < (int)pointer_offsets.size(); i++)
+        out << ", " << pointer_offsets[i];
+    out << std::endl;
+}
+
+void MethodGenerator::storeRegister(std::ostream & out, int dest_register_number, std::string source_register)
+{
+    out << "sw " << source_register << ", " << get_stack_variable_offset_in_bytes(dest_register_number) << "($sp)" << std::endl;
+}
+
+int MethodGenerator::get_stack_space()
+{
+    return
+        // a slot for each register (all types are the same size: 4 bytes)
+        m_register_count * 4 +
+        // objects and arrays that don't escape
+        m_stack_allocation_size +
+        // a slot for return address (4 bytes)
         1 * 4;
 }
 
@@ -802,7 +2210,7 @@ void MethodGenerator::print_assembly(std::ostream & out)
                             out << "slt $t0, $t0, $t1" << std::endl;
                             break;
                         case OperatorInstruction::GREATER:
-                            out << "slt $t0, $t1, t0" << std::endl;
+                            out << "slt $t0, $t1, $t0" << std::endl;
                             break;
                         case OperatorInstruction::LESS_EQUAL:
                             out << "slt $t0, $t1, $t0" << std::endl;
@@ -864,15 +2272,18 @@ void MethodGenerator::print_assembly(std::ostream & out)
                     out << "j " << m_class_name << "_" << method_name << "_" << block->jump_child << std::endl;
                     break;
                 case Instruction::RETURN:
-                    if (m_function_declaration->type != NULL) {
+                {
+                    ReturnInstruction * return_instruction = (ReturnInstruction *) instruction;
+                    if (return_instruction->has_value) {
                         // put the result in $v0
-                        loadValue(out, m_variable_numbers.get(m_function_declaration->identifier->text), "$v0");
+                        loadValue(out, return_instruction->value, "$v0");
                     }
                     // deallocate stack
                     out << "lw $ra, 0($sp)" << std::endl;
                     out << "addi $sp, $sp, " << get_stack_space() << std::endl;
                     out << "jr $ra" << std::endl;
-                    return;
+                    break;
+                }
                 case Instruction::PRINT:
                 {
                     PrintInstruction * print_instruction = (PrintInstruction *) instruction;
@@ -924,16 +2335,24 @@ void MethodGenerator::print_assembly(std::ostream & out)
                 case Instruction::ALLOCATE_OBJECT:
                 {
                     AllocateObjectInstruction * allocate_instruction = (AllocateObjectInstruction *) instruction;
-                    storeRegister(out, allocate_instruction->dest._int, "$fp");
-                    int size = get_class_size_in_bytes(allocate_instruction->class_name, m_symbol_table);
-                    out << "addi $fp, $fp, " << size << std::endl;
+                    if (allocate_instruction->stack_offset != -1) {
+                        allocateStack(out, allocate_instruction->dest._int, get_class_size_in_bytes(allocate_instruction->class_name, m_symbol_table),
+                            allocate_instruction->stack_offset);
+                        break;
+                    }
+                    allocateHeap(out, allocate_instruction->dest._int, get_class_size_in_bytes(allocate_instruction->class_name, m_symbol_table),
+                        "_layout_" + Utils::to_lower(allocate_instruction->class_name));
                     break;
                 }
                 case Instruction::ALLOCATE_ARRAY:
                 {
                     AllocateArrayInstruction * allocate_instruction = (AllocateArrayInstruction *) instruction;
-                    storeRegister(out, allocate_instruction->dest._int, "$fp");
-                    out << "addi $fp, $fp, " << allocate_instruction->size << std::endl;
+                    if (allocate_instruction->stack_offset != -1) {
+                        allocateStack(out, allocate_instruction->dest._int, allocate_instruction->size, allocate_instruction->stack_offset);
+                        break;
+                    }
+                    allocateHeap(out, allocate_instruction->dest._int, allocate_instruction->size,
+                        allocate_instruction->references ? "_layout_references" : "_layout_values");
                     break;
                 }
                 case Instruction::WRITE_POINTER:
@@ -952,17 +2371,65 @@ void MethodGenerator::print_assembly(std::ostream & out)
                     storeRegister(out, read_pointer_instruction->dest._int, "$t0");
                     break;
                 }
+                case Instruction::BOUNDS_CHECK:
+                {
+                    BoundsCheckInstruction * bounds_check_instruction = (BoundsCheckInstruction *) instruction;
+                    loadValue(out, bounds_check_instruction->index, "$t0");
+                    out << "li $a0, " << bounds_check_instruction->line_number << std::endl;
+                    out << "li $t1, " << bounds_check_instruction->min << std::endl;
+                    out << "slt $t2, $t0, $t1" << std::endl;
+                    out << "bne $t2, $0, _bounds_error" << std::endl;
+                    out << "li $t1, " << bounds_check_instruction->max << std::endl;
+                    out << "slt $t2, $t1, $t0" << std::endl;
+                    out << "bne $t2, $0, _bounds_error" << std::endl;
+                    break;
+                }
+                case Instruction::PHI:
+                    // destruct_ssa should have turned these into copies
+                    assert(false);
+                    break;
             }
         }
     }
-    // should have been a return statement
-    assert(false);
 }
 
 int get_class_size_in_bytes(std::string class_name, SymbolTable * symbol_table)
 {
-    ClassSymbolTable * class_symbols = symbol_table->get(class_name);
-    return class_symbols->variables->count() * 4;
+    return get_class_layout(symbol_table, class_name)->size;
+}
+
+// arrays of arrays are laid out row-major in one block, so an inner array takes up its whole size
+int get_array_size_in_bytes(ArrayType * array_type)
+{
+    return (array_type->max->value - array_type->min->value + 1) * get_array_element_size_in_bytes(array_type);
+}
+
+void print_class_layout(std::ostream & out, std::string class_name, SymbolTable * symbol_table)
+{
+    std::vector<int> pointer_offsets;
+    insert_class_pointer_offsets(class_name, symbol_table, pointer_offsets);
+    out << "_layout_" << Utils::to_lower(class_name) << ": .word " << pointer_offsets.size();
+    for (int i = 0; i < (int)pointer_offsets.size(); i++)
+        out << ", " << pointer_offsets[i];
+    out << std::endl;
+}
+
+// the offsets of the fields the garbage collector has to follow, for the class and everything it extends
+void insert_class_pointer_offsets(std::string class_name, SymbolTable * symbol_table, std::vector<int> & pointer_offsets)
+{
+    ClassLayout * layout = get_class_layout(symbol_table, class_name);
+    for (int i = 0; i < (int)layout->fields.size(); i++) {
+        TypeDenoter * type = layout->fields[i]->type;
+        if (type->type == TypeDenoter::CLASS || type->type == TypeDenoter::ARRAY)
+            pointer_offsets.push_back(i * 4);
+    }
+}
+
+int get_array_element_size_in_bytes(ArrayType * array_type)
+{
+    if (array_type->type->type == TypeDenoter::ARRAY)
+        return get_array_size_in_bytes(array_type->type->array_type);
+    return 4;
 }
 
 void MethodGenerator::print_instruction(std::ostream & out, int address, Instruction * instruction) {
@@ -972,136 +2439,454 @@ void MethodGenerator::print_instruction(std::ostream & out, int address, Instruc
 }
 
 void MethodGenerator::print_basic_blocks(std::ostream & out) {
-    int block_count = 0;
     for (unsigned int b = 0; b < m_basic_blocks.size(); b++) {
         BasicBlock * block = m_basic_blocks[b];
         if (! block->deleted)
-            out << "block_" << block_count++ << ":" << std::endl;
+            out << "block_" << b << ":" << std::endl;
         int i = block->start;
         for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it, ++i)
             print_instruction(out, i, *it);
     }
 }
 
-void MethodGenerator::print_control_flow_graph(std::ostream & out) {
-    for (int parent = 0; parent < (int)m_basic_blocks.size(); parent++) {
-        BasicBlock * parent_block = m_basic_blocks[parent];
-        for (int child = 0; child < (int)m_basic_blocks.size(); child++) {
-            if (parent == child) {
-                // for self, print the number (ugly if more than 1 digit)
-                out << parent;
-            } else if (parent_block->jump_child == child || parent_block->fallthrough_child == child) {
-                // child is a child of parent
-                out << (child < parent ? "^" : "v");
-            } else {
-                // nothing to see here
-                out << " ";
-            }
-            out << " ";
-        }
-        out << std::endl;
+std::string escaped(std::string text) {
+    std::string result;
+    for (int i = 0; i < (int)text.size(); i++) {
+        if (text[i] == '"' || text[i] == '\\')
+            result += '\\';
+        result += text[i];
     }
+    return result;
 }
 
-MethodGenerator::RegisterType MethodGenerator::type_denoter_to_register_type(TypeDenoter * type) {
-    switch (type->type) {
-        case TypeDenoter::BOOLEAN:
-            return BOOL;
-        case TypeDenoter::INTEGER:
-            return INTEGER;
-        case TypeDenoter::REAL:
-            return REAL;
-        case TypeDenoter::CLASS:
-            return POINTER;
-        case TypeDenoter::ARRAY:
-            return POINTER;
-        default:
-            assert(false);
-            return BOOL; // BOOL is COOL
-    }
+std::string quoted(std::string text) {
+    return "\"" + escaped(text) + "\"";
 }
 
-void MethodGenerator::generate() {
-    m_variable_numbers.put("this", next_available_register(POINTER));
-    for (VariableDeclarationList * variable_list = m_function_declaration->parameter_list; variable_list != NULL; variable_list = variable_list->next) {
-        for (IdentifierList * id_list = variable_list->item->id_list; id_list != NULL; id_list = id_list->next)
-            m_variable_numbers.put(id_list->item->text, next_available_register(type_denoter_to_register_type(variable_list->item->type)));
-    }
-    if (m_function_declaration->type != NULL) {
-        // make a special return value variable
-        m_variable_numbers.put(m_function_declaration->identifier->text, next_available_register(type_denoter_to_register_type(m_function_declaration->type)));
-    }
-    for (VariableDeclarationList * variable_list = m_function_declaration->block->variable_list; variable_list != NULL; variable_list = variable_list->next) {
-        for (IdentifierList * id_list = variable_list->item->id_list; id_list != NULL; id_list = id_list->next)
-            m_variable_numbers.put(id_list->item->text, next_available_register(type_denoter_to_register_type(variable_list->item->type)));
+void MethodGenerator::print_control_flow_dot(std::ostream & out, std::string label) {
+    out << "subgraph " << quoted("cluster_" + label) << " {" << std::endl;
+    out << "label = " << quoted(label) << ";" << std::endl;
+    for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+        BasicBlock * block = m_basic_blocks[b];
+        if (block->deleted)
+            continue;
+        // \l ends a left justified line
+        std::stringstream text;
+        text << "block_" << b << ":\\l";
+        int i = block->start;
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it, ++i) {
+            std::stringstream instruction_text;
+            (*it)->print(instruction_text);
+            text << i << ": " << escaped(instruction_text.str()) << "\\l";
+        }
+        std::string node = quoted(label + "_" + Utils::to_string(b));
+        out << node << " [shape=box, label=\"" << text.str() << "\"];" << std::endl;
+        if (block->jump_child != -1)
+            out << node << " -> " << quoted(label + "_" + Utils::to_string(block->jump_child)) << " [label=\"jump\"];" << std::endl;
+        if (block->fallthrough_child != -1)
+            out << node << " -> " << quoted(label + "_" + Utils::to_string(block->fallthrough_child)) << ";" << std::endl;
     }
+    out << "}" << std::endl;
+}
 
-    // allocate local arrays
-    ClassSymbolTable * class_symbols = m_symbol_table->get(m_class_name);
-    FunctionSymbolTable * function_symbols = class_symbols->function_symbols->get(m_function_declaration->identifier->text);
-    for (int i = 0; i < function_symbols->variables->count(); ++i) {
-        VariableData * variable = function_symbols->variables->get(i);
-        if (variable->type == NULL || variable->type->type != TypeDenoter::ARRAY)
+void MethodGenerator::print_ir_json(std::ostream & out, std::string label) {
+    const char * register_type_names[] = {"integer", "real", "bool", "pointer"};
+    const char * instruction_type_names[] = {"copy", "operator", "unary", "if", "goto", "return", "print",
+        "method_call", "non_void_method_call", "allocate_object", "write_pointer", "read_pointer",
+        "allocate_array", "phi", "bounds_check"};
+    Liveness liveness;
+    calculate_live_registers(liveness);
+    BitVector live(m_register_count);
+
+    out << "{\"name\": " << quoted(label) << "," << std::endl;
+    out << "\"registers\": [";
+    for (int i = 0; i < m_register_count; i++)
+        out << (i > 0 ? ", " : "") << quoted(register_type_names[m_register_type[i]]);
+    out << "]," << std::endl;
+    out << "\"blocks\": [";
+    bool first_block = true;
+    for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+        BasicBlock * block = m_basic_blocks[b];
+        if (block->deleted)
             continue;
+        out << (first_block ? "" : ",") << std::endl;
+        first_block = false;
+        out << "{\"index\": " << b << ", \"jump\": ";
+        if (block->jump_child == -1)
+            out << "null";
+        else
+            out << block->jump_child;
+        out << ", \"fallthrough\": ";
+        if (block->fallthrough_child == -1)
+            out << "null";
+        else
+            out << block->fallthrough_child;
+
+        for (int side = 0; side < 2; side++) {
+            if (side == 0) {
+                out << ", \"live_in\": [";
+                liveness.get_live_in(b, live);
+            } else {
+                out << "], \"live_out\": [";
+                liveness.get_live_out(b, live);
+            }
+            bool first_register = true;
+            for (int r = live.next(0); r != -1; r = live.next(r + 1)) {
+                out << (first_register ? "" : ", ") << r;
+                first_register = false;
+            }
+        }
+        out << "]," << std::endl;
 
-        Variant value = gen_initialize_array(variable->type);
-        m_instructions.push_back(new CopyInstruction(m_variable_numbers.get(variable->name), value));
+        out << "\"instructions\": [";
+        int i = block->start;
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it, ++i) {
+            std::stringstream text;
+            (*it)->print(text);
+            out << (it != block->instructions.begin() ? "," : "") << std::endl;
+            out << "{\"address\": " << i << ", \"type\": " << quoted(instruction_type_names[(*it)->type]) <<
+                ", \"text\": " << quoted(text.str()) << "}";
+        }
+        out << "]}";
     }
-
-    gen_statement_list(m_function_declaration->block->statement_list);
-
-    m_instructions.push_back(new ReturnInstruction());
+    out << "]}";
 }
 
-void MethodGenerator::gen_statement_list(StatementList * statement_list) {
-    for (StatementList * statement_list_node = statement_list; statement_list_node != NULL; statement_list_node = statement_list_node->next) {
-        if (statement_list_node->item != NULL)
-            gen_statement(statement_list_node->item);
+void MethodGenerator::translate(IrMethod & method, std::string label) {
+    method.label = label;
+    method.register_count = m_register_count;
+    method.stack_allocation_size = m_stack_allocation_size;
+    method.initial_frame.assign(m_register_count, 0);
+    for (int i = 0; i < m_register_count; i++) {
+        if (m_register_type[i] == POINTER)
+            method.pointer_registers.push_back(i);
+    }
+    // the interpreter's frames don't have the return address in front
+    for (int i = 0; i < (int)m_stack_pointer_offsets.size(); i++)
+        method.stack_pointer_offsets.push_back(m_stack_pointer_offsets[i] - 4);
+    std::map<Variant, int> constant_slots;
+    std::map<std::string, int> callee_targets;
+
+    // one operation per instruction, so we know where every block starts before the jumps need it
+    std::vector<int> block_start(m_basic_blocks.size(), -1);
+    int operation_count = 0;
+    for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+        if (m_basic_blocks[b]->deleted)
+            continue;
+        block_start[b] = operation_count;
+        operation_count += m_basic_blocks[b]->instructions.size();
     }
-}
-
-void MethodGenerator::gen_statement(Statement * statement) {
-    switch (statement->type) {
-        case Statement::ASSIGNMENT:
-        {
-            Variant source = gen_expression(statement->assignment->expression);
-            gen_assignment(statement->assignment->variable, source);
-            break;
-        }
-        case Statement::IF:
-        {
-            Variant condition = gen_expression(statement->if_statement->expression);
-
-            IfInstruction * if_instruction = new IfInstruction(condition, -1);
-            m_instructions.push_back(if_instruction);
-
-            gen_statement(statement->if_statement->then_statement);
-            if (statement->if_statement->else_statement != NULL) {
-                GotoInstruction * goto_instruction = new GotoInstruction(-1);
-                m_instructions.push_back(goto_instruction);
-                if_instruction->goto_index = m_instructions.size();
-                gen_statement(statement->if_statement->else_statement);
-                goto_instruction->goto_index = m_instructions.size();
-            } else {
-                if_instruction->goto_index = m_instructions.size();
-            }
 
-            break;
-        }
-        case Statement::PRINT:
-        {
-            Variant value = gen_expression(statement->print_statement->expression);
-            m_instructions.push_back(new PrintInstruction(value));
-            break;
+    for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+        BasicBlock * block = m_basic_blocks[b];
+        if (block->deleted)
+            continue;
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+            Instruction * instruction = *it;
+            switch (instruction->type) {
+                case Instruction::COPY:
+                {
+                    CopyInstruction * copy_instruction = (CopyInstruction *) instruction;
+                    IrOperation operation(IrOperation::COPY);
+                    operation.dest = copy_instruction->dest._int;
+                    operation.left = get_ir_slot(method, constant_slots, copy_instruction->source);
+                    method.operations.push_back(operation);
+                    break;
+                }
+                case Instruction::OPERATOR:
+                {
+                    // the operators are in the same order in both
+                    OperatorInstruction * operator_instruction = (OperatorInstruction *) instruction;
+                    IrOperation operation((IrOperation::Opcode) (IrOperation::EQUAL + operator_instruction->_operator));
+                    operation.dest = operator_instruction->dest._int;
+                    operation.left = get_ir_slot(method, constant_slots, operator_instruction->left);
+                    operation.right = get_ir_slot(method, constant_slots, operator_instruction->right);
+                    method.operations.push_back(operation);
+                    break;
+                }
+                case Instruction::UNARY:
+                {
+                    UnaryInstruction * unary_instruction = (UnaryInstruction *) instruction;
+                    IrOperation operation(unary_instruction->_operator == UnaryInstruction::NOT ? IrOperation::NOT : IrOperation::NEGATE);
+                    operation.dest = unary_instruction->dest._int;
+                    operation.left = get_ir_slot(method, constant_slots, unary_instruction->source);
+                    method.operations.push_back(operation);
+                    break;
+                }
+                case Instruction::IF:
+                {
+                    IfInstruction * if_instruction = (IfInstruction *) instruction;
+                    IrOperation operation(IrOperation::IF_NOT);
+                    operation.left = get_ir_slot(method, constant_slots, if_instruction->condition);
+                    operation.target = block_start[block->jump_child];
+                    method.operations.push_back(operation);
+                    break;
+                }
+                case Instruction::GOTO:
+                {
+                    IrOperation operation(IrOperation::GOTO);
+                    operation.target = block_start[block->jump_child];
+                    method.operations.push_back(operation);
+                    break;
+                }
+                case Instruction::RETURN:
+                {
+                    ReturnInstruction * return_instruction = (ReturnInstruction *) instruction;
+                    IrOperation operation(IrOperation::RETURN);
+                    if (return_instruction->has_value)
+                        operation.left = get_ir_slot(method, constant_slots, return_instruction->value);
+                    method.operations.push_back(operation);
+                    break;
+                }
+                case Instruction::PRINT:
+                {
+                    // booleans print as words, the same test print_assembly does
+                    PrintInstruction * print_instruction = (PrintInstruction *) instruction;
+                    Variant value = print_instruction->value;
+                    bool is_bool = value.type == Variant::REGISTER ? m_register_type.at(value._int) == BOOL : value.type == Variant::CONST_BOOL;
+                    IrOperation operation(is_bool ? IrOperation::PRINT_BOOL : IrOperation::PRINT_INT);
+                    operation.left = get_ir_slot(method, constant_slots, value);
+                    method.operations.push_back(operation);
+                    break;
+                }
+                case Instruction::NON_VOID_METHOD_CALL:
+                case Instruction::METHOD_CALL:
+                {
+                    MethodCallInstruction * method_call_instruction = (MethodCallInstruction *) instruction;
+                    std::string callee = Utils::to_lower(method_call_instruction->class_name) + "_" + Utils::to_lower(method_call_instruction->method_name);
+                    if (! callee_targets.count(callee)) {
+                        callee_targets[callee] = method.callees.size();
+                        method.callees.push_back(callee);
+                    }
+                    IrOperation operation(IrOperation::CALL);
+                    operation.target = callee_targets[callee];
+                    operation.left = method.arguments.size();
+                    operation.right = method_call_instruction->parameters.size();
+                    for (int i = 0; i < (int)method_call_instruction->parameters.size(); i++)
+                        method.arguments.push_back(get_ir_slot(method, constant_slots, method_call_instruction->parameters[i]));
+                    if (instruction->type == Instruction::NON_VOID_METHOD_CALL)
+                        operation.dest = ((NonVoidMethodCallInstruction *) method_call_instruction)->dest._int;
+                    method.operations.push_back(operation);
+                    break;
+                }
+                case Instruction::ALLOCATE_OBJECT:
+                case Instruction::ALLOCATE_ARRAY:
+                {
+                    int size;
+                    int stack_offset;
+                    Variant dest;
+                    std::vector<int> pointer_offsets;
+                    if (instruction->type == Instruction::ALLOCATE_OBJECT) {
+                        AllocateObjectInstruction * allocate_instruction = (AllocateObjectInstruction *) instruction;
+                        size = get_class_size_in_bytes(allocate_instruction->class_name, m_symbol_table);
+                        stack_offset = allocate_instruction->stack_offset;
+                        dest = allocate_instruction->dest;
+                        insert_class_pointer_offsets(allocate_instruction->class_name, m_symbol_table, pointer_offsets);
+                    } else {
+                        AllocateArrayInstruction * allocate_instruction = (AllocateArrayInstruction *) instruction;
+                        size = allocate_instruction->size;
+                        stack_offset = allocate_instruction->stack_offset;
+                        dest = allocate_instruction->dest;
+                        if (allocate_instruction->references)
+                            pointer_offsets.push_back(-1);
+                    }
+                    IrOperation operation(stack_offset == -1 ? IrOperation::ALLOCATE_HEAP : IrOperation::ALLOCATE_STACK);
+                    operation.dest = dest._int;
+                    operation.target = size;
+                    if (stack_offset == -1) {
+                        operation.min = method.layouts.size();
+                        method.layouts.push_back(pointer_offsets);
+                    } else {
+                        operation.right = stack_offset - 4;
+                    }
+                    method.operations.push_back(operation);
+                    break;
+                }
+                case Instruction::WRITE_POINTER:
+                {
+                    WritePointerInstruction * write_pointer_instruction = (WritePointerInstruction *) instruction;
+                    IrOperation operation(IrOperation::WRITE_POINTER);
+                    operation.left = get_ir_slot(method, constant_slots, write_pointer_instruction->pointer);
+                    operation.right = get_ir_slot(method, constant_slots, write_pointer_instruction->source);
+                    method.operations.push_back(operation);
+                    break;
+                }
+                case Instruction::READ_POINTER:
+                {
+                    ReadPointerInstruction * read_pointer_instruction = (ReadPointerInstruction *) instruction;
+                    IrOperation operation(IrOperation::READ_POINTER);
+                    operation.dest = read_pointer_instruction->dest._int;
+                    operation.left = get_ir_slot(method, constant_slots, read_pointer_instruction->source_pointer);
+                    method.operations.push_back(operation);
+                    break;
+                }
+                case Instruction::BOUNDS_CHECK:
+                {
+                    BoundsCheckInstruction * bounds_check_instruction = (BoundsCheckInstruction *) instruction;
+                    IrOperation operation(IrOperation::BOUNDS_CHECK);
+                    operation.left = get_ir_slot(method, constant_slots, bounds_check_instruction->index);
+                    operation.target = bounds_check_instruction->line_number;
+                    operation.min = bounds_check_instruction->min;
+                    operation.max = bounds_check_instruction->max;
+                    method.operations.push_back(operation);
+                    break;
+                }
+                case Instruction::PHI:
+                    // destruct_ssa should have turned these into copies
+                    assert(false);
+                    break;
+            }
+        }
+    }
+    // the assembly would run into the next method. the generator always ends with a return anyway.
+    method.operations.push_back(IrOperation(IrOperation::RETURN));
+}
+
+int MethodGenerator::get_ir_slot(IrMethod & method, std::map<Variant, int> & constant_slots, Variant value) {
+    switch (value.type) {
+        case Variant::REGISTER:
+            return value._int;
+        case Variant::CONST_INT:
+        case Variant::CONST_BOOL:
+        {
+            std::map<Variant, int>::iterator it = constant_slots.find(value);
+            if (it != constant_slots.end())
+                return it->second;
+            int slot = method.initial_frame.size();
+            method.initial_frame.push_back(value.type == Variant::CONST_BOOL ? (int) value._bool : value._int);
+            constant_slots[value] = slot;
+            return slot;
+        }
+        case Variant::CONST_REAL:
+            // loadValue can't do these either
+            assert(false);
+            break;
+    }
+    return -1;
+}
+
+void MethodGenerator::print_control_flow_graph(std::ostream & out) {
+    for (int parent = 0; parent < (int)m_basic_blocks.size(); parent++) {
+        BasicBlock * parent_block = m_basic_blocks[parent];
+        for (int child = 0; child < (int)m_basic_blocks.size(); child++) {
+            if (parent == child) {
+                // for self, print the number (ugly if more than 1 digit)
+                out << parent;
+            } else if (parent_block->jump_child == child || parent_block->fallthrough_child == child) {
+                // child is a child of parent
+                out << (child < parent ? "^" : "v");
+            } else {
+                // nothing to see here
+                out << " ";
+            }
+            out << " ";
+        }
+        out << std::endl;
+    }
+}
+
+MethodGenerator::RegisterType MethodGenerator::type_denoter_to_register_type(TypeDenoter * type) {
+    switch (type->type) {
+        case TypeDenoter::BOOLEAN:
+            return BOOL;
+        case TypeDenoter::INTEGER:
+            return INTEGER;
+        case TypeDenoter::REAL:
+            return REAL;
+        case TypeDenoter::CLASS:
+            return POINTER;
+        case TypeDenoter::ARRAY:
+            return POINTER;
+        default:
+            assert(false);
+            return BOOL; // BOOL is COOL
+    }
+}
+
+void MethodGenerator::generate() {
+    m_variable_numbers.put("this", next_available_register(POINTER));
+    for (VariableDeclarationList * variable_list = m_function_declaration->parameter_list; variable_list != NULL; variable_list = variable_list->next) {
+        for (IdentifierList * id_list = variable_list->item->id_list; id_list != NULL; id_list = id_list->next)
+            m_variable_numbers.put(id_list->item->text, next_available_register(type_denoter_to_register_type(variable_list->item->type)));
+    }
+    if (m_function_declaration->type != NULL) {
+        // make a special return value variable
+        m_variable_numbers.put(m_function_declaration->identifier->text, next_available_register(type_denoter_to_register_type(m_function_declaration->type)));
+    }
+    for (VariableDeclarationList * variable_list = m_function_declaration->block->variable_list; variable_list != NULL; variable_list = variable_list->next) {
+        for (IdentifierList * id_list = variable_list->item->id_list; id_list != NULL; id_list = id_list->next)
+            m_variable_numbers.put(id_list->item->text, next_available_register(type_denoter_to_register_type(variable_list->item->type)));
+    }
+
+    // allocate local arrays
+    ClassSymbolTable * class_symbols = m_symbol_table->get(m_class_name);
+    FunctionSymbolTable * function_symbols = class_symbols->function_symbols->get(m_function_declaration->identifier->text);
+    for (int i = 0; i < function_symbols->variables->count(); ++i) {
+        VariableData * variable = function_symbols->variables->get(i);
+        if (variable->type == NULL || variable->type->type != TypeDenoter::ARRAY)
+            continue;
+
+        Variant value = gen_initialize_array(variable->type);
+        m_instructions.push_back(new (m_instruction_arena) CopyInstruction(m_variable_numbers.get(variable->name), value));
+    }
+
+    gen_statement_list(m_function_declaration->block->statement_list);
+
+    if (m_function_declaration->type != NULL)
+        m_instructions.push_back(new (m_instruction_arena) ReturnInstruction(m_variable_numbers.get(m_function_declaration->identifier->text)));
+    else
+        m_instructions.push_back(new (m_instruction_arena) ReturnInstruction());
+}
+
+void MethodGenerator::gen_statement_list(StatementList * statement_list) {
+    for (StatementList * statement_list_node = statement_list; statement_list_node != NULL; statement_list_node = statement_list_node->next) {
+        if (statement_list_node->item != NULL)
+            gen_statement(statement_list_node->item);
+    }
+}
+
+void MethodGenerator::gen_statement(Statement * statement) {
+    switch (statement->type) {
+        case Statement::ASSIGNMENT:
+        {
+            Variant source = gen_expression(statement->assignment->expression);
+            gen_assignment(statement->assignment->variable, source);
+            break;
+        }
+        case Statement::IF:
+        {
+            Variant condition = gen_expression(statement->if_statement->expression);
+
+            IfInstruction * if_instruction = new (m_instruction_arena) IfInstruction(condition, -1);
+            m_instructions.push_back(if_instruction);
+
+            gen_statement(statement->if_statement->then_statement);
+            if (statement->if_statement->else_statement != NULL) {
+                GotoInstruction * goto_instruction = new (m_instruction_arena) GotoInstruction(-1);
+                m_instructions.push_back(goto_instruction);
+                if_instruction->goto_index = m_instructions.size();
+                gen_statement(statement->if_statement->else_statement);
+                goto_instruction->goto_index = m_instructions.size();
+            } else {
+                if_instruction->goto_index = m_instructions.size();
+            }
+
+            break;
+        }
+        case Statement::PRINT:
+        {
+            Variant value = gen_expression(statement->print_statement->expression);
+            m_instructions.push_back(new (m_instruction_arena) PrintInstruction(value));
+            break;
         }
         case Statement::WHILE:
         {
             int while_start = m_instructions.size();
             Variant condition = gen_expression(statement->while_statement->expression);
-            IfInstruction * if_instruction = new IfInstruction(condition, -1);
+            IfInstruction * if_instruction = new (m_instruction_arena) IfInstruction(condition, -1);
             m_instructions.push_back(if_instruction);
             gen_statement(statement->while_statement->statement);
-            m_instructions.push_back(new GotoInstruction(while_start));
+            m_instructions.push_back(new (m_instruction_arena) GotoInstruction(while_start));
             if_instruction->goto_index = m_instructions.size();
             break;
         }
@@ -1126,8 +2911,8 @@ bool MethodGenerator::gen_method_designator(MethodDesignator * method_designator
     FunctionDeclaration * declaration = get_method(m_symbol_table, class_name, method_name);
     bool non_void = declaration->type != NULL;
     MethodCallInstruction * instruction = non_void ?
-                                          new NonVoidMethodCallInstruction(class_name, method_name) :
-                                          new MethodCallInstruction(class_name, method_name);
+                                          new (m_instruction_arena) NonVoidMethodCallInstruction(class_name, method_name) :
+                                          new (m_instruction_arena) MethodCallInstruction(class_name, method_name);
     instruction->parameters.push_back(gen_variable_access(method_designator->owner));
     for (ExpressionList * parameter_list = method_designator->function->parameter_list; parameter_list != NULL; parameter_list = parameter_list->next) {
         Expression * expression = parameter_list->item;
@@ -1155,7 +2940,7 @@ MethodGenerator::Variant MethodGenerator::gen_expression(Expression * expression
         Variant right = gen_additive_expression(expression->right);
         Variant dest = next_available_register(type_denoter_to_register_type(expression->type));
         OperatorInstruction::Operator _operator = (OperatorInstruction::Operator)(expression->_operator->type + OperatorInstruction::EQUAL); // LOL HAX!
-        m_instructions.push_back(new OperatorInstruction(dest, left, _operator, right));
+        m_instructions.push_back(new (m_instruction_arena) OperatorInstruction(dest, left, _operator, right));
         return dest;
     }
 }
@@ -1170,7 +2955,7 @@ MethodGenerator::Variant MethodGenerator::gen_additive_expression(AdditiveExpres
         Variant left = gen_additive_expression(additive_expression->left);
         Variant dest = next_available_register(type_denoter_to_register_type(additive_expression->type));
         OperatorInstruction::Operator _operator = (OperatorInstruction::Operator)(additive_expression->_operator->type + OperatorInstruction::PLUS);
-        m_instructions.push_back(new OperatorInstruction(dest, left, _operator, right));
+        m_instructions.push_back(new (m_instruction_arena) OperatorInstruction(dest, left, _operator, right));
         return dest;
     }
 }
@@ -1185,7 +2970,7 @@ MethodGenerator::Variant MethodGenerator::gen_multiplicitive_expression(Multipli
         Variant left = gen_multiplicitive_expression(multiplicative_expression->left);
         Variant dest = next_available_register(type_denoter_to_register_type(multiplicative_expression->type));
         OperatorInstruction::Operator _operator = (OperatorInstruction::Operator)(multiplicative_expression->_operator->type + OperatorInstruction::TIMES);
-        m_instructions.push_back(new OperatorInstruction(dest, left, _operator, right));
+        m_instructions.push_back(new (m_instruction_arena) OperatorInstruction(dest, left, _operator, right));
         return dest;
     }
 }
@@ -1196,7 +2981,7 @@ MethodGenerator::Variant MethodGenerator::gen_negatable_expression(NegatableExpr
     } else if (negatable_expression->type == NegatableExpression::SIGN) {
         Variant source = gen_negatable_expression(negatable_expression->next);
         Variant dest = next_available_register(type_denoter_to_register_type(negatable_expression->variable_type));
-        m_instructions.push_back(new UnaryInstruction(dest, UnaryInstruction::NEGATE, source));
+        m_instructions.push_back(new (m_instruction_arena) UnaryInstruction(dest, UnaryInstruction::NEGATE, source));
         return dest;
     } else {
         assert(false);
@@ -1207,20 +2992,40 @@ MethodGenerator::Variant MethodGenerator::gen_negatable_expression(NegatableExpr
 MethodGenerator::Variant MethodGenerator::gen_initialize_array(TypeDenoter * type) {
     assert(type->type == TypeDenoter::ARRAY);
 
-    int count = type->array_type->max->value - type->array_type->min->value + 1;
+    // inner arrays are part of the same allocation
+    TypeDenoter * element_type = type->array_type->type;
+    while (element_type->type == TypeDenoter::ARRAY)
+        element_type = element_type->array_type->type;
     Variant base_array_pointer = next_available_register(POINTER);
-    m_instructions.push_back(new AllocateArrayInstruction(base_array_pointer, count * 4));
-    if (type->array_type->type->type == TypeDenoter::ARRAY) {
-        for (int i = 0; i < count; ++i) {
-            Variant entry_pointer = next_available_register(POINTER);
-            m_instructions.push_back(new OperatorInstruction(entry_pointer, base_array_pointer, OperatorInstruction::PLUS, Variant(i*4, Variant::CONST_INT)));
-            Variant value = gen_initialize_array(type->array_type->type);
-            m_instructions.push_back(new WritePointerInstruction(entry_pointer, value));
-        }
-    }
+    m_instructions.push_back(new (m_instruction_arena) AllocateArrayInstruction(base_array_pointer, get_array_size_in_bytes(type->array_type), element_type->type == TypeDenoter::CLASS));
     return base_array_pointer;
 }
 
+void MethodGenerator::gen_copy_array(Variant dest_pointer, Variant source_pointer, ArrayType * array_type) {
+    // a row of a multidimensional array can't be pointed somewhere else, so copy into it word by word
+    TypeDenoter * element_type = array_type->type;
+    while (element_type->type == TypeDenoter::ARRAY)
+        element_type = element_type->array_type->type;
+
+    Variant offset = next_available_register(INTEGER);
+    m_instructions.push_back(new (m_instruction_arena) CopyInstruction(offset, Variant(0, Variant::CONST_INT)));
+    int loop_start = m_instructions.size();
+    Variant condition = next_available_register(BOOL);
+    m_instructions.push_back(new (m_instruction_arena) OperatorInstruction(condition, offset, OperatorInstruction::LESS, Variant(get_array_size_in_bytes(array_type), Variant::CONST_INT)));
+    IfInstruction * if_instruction = new (m_instruction_arena) IfInstruction(condition, -1);
+    m_instructions.push_back(if_instruction);
+    Variant source_element_pointer = next_available_register(POINTER);
+    m_instructions.push_back(new (m_instruction_arena) OperatorInstruction(source_element_pointer, source_pointer, OperatorInstruction::PLUS, offset));
+    Variant value = next_available_register(type_denoter_to_register_type(element_type));
+    m_instructions.push_back(new (m_instruction_arena) ReadPointerInstruction(value, source_element_pointer));
+    Variant dest_element_pointer = next_available_register(POINTER);
+    m_instructions.push_back(new (m_instruction_arena) OperatorInstruction(dest_element_pointer, dest_pointer, OperatorInstruction::PLUS, offset));
+    m_instructions.push_back(new (m_instruction_arena) WritePointerInstruction(dest_element_pointer, value));
+    m_instructions.push_back(new (m_instruction_arena) OperatorInstruction(offset, offset, OperatorInstruction::PLUS, Variant(4, Variant::CONST_INT)));
+    m_instructions.push_back(new (m_instruction_arena) GotoInstruction(loop_start));
+    if_instruction->goto_index = m_instructions.size();
+}
+
 MethodGenerator::Variant MethodGenerator::gen_primary_expression(PrimaryExpression * primary_expression) {
     switch (primary_expression->type) {
         case PrimaryExpression::VARIABLE:
@@ -1229,21 +3034,21 @@ MethodGenerator::Variant MethodGenerator::gen_primary_expression(PrimaryExpressi
         {
             Variant dest = next_available_register(INTEGER);
             int constant = primary_expression->literal_integer->value;
-            m_instructions.push_back(new CopyInstruction(dest, Variant(constant, Variant::CONST_INT)));
+            m_instructions.push_back(new (m_instruction_arena) CopyInstruction(dest, Variant(constant, Variant::CONST_INT)));
             return dest;
         }
         case PrimaryExpression::BOOLEAN:
         {
             Variant dest = next_available_register(BOOL);
             bool constant = primary_expression->literal_boolean->value;
-            m_instructions.push_back(new CopyInstruction(dest, Variant(constant)));
+            m_instructions.push_back(new (m_instruction_arena) CopyInstruction(dest, Variant(constant)));
             return dest;
         }
         case PrimaryExpression::REAL:
         {
             Variant dest = next_available_register(REAL);
             float constant = primary_expression->literal_real->value;
-            m_instructions.push_back(new CopyInstruction(dest, Variant(constant)));
+            m_instructions.push_back(new (m_instruction_arena) CopyInstruction(dest, Variant(constant)));
             return dest;
         }
         case PrimaryExpression::PARENS:
@@ -1252,7 +3057,7 @@ MethodGenerator::Variant MethodGenerator::gen_primary_expression(PrimaryExpressi
         {
             Variant dest = next_available_register(BOOL);
             Variant source = gen_primary_expression(primary_expression->not_expression);
-            m_instructions.push_back(new UnaryInstruction(dest, UnaryInstruction::NOT, source));
+            m_instructions.push_back(new (m_instruction_arena) UnaryInstruction(dest, UnaryInstruction::NOT, source));
             return dest;
         }
         case PrimaryExpression::OBJECT_INSTANTIATION:
@@ -1260,24 +3065,25 @@ MethodGenerator::Variant MethodGenerator::gen_primary_expression(PrimaryExpressi
             Variant new_object_pointer = next_available_register(POINTER);
             // make the instance
             std::string class_name = primary_expression->object_instantiation->class_identifier->text;
-            m_instructions.push_back(new AllocateObjectInstruction(new_object_pointer, class_name));
+            m_instructions.push_back(new (m_instruction_arena) AllocateObjectInstruction(new_object_pointer, class_name));
             ClassSymbolTable * class_symbols = m_symbol_table->get(class_name);
 
-            // allocate its arrays
-            for (int i = 0; i < class_symbols->variables->count(); ++i) {
-                VariableData * variable = class_symbols->variables->get(i);
+            // allocate its arrays, inherited ones too
+            ClassLayout * layout = get_class_layout(m_symbol_table, class_name);
+            for (int i = 0; i < (int)layout->fields.size(); ++i) {
+                VariableData * variable = layout->fields[i];
                 if (variable->type->type != TypeDenoter::ARRAY)
                     continue;
-                int field_offset = get_field_offset_in_bytes(class_name, variable->name);
+                int field_offset = i * 4;
                 Variant field_pointer = next_available_register(POINTER);
-                m_instructions.push_back(new OperatorInstruction(field_pointer, new_object_pointer, OperatorInstruction::PLUS, Variant(field_offset, Variant::CONST_INT)));
+                m_instructions.push_back(new (m_instruction_arena) OperatorInstruction(field_pointer, new_object_pointer, OperatorInstruction::PLUS, Variant(field_offset, Variant::CONST_INT)));
                 Variant value = gen_initialize_array(variable->type);
-                m_instructions.push_back(new WritePointerInstruction(field_pointer, value));
+                m_instructions.push_back(new (m_instruction_arena) WritePointerInstruction(field_pointer, value));
             }
 
             bool has_constructor = class_symbols->function_symbols->has_key(class_name);
             if (has_constructor) {
-                MethodCallInstruction * method_call = new MethodCallInstruction(class_name, class_name);
+                MethodCallInstruction * method_call = new (m_instruction_arena) MethodCallInstruction(class_name, class_name);
                 method_call->parameters.push_back(new_object_pointer);
                 for (ExpressionList * expression_list = primary_expression->object_instantiation->parameter_list; expression_list != NULL; expression_list = expression_list->next) {
                     Expression * expression = expression_list->item;
@@ -1305,7 +3111,7 @@ MethodGenerator::Variant MethodGenerator::gen_attribute_pointer(AttributeDesigna
     std::string owner_class_name = get_class_name(get_class_type(attribute->owner));
     int offset = get_field_offset_in_bytes(owner_class_name, attribute->identifier->text);
     Variant pointer_register = next_available_register(POINTER);
-    m_instructions.push_back(new OperatorInstruction(pointer_register, owner_class_ref, OperatorInstruction::PLUS, Variant(offset, Variant::CONST_INT)));
+    m_instructions.push_back(new (m_instruction_arena) OperatorInstruction(pointer_register, owner_class_ref, OperatorInstruction::PLUS, Variant(offset, Variant::CONST_INT)));
     return pointer_register;
 }
 
@@ -1315,22 +3121,27 @@ MethodGenerator::Variant MethodGenerator::gen_array_pointer(IndexedVariable * in
     for (ExpressionList * expression_list = indexed_variable->expression_list; expression_list != NULL; expression_list = expression_list->next) {
         Expression * expression = expression_list->item;
         Variant index = gen_expression(expression);
-        if (array_type->min != 0) {
+        if (m_bounds_check) {
+            m_instructions.push_back(new (m_instruction_arena) BoundsCheckInstruction(index, array_type->min->value, array_type->max->value,
+                variable_access_line_number(indexed_variable->variable)));
+        }
+        if (array_type->min->value != 0) {
             Variant corrected_index = next_available_register(INTEGER);
-            m_instructions.push_back(new OperatorInstruction(corrected_index, index, OperatorInstruction::MINUS, Variant(array_type->min->value, Variant::CONST_INT)));
+            m_instructions.push_back(new (m_instruction_arena) OperatorInstruction(corrected_index, index, OperatorInstruction::MINUS, Variant(array_type->min->value, Variant::CONST_INT)));
             index = corrected_index;
         }
+        // rows are stored one after the other, so step over whole rows for the outer dimensions
         Variant bytes_offset = next_available_register(INTEGER);
-        m_instructions.push_back(new OperatorInstruction(bytes_offset, index, OperatorInstruction::TIMES, Variant(4, Variant::CONST_INT)));
+        m_instructions.push_back(new (m_instruction_arena) OperatorInstruction(bytes_offset, index, OperatorInstruction::TIMES, Variant(get_array_element_size_in_bytes(array_type), Variant::CONST_INT)));
         Variant array_pointer = next_available_register(POINTER);
-        m_instructions.push_back(new OperatorInstruction(array_pointer, array_ref, OperatorInstruction::PLUS, bytes_offset));
+        m_instructions.push_back(new (m_instruction_arena) OperatorInstruction(array_pointer, array_ref, OperatorInstruction::PLUS, bytes_offset));
 
         if (expression_list->next == NULL)
             return array_pointer;
 
-        // dereference array_pointer
-        array_ref = next_available_register(POINTER);
-        m_instructions.push_back(new ReadPointerInstruction(array_ref, array_pointer));
+        array_ref = array_pointer;
+        assert(array_type->type->type == TypeDenoter::ARRAY);
+        array_type = array_type->type->array_type;
     }
     assert(false);
     return array_ref;
@@ -1353,17 +3164,9 @@ TypeDenoter * MethodGenerator::variable_access_type(VariableAccess * variable_ac
         }
         case VariableAccess::INDEXED_VARIABLE:
         {
-            int iterations_to_here = 0;
-            while (true) {
-                if (variable_access->type == VariableAccess::INDEXED_VARIABLE) {
-                    iterations_to_here++;
-                    variable_access = variable_access->indexed_variable->variable;
-                } else {
-                    break;
-                }
-            }
-            TypeDenoter * type = variable_access_type(variable_access);
-            for (int i=0; i<iterations_to_here; ++i) {
+            // one dimension for each index, whether they're written a[i][j] or a[i, j]
+            TypeDenoter * type = variable_access_type(variable_access->indexed_variable->variable);
+            for (ExpressionList * expression_list = variable_access->indexed_variable->expression_list; expression_list != NULL; expression_list = expression_list->next) {
                 assert(type->type == TypeDenoter::ARRAY);
                 type = type->array_type->type;
             }
@@ -1377,6 +3180,22 @@ TypeDenoter * MethodGenerator::variable_access_type(VariableAccess * variable_ac
 }
 
 
+int MethodGenerator::variable_access_line_number(VariableAccess * variable_access) {
+    switch (variable_access->type) {
+        case VariableAccess::IDENTIFIER:
+            return variable_access->identifier->line_number;
+        case VariableAccess::ATTRIBUTE:
+            return variable_access->attribute->identifier->line_number;
+        case VariableAccess::INDEXED_VARIABLE:
+            return variable_access_line_number(variable_access->indexed_variable->variable);
+        case VariableAccess::THIS:
+            return m_function_declaration->identifier->line_number;
+        default:
+            assert(false);
+    }
+    return -1;
+}
+
 MethodGenerator::Variant MethodGenerator::gen_variable_access(VariableAccess * variable) {
     switch (variable->type) {
         case VariableAccess::IDENTIFIER:
@@ -1386,15 +3205,20 @@ MethodGenerator::Variant MethodGenerator::gen_variable_access(VariableAccess * v
         case VariableAccess::ATTRIBUTE:
         {
             Variant dest = next_available_register(type_denoter_to_register_type(get_field(m_symbol_table, get_class_name(get_class_type(variable->attribute->owner)), variable->attribute->identifier->text)->type));
-            m_instructions.push_back(new ReadPointerInstruction(dest, gen_attribute_pointer(variable->attribute)));
+            m_instructions.push_back(new (m_instruction_arena) ReadPointerInstruction(dest, gen_attribute_pointer(variable->attribute)));
             return dest;
         }
         case VariableAccess::INDEXED_VARIABLE:
         {
             TypeDenoter * type = variable_access_type(variable->indexed_variable->variable);
             assert(type->type == TypeDenoter::ARRAY);
-            Variant dest = next_available_register(type_denoter_to_register_type(type));
-            m_instructions.push_back(new ReadPointerInstruction(dest, gen_array_pointer(variable->indexed_variable, type->array_type)));
+            Variant pointer = gen_array_pointer(variable->indexed_variable, type->array_type);
+            TypeDenoter * element_type = get_class_type(variable);
+            // a row of a multidimensional array is just where it starts
+            if (element_type->type == TypeDenoter::ARRAY)
+                return pointer;
+            Variant dest = next_available_register(type_denoter_to_register_type(element_type));
+            m_instructions.push_back(new (m_instruction_arena) ReadPointerInstruction(dest, pointer));
             return dest;
         }
         default:
@@ -1413,7 +3237,7 @@ TypeDenoter * MethodGenerator::get_class_type(VariableAccess * variable_access)
             VariableData * variable =
                     function_symbols->variables->has_key(variable_access->identifier->text) ?
                     function_symbols->variables->get(variable_access->identifier->text) :
-                    class_symbols->variables->get(variable_access->identifier->text);
+                    get_field(m_symbol_table, m_class_name, variable_access->identifier->text);
             return variable->type;
         }
         case VariableAccess::INDEXED_VARIABLE:
@@ -1428,8 +3252,7 @@ TypeDenoter * MethodGenerator::get_class_type(VariableAccess * variable_access)
         case VariableAccess::ATTRIBUTE:
         {
             std::string owner_class_name = get_class_name(get_class_type(variable_access->attribute->owner));
-            ClassSymbolTable * class_symbols = m_symbol_table->get(owner_class_name);
-            VariableData * variable = class_symbols->variables->get(variable_access->attribute->identifier->text);
+            VariableData * variable = get_field(m_symbol_table, owner_class_name, variable_access->attribute->identifier->text);
             return variable->type;
         }
         case VariableAccess::THIS:
@@ -1447,46 +3270,35 @@ std::string MethodGenerator::get_class_name(TypeDenoter * type_denoter)
 
 int MethodGenerator::get_field_offset_in_bytes(std::string class_name, std::string field_name)
 {
-    while (true) {
-        ClassSymbolTable * class_symbols = m_symbol_table->get(class_name);
-        int sum = 0;
-        for (int i = 0; i < class_symbols->variables->count(); i++) {
-            VariableData * field = class_symbols->variables->get(i);
-            if (Utils::to_lower(field_name).compare(Utils::to_lower(field->name)) == 0) {
-                // found it
-                int parent_size = 0;
-                if (class_symbols->class_declaration->parent_identifier != NULL)
-                    parent_size = get_class_size_in_bytes(class_symbols->class_declaration->parent_identifier->text, m_symbol_table);
-                return parent_size + sum;
-            }
-            sum += 4;
-        }
-        if (class_symbols->class_declaration->parent_identifier == NULL) {
-            // couldn't find the field
-            assert(false);
-        }
-        // check the next type up
-        class_name = class_symbols->class_declaration->parent_identifier->text;
-    }
+    ClassLayout * layout = get_class_layout(m_symbol_table, class_name);
+    std::map<std::string, int>::iterator it = layout->offsets.find(Utils::to_lower(field_name));
+    // couldn't find the field
+    assert(it != layout->offsets.end());
+    return it->second;
 }
 
 void MethodGenerator::gen_assignment(VariableAccess * variable, Variant source) {
     switch (variable->type) {
         case VariableAccess::IDENTIFIER:
-            m_instructions.push_back(new CopyInstruction(m_variable_numbers.get(variable->identifier->text), source));
+            m_instructions.push_back(new (m_instruction_arena) CopyInstruction(m_variable_numbers.get(variable->identifier->text), source));
             break;
         case VariableAccess::ATTRIBUTE:
-            m_instructions.push_back(new WritePointerInstruction(gen_attribute_pointer(variable->attribute), source));
+            m_instructions.push_back(new (m_instruction_arena) WritePointerInstruction(gen_attribute_pointer(variable->attribute), source));
             break;
         case VariableAccess::INDEXED_VARIABLE:
         {
             TypeDenoter * type = variable_access_type(variable->indexed_variable->variable);
             assert(type->type == TypeDenoter::ARRAY);
-            m_instructions.push_back(new WritePointerInstruction(gen_array_pointer(variable->indexed_variable, type->array_type), source));
+            Variant pointer = gen_array_pointer(variable->indexed_variable, type->array_type);
+            TypeDenoter * element_type = get_class_type(variable);
+            if (element_type->type == TypeDenoter::ARRAY)
+                gen_copy_array(pointer, source, element_type->array_type);
+            else
+                m_instructions.push_back(new (m_instruction_arena) WritePointerInstruction(pointer, source));
             break;
         }
         case VariableAccess::THIS:
-            m_instructions.push_back(new CopyInstruction(m_variable_numbers.get("this"), source));
+            m_instructions.push_back(new (m_instruction_arena) CopyInstruction(m_variable_numbers.get("this"), source));
             break;
         default:
             assert(false);
@@ -1494,6 +3306,7 @@ void MethodGenerator::gen_assignment(VariableAccess * variable, Variant source)
 }
 
 void MethodGenerator::link_parent_and_child(int parent_index, int jump_child, int fallthrough_child) {
+    invalidate_control_flow();
     m_basic_blocks[parent_index]->jump_child = jump_child;
     m_basic_blocks[parent_index]->fallthrough_child = fallthrough_child;
 
@@ -1504,40 +3317,44 @@ void MethodGenerator::link_parent_and_child(int parent_index, int jump_child, in
 }
 
 void MethodGenerator::build_basic_blocks() {
-    // identify breaks between blocks
-    std::set<int> block_break_indexes;
-    // 0 is a break, but leave it out for easier iteration later.
-    for (unsigned int i = 0; i < m_instructions.size(); i++) {
+    // identify breaks between blocks, indexed by instruction. vectors instead of a set and a map
+    // because this happens to every method, even at -O0.
+    int instruction_count = m_instructions.size();
+    std::vector<bool> block_break(instruction_count + 1, false);
+    for (int i = 0; i < instruction_count; i++) {
         Instruction * instruction = m_instructions[i];
         switch (instruction->type) {
             case Instruction::IF:
             {
                 IfInstruction * if_instruction = (IfInstruction *) instruction;
-                block_break_indexes.insert(if_instruction->goto_index);
-                block_break_indexes.insert(i + 1);
+                block_break[if_instruction->goto_index] = true;
+                block_break[i + 1] = true;
                 break;
             }
             case Instruction::GOTO:
             {
                 GotoInstruction * goto_instruction = (GotoInstruction *) instruction;
-                block_break_indexes.insert(goto_instruction->goto_index);
-                block_break_indexes.insert(i + 1);
+                block_break[goto_instruction->goto_index] = true;
+                block_break[i + 1] = true;
                 break;
             }
             case Instruction::RETURN:
                 // throw one in at the end for easier iteration later.
-                block_break_indexes.insert(i + 1);
+                block_break[i + 1] = true;
             default:
                 break;
         }
     }
+    // a loop at the very start jumps back to 0. that's still the first block, not an empty one in front of it.
+    block_break[0] = false;
 
     // construct blocks
-    std::map<int, int> instruction_index_to_block_index;
+    std::vector<int> instruction_index_to_block_index(instruction_count + 1, -1);
     int start_index = 0; // first block starts at 0
-    for (std::set<int>::iterator iter = block_break_indexes.begin(); iter != block_break_indexes.end(); iter++) {
-        int end_index = *iter;
-        BasicBlock * block = new BasicBlock(start_index, end_index);
+    for (int end_index = 1; end_index <= instruction_count; end_index++) {
+        if (! block_break[end_index])
+            continue;
+        BasicBlock * block = new (m_block_arena) BasicBlock(start_index, end_index, m_node_arena);
         instruction_index_to_block_index[start_index] = m_basic_blocks.size();
         m_basic_blocks.push_back(block);
 
@@ -1553,8 +3370,7 @@ void MethodGenerator::build_basic_blocks() {
     // connect blocks together
     for (unsigned int i = 0; i < m_basic_blocks.size(); i++) {
         BasicBlock * block = m_basic_blocks[i];
-        int last_index = block->end- 1;
-        Instruction * instruction = m_instructions[last_index];
+        Instruction * instruction = block->instructions.back();
         switch (instruction->type) {
             case Instruction::IF:
             {
@@ -1588,296 +3404,59 @@ void MethodGenerator::build_basic_blocks() {
     }
 }
 
-void MethodGenerator::basic_block_value_numbering(BasicBlock * block) {
-    // initialize our value numbers to something that has to do with parent value numbers.
-    // for each register
-    for (int register_index = 0; register_index < m_register_count; ++register_index) {
-        // if any of our parents disagree about the value number, or if any of the parents mangle our value number,
-        // then we have to use a unique one. As long as at least one parent provides a value number, and nobody mangles it,
-        // then we can use that.
-        std::set<int>::iterator it = block->parents.begin();
-        // consult all of the parents with value numbers (normal parents).
-        // find the first parent with value numbers and start with that parent's opinion of what the value number is.
-        Variant value;
-        bool has_a_value_at_all = false;
-        for (; it != block->parents.end(); ++it) {
-            BasicBlock * parent = m_basic_blocks[*it];
-            if (parent->value_numbers.is_empty())
-                continue; // no value numbers
-            value = parent->value_numbers.get(register_index);
-            block->value_numbers.associate(register_index, value);
-            has_a_value_at_all = true;
-            it++;
-            break;
-        }
-        // then check the value with all the rest of the parents who have value numbers
-        for (; it != block->parents.end(); ++it) {
-            BasicBlock * parent = m_basic_blocks[*it];
-            if (parent->value_numbers.is_empty())
-                continue; // no value numbers
-            Variant other_value = parent->value_numbers.get(register_index);
-            if (other_value != value) {
-                // at least two parents disagree about this register. gotta say it's unique.
-                block->value_numbers.associate(register_index, next_unique_value());
-                // this register can't get any worse. move on to the next one.
-                goto continue_register_loop;
-            }
-        }
-        // finally check with any parents who want to mangle our values.
-        it = block->parents.begin();
-        for (; it != block->parents.end(); ++it) {
-            BasicBlock * parent = m_basic_blocks[*it];
-            if (parent->mangled_registers.count(register_index)) {
-                block->value_numbers.associate(register_index, next_unique_value());
-                has_a_value_at_all = true;
-                // one bit of bad news is all it takes. we have nothing left to lose.
-                goto continue_register_loop;
+void MethodGenerator::compute_addresses() {
+    int address = 0;
+    for (int i = 0; i < (int)m_basic_blocks.size(); ++i) {
+        BasicBlock * block = m_basic_blocks[i];
+        if (block->deleted)
+            continue;
+        block->start = address;
+        address += block->instructions.size();
+        block->end = address;
+    }
+    for (int i = 0; i < (int)m_basic_blocks.size(); ++i) {
+        BasicBlock * block = m_basic_blocks[i];
+        if (block->deleted)
+            continue;
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+            Instruction * instruction = *it;
+            if (instruction->type == Instruction::IF) {
+                IfInstruction * if_instruction = (IfInstruction *) instruction;
+                if_instruction->goto_index = m_basic_blocks[block->jump_child]->start;
+            } else if (instruction->type == Instruction::GOTO) {
+                GotoInstruction * goto_instruction = (GotoInstruction *) instruction;
+                goto_instruction->goto_index = m_basic_blocks[block->jump_child]->start;
             }
         }
-        // if none of our parents will help us out (like if we have no parents), then we'll assume our value is garbage.
-        if (!has_a_value_at_all)
-            block->value_numbers.associate(register_index, next_unique_value());
+    }
+}
 
-        // we wouldn't have to use goto if C++ had labeld loops like Java.
-        continue_register_loop:;
+int MethodGenerator::instruction_count() {
+    int count = 0;
+    for (int i = 0; i < (int)m_basic_blocks.size(); ++i) {
+        if (! m_basic_blocks[i]->deleted)
+            count += m_basic_blocks[i]->instructions.size();
     }
+    return count;
+}
 
-    // now do our own value numbers.
-    for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
-        Instruction * instruction = *it;
-        switch (instruction->type) {
-            case Instruction::COPY:
-            {
-                CopyInstruction * copy_instruction = (CopyInstruction *) instruction;
-                copy_instruction->source = inline_value(block, copy_instruction->source);
-                block->value_numbers.associate(copy_instruction->dest._int, get_value_number(block, copy_instruction->source));
-                break;
-            }
-            case Instruction::OPERATOR:
-            {
-                OperatorInstruction * operator_instruction = (OperatorInstruction *) instruction;
-                operator_instruction->left = inline_value(block, operator_instruction->left);
-                operator_instruction->right = inline_value(block, operator_instruction->right);
-
-                CopyInstruction * copy_instruction = constant_expression_evaluated(block, operator_instruction);
-                if (copy_instruction != NULL) {
-                    *it = copy_instruction;
-                    break;
-                }
-
-                // normalize parameter order
-                // constant on the right and lower register first
-                bool swap = false;
-                if (operator_instruction->left.type != Variant::REGISTER) {
-                    // left is constant, swap
-                    swap = true;
-                } else if (operator_instruction->right.type == Variant::REGISTER) {
-                    // right is not constant. order by lower register first
-                    swap = operator_instruction->left._int > operator_instruction->right._int;
-                }
-                switch (operator_instruction->_operator) {
-                    case OperatorInstruction::MINUS:
-                    case OperatorInstruction::DIVIDE:
-                    case OperatorInstruction::MOD:
-                        swap = false;
-                    default:
-                        break;
-                }
-                if (swap) {
-                    Variant tmp = operator_instruction->left;
-                    operator_instruction->left = operator_instruction->right;
-                    operator_instruction->right = tmp;
-                }
-
-                instruction = constant_folded(block, operator_instruction);
-                *it = instruction;
-
-                if (instruction->type != Instruction::OPERATOR)
-                    break;
-
-                operator_instruction = (OperatorInstruction *) instruction;
-
-                // replace operator instruction with a copy instruction if we can
-                std::string hash = hash_operator_instruction(block, operator_instruction);
-                std::list<int> * registers = block->value_numbers.keys(hash);
-                if (registers != NULL && registers->size() > 0) {
-                    int lowest = *(registers->begin());
-                    CopyInstruction * copy_instruction = new CopyInstruction(operator_instruction->dest, Variant(lowest, Variant::REGISTER));
-                    instruction = copy_instruction;
-                    *it = copy_instruction;
-                    delete operator_instruction;
-                    block->value_numbers.associate(copy_instruction->dest._int, get_value_number(block, copy_instruction->source));
-                } else {
-                    block->value_numbers.associate(operator_instruction->dest._int, Variant(hash));
-                }
-                break;
-            }
-            case Instruction::UNARY:
-            {
-                UnaryInstruction * unary_instruction = (UnaryInstruction *) instruction;
-                unary_instruction->source = inline_value(block, unary_instruction->source);
-
-                CopyInstruction * copy_instruction = constant_expression_evaluated(block, unary_instruction);
-                if (copy_instruction != NULL) {
-                    *it = copy_instruction;
-                    break;
-                }
-
-                break;
-            }
-            case Instruction::IF:
-            {
-                IfInstruction * if_instruction = (IfInstruction *) instruction;
-                if_instruction->condition = inline_value(block, if_instruction->condition);
-                break;
-            }
-            case Instruction::GOTO:
-                break;
-            case Instruction::RETURN:
-                break;
-            case Instruction::PRINT:
-            {
-                PrintInstruction * print_instruction = (PrintInstruction *) instruction;
-                print_instruction->value = inline_value(block, print_instruction->value);
-                break;
-            }
-            case Instruction::NON_VOID_METHOD_CALL:
-            case Instruction::METHOD_CALL:
-            {
-                MethodCallInstruction * method_call_instruction = (MethodCallInstruction *) instruction;
-                for (int i = 0; i < (int)method_call_instruction->parameters.size(); i++)
-                    method_call_instruction->parameters[i] = inline_value(block, method_call_instruction->parameters[i]);
-                // leave result value as unknonw
-                break;
-            }
-            case Instruction::ALLOCATE_OBJECT:
-                break;
-            case Instruction::ALLOCATE_ARRAY:
-                break;
-            case Instruction::WRITE_POINTER:
-            {
-                WritePointerInstruction * write_pointer_instruction = (WritePointerInstruction *) instruction;
-                write_pointer_instruction->source = inline_value(block, write_pointer_instruction->source);
-                write_pointer_instruction->pointer = inline_value(block, write_pointer_instruction->pointer);
-                break;
-            }
-            case Instruction::READ_POINTER:
-            {
-                ReadPointerInstruction * read_pointer_instruction = (ReadPointerInstruction *) instruction;
-                read_pointer_instruction->source_pointer = inline_value(block, read_pointer_instruction->source_pointer);
-                break;
-            }
-        }
-    }
-}
-
-void MethodGenerator::value_numbering() {
-
-    for (int i = 0; i < (int)m_basic_blocks.size(); i++) {
-        BasicBlock * block = m_basic_blocks[i];
-        basic_block_value_numbering(block);
-    }
-}
-
-void MethodGenerator::calculate_mangle_sets() {
-    for (int i = 0; i < (int)m_basic_blocks.size(); i++)
-        calculate_mangle_set(i);
-}
-
-void MethodGenerator::calculate_mangle_set(int block_index) {
-    BasicBlock * node = m_basic_blocks[block_index];
-    for (std::set<int>::iterator it = node->parents.begin(); it != node->parents.end(); it++) {
-        int parent_index = *it;
-        // only consider blocks that have parents later in the program.
-        // these blocks are usually the beginings of loops
-        if (parent_index > block_index) {
-            // search for every path from this block to the later parent (which is the entire
-            // scope of the loop) and record which registers are mangled along the way.
-            calculate_downward_mangle_set(block_index);
-            calculate_upward_mangle_set(parent_index);
-            BasicBlock * end_node = m_basic_blocks[parent_index];
-            // now add in all the mangles from the between nodes.
-            for (int i = 0; i < (int)m_basic_blocks.size(); i++) {
-                BasicBlock * node = m_basic_blocks[i];
-                if (node->is_destination && node->is_source) {
-                    // this block is on the path to victory.
-                    // record the mangled registers and store them in the later parent.
-                    for (InstructionList::iterator it = node->instructions.begin(); it != node->instructions.end(); ++it) {
-                        Instruction * instruction = *it;
-                        instruction->insertMangledRegisters(end_node->mangled_registers);
-                    }
-                }
-                // reset state for next go around.
-                node->is_destination = false;
-                node->is_source = false;
-            }
-        }
-    }
-}
-
-void MethodGenerator::calculate_downward_mangle_set(int block_index) {
-    BasicBlock * block = m_basic_blocks[block_index];
-    // prevent infinite recursion
-    if (block->is_destination)
-        return;
-    block->is_destination = true;
-
-    if (block->jump_child != -1)
-        calculate_downward_mangle_set(block->jump_child);
-    if (block->fallthrough_child != -1)
-        calculate_downward_mangle_set(block->fallthrough_child);
-}
-
-void MethodGenerator::calculate_upward_mangle_set(int block_index) {
-    BasicBlock * block = m_basic_blocks[block_index];
-    // prevent infinite recursion
-    if (block->is_source)
-        return;
-    block->is_source = true;
-
-    for (std::set<int>::iterator it = block->parents.begin(); it != block->parents.end(); ++it) {
-        int parent_index = *it;
-        calculate_upward_mangle_set(parent_index);
-    }
-}
-
-void MethodGenerator::compute_addresses() {
-    int address = 0;
-    for (int i = 0; i < (int)m_basic_blocks.size(); ++i) {
-        BasicBlock * block = m_basic_blocks[i];
-        if (block->deleted)
-            continue;
-        block->start = address;
-        address += block->instructions.size();
-        block->end = address;
-    }
+int MethodGenerator::block_count() {
+    int count = 0;
     for (int i = 0; i < (int)m_basic_blocks.size(); ++i) {
-        BasicBlock * block = m_basic_blocks[i];
-        if (block->deleted)
-            continue;
-        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
-            Instruction * instruction = *it;
-            if (instruction->type == Instruction::IF) {
-                IfInstruction * if_instruction = (IfInstruction *) instruction;
-                if_instruction->goto_index = m_basic_blocks[block->jump_child]->start;
-            } else if (instruction->type == Instruction::GOTO) {
-                GotoInstruction * goto_instruction = (GotoInstruction *) instruction;
-                goto_instruction->goto_index = m_basic_blocks[block->jump_child]->start;
-            }
-        }
+        if (! m_basic_blocks[i]->deleted)
+            count++;
     }
+    return count;
 }
 
 void MethodGenerator::compress_registers()
 {
     // start out, assume not using any
-    std::set<int> used_registers;
+    BitVector used_registers(m_register_count);
 
-    // be sure not to compress parameters
-    used_registers.insert(0);
-    for (VariableDeclarationList * variable_list = m_function_declaration->parameter_list; variable_list != NULL; variable_list = variable_list->next) {
-        used_registers.insert((int)used_registers.size());
-    }
+    // be sure not to compress this and the parameters. the caller puts them there.
+    for (int i = 0; i < parameter_register_count(); i++)
+        used_registers.set(i);
 
     // go through program and mark the ones we do use
     for (int b = 0; b < (int)m_basic_blocks.size(); ++b) {
@@ -1885,9 +3464,10 @@ void MethodGenerator::compress_registers()
         if (block->deleted)
             continue;
         for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
-            Instruction * instruction = *it;
-            instruction->insertReadRegisters(used_registers);
-            instruction->insertMangledRegisters(used_registers);
+            int mangled = (*it)->mangledRegister();
+            if (mangled != -1)
+                used_registers.set(mangled);
+            (*it)->setReadRegisters(used_registers);
         }
     }
 
@@ -1899,8 +3479,7 @@ void MethodGenerator::compress_registers()
 
 
     int new_register_count = 0;
-    for (std::set<int>::iterator it = used_registers.begin(); it != used_registers.end(); ++it) {
-        int used_register_number = *it;
+    for (int used_register_number = used_registers.next(0); used_register_number != -1; used_register_number = used_registers.next(used_register_number + 1)) {
         new_number[used_register_number] = new_register_count;
         new_type[new_register_count] = m_register_type[used_register_number];
         ++new_register_count;
@@ -1928,6 +3507,7 @@ void MethodGenerator::compress_registers()
 }
 
 void MethodGenerator::delete_block(int index) {
+    invalidate_control_flow();
     BasicBlock * block = m_basic_blocks[index];
 
     assert((block->jump_child == -1) != (block->fallthrough_child == -1));
@@ -1944,9 +3524,160 @@ void MethodGenerator::delete_block(int index) {
     block->deleted = true;
 }
 
+// anything bigger stays on the heap, so frames don't get too big for the stack
+const int max_stack_allocation_size = 1024;
+const int max_stack_allocation_total = 4096;
+
+void MethodGenerator::stack_allocation() {
+    // which allocations each register could be pointing into
+    std::vector<std::set<Instruction *> > points_to(m_register_count);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+            BasicBlock * block = m_basic_blocks[b];
+            if (block->deleted)
+                continue;
+            for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+                Instruction * instruction = *it;
+                int dest = -1;
+                std::vector<Variant> sources;
+                switch (instruction->type) {
+                    case Instruction::ALLOCATE_OBJECT:
+                        dest = ((AllocateObjectInstruction *) instruction)->dest._int;
+                        if (points_to[dest].insert(instruction).second)
+                            changed = true;
+                        break;
+                    case Instruction::ALLOCATE_ARRAY:
+                        dest = ((AllocateArrayInstruction *) instruction)->dest._int;
+                        if (points_to[dest].insert(instruction).second)
+                            changed = true;
+                        break;
+                    case Instruction::COPY:
+                        dest = ((CopyInstruction *) instruction)->dest._int;
+                        sources.push_back(((CopyInstruction *) instruction)->source);
+                        break;
+                    case Instruction::OPERATOR:
+                    {
+                        // field and element addresses point into the same allocation
+                        OperatorInstruction * operator_instruction = (OperatorInstruction *) instruction;
+                        if (operator_instruction->_operator == OperatorInstruction::PLUS || operator_instruction->_operator == OperatorInstruction::MINUS) {
+                            dest = operator_instruction->dest._int;
+                            sources.push_back(operator_instruction->left);
+                            sources.push_back(operator_instruction->right);
+                        }
+                        break;
+                    }
+                    default:
+                        break;
+                }
+                for (int i = 0; i < (int)sources.size(); i++) {
+                    if (sources[i].type != Variant::REGISTER)
+                        continue;
+                    std::set<Instruction *> & source_points_to = points_to[sources[i]._int];
+                    for (std::set<Instruction *>::iterator source_it = source_points_to.begin(); source_it != source_points_to.end(); ++source_it) {
+                        if (points_to[dest].insert(*source_it).second)
+                            changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // anything stored in memory, passed to a method or returned could outlive the frame
+    std::set<Instruction *> escaped;
+    for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+        BasicBlock * block = m_basic_blocks[b];
+        if (block->deleted)
+            continue;
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+            std::vector<Variant> escaping;
+            switch ((*it)->type) {
+                case Instruction::WRITE_POINTER:
+                    escaping.push_back(((WritePointerInstruction *) *it)->source);
+                    break;
+                case Instruction::METHOD_CALL:
+                case Instruction::NON_VOID_METHOD_CALL:
+                    escaping = ((MethodCallInstruction *) *it)->parameters;
+                    break;
+                case Instruction::RETURN:
+                    if (((ReturnInstruction *) *it)->has_value)
+                        escaping.push_back(((ReturnInstruction *) *it)->value);
+                    break;
+                default:
+                    break;
+            }
+            for (int i = 0; i < (int)escaping.size(); i++) {
+                if (escaping[i].type == Variant::REGISTER)
+                    escaped.insert(points_to[escaping[i]._int].begin(), points_to[escaping[i]._int].end());
+            }
+        }
+    }
+
+    // the same space gets used every time the allocation happens, so nothing can still
+    // be pointing at the last one when it does
+    Liveness liveness;
+    calculate_live_registers(liveness);
+    BitVector live(m_register_count);
+    for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+        BasicBlock * block = m_basic_blocks[b];
+        if (block->deleted)
+            continue;
+        liveness.get_live_out(b, live);
+        for (InstructionList::reverse_iterator it = block->instructions.rbegin(); it != block->instructions.rend(); ++it) {
+            Instruction * instruction = *it;
+            step_live_registers(instruction, live);
+            if (instruction->type == Instruction::ALLOCATE_OBJECT || instruction->type == Instruction::ALLOCATE_ARRAY) {
+                for (int live_register = live.next(0); live_register != -1; live_register = live.next(live_register + 1)) {
+                    if (points_to[live_register].count(instruction))
+                        escaped.insert(instruction);
+                }
+            }
+        }
+    }
+
+    for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+        BasicBlock * block = m_basic_blocks[b];
+        if (block->deleted)
+            continue;
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+            Instruction * instruction = *it;
+            if (escaped.count(instruction))
+                continue;
+            // objects and arrays start just after the return address
+            int stack_offset = 4 + m_stack_allocation_size;
+            if (instruction->type == Instruction::ALLOCATE_OBJECT) {
+                AllocateObjectInstruction * allocate_instruction = (AllocateObjectInstruction *) instruction;
+                int size = get_class_size_in_bytes(allocate_instruction->class_name, m_symbol_table);
+                if (size > max_stack_allocation_size || m_stack_allocation_size + size > max_stack_allocation_total)
+                    continue;
+                allocate_instruction->stack_offset = stack_offset;
+                m_stack_allocation_size += size;
+                std::vector<int> pointer_offsets;
+                insert_class_pointer_offsets(allocate_instruction->class_name, m_symbol_table, pointer_offsets);
+                for (int i = 0; i < (int)pointer_offsets.size(); i++) {
+                    if (pointer_offsets[i] < size)
+                        m_stack_pointer_offsets.push_back(stack_offset + pointer_offsets[i]);
+                }
+            } else if (instruction->type == Instruction::ALLOCATE_ARRAY) {
+                AllocateArrayInstruction * allocate_instruction = (AllocateArrayInstruction *) instruction;
+                if (allocate_instruction->size > max_stack_allocation_size || m_stack_allocation_size + allocate_instruction->size > max_stack_allocation_total)
+                    continue;
+                allocate_instruction->stack_offset = stack_offset;
+                m_stack_allocation_size += allocate_instruction->size;
+                for (int i = 0; i < allocate_instruction->size && allocate_instruction->references; i += 4)
+                    m_stack_pointer_offsets.push_back(stack_offset + i);
+            }
+        }
+    }
+}
+
 void MethodGenerator::block_deletion() {
+    invalidate_control_flow();
     for (int i = m_basic_blocks.size() - 1; i >= 0; --i) {
         BasicBlock * block = m_basic_blocks[i];
+        if (block->deleted)
+            continue;
 
         if (block->instructions.size() != 0) {
             // if last instruction is if statement
@@ -1981,202 +3712,2309 @@ void MethodGenerator::block_deletion() {
 }
 
 void MethodGenerator::dependency_management() {
-    for (int block_index = 0; block_index < (int)m_basic_blocks.size(); ++block_index) {
-        BasicBlock * block = m_basic_blocks[block_index];
-        for (std::set<int>::iterator it = block->parents.begin(); it != block->parents.end(); it++) {
-            int parent_index = *it;
-            // only consider blocks that have parents later in the program.
-            // these blocks are usually the beginings of loops
-            if (parent_index > block_index) {
-                // search for every path from this block to the later parent (which is the entire
-                // scope of the loop) and record which registers are mangled along the way.
-                calculate_downward_mangle_set(block_index);
-                calculate_upward_mangle_set(parent_index);
-                BasicBlock * end_node = m_basic_blocks[parent_index];
-                // now add in all the mangles from the between nodes.
-                for (int i = 0; i < (int)m_basic_blocks.size(); i++) {
-                    BasicBlock * node = m_basic_blocks[i];
-                    if (node->is_destination && node->is_source) {
-                        // this block is on the path to victory.
-                        // record the mangled registers and store them in the later parent.
-                        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
-                            Instruction * instruction = *it;
-                            instruction->insertReadRegisters(end_node->used_registers);
-                        }
+    Liveness liveness;
+    calculate_live_registers(liveness);
+    BitVector used_registers(m_register_count);
+
+    for (int i = m_basic_blocks.size() - 1; i >= 0; --i) {
+        BasicBlock * block = m_basic_blocks[i];
+        if (block->deleted)
+            continue;
+
+        // start with everything the children need
+        liveness.get_live_out(i, used_registers);
+
+        InstructionList::iterator it = block->instructions.end();
+        while (it != block->instructions.begin()) {
+            --it;
+            Instruction * instruction = *it;
+            switch (instruction->type) {
+                case Instruction::COPY:
+                {
+                    CopyInstruction * copy_instruction = (CopyInstruction *) instruction;
+
+                    int dest_register = copy_instruction->dest._int;
+
+                    // see if instruction is unecessary
+                    if (copy_instruction->source.type == Variant::REGISTER && copy_instruction->source._int == dest_register) {
+                        it = block->instructions.erase(it);
+
+                        delete instruction;
+                        instruction = NULL;
+                        break;
+                    } else if (! used_registers.test(dest_register)) {
+                        // delete because nothing depends on it
+                        it = block->instructions.erase(it);
+
+                        delete instruction;
+                        instruction = NULL;
+                    } else {
+                        // add the source to used set
+                        copy_instruction->setReadRegisters(used_registers);
                     }
-                    // reset state for next go around.
-                    node->is_destination = false;
-                    node->is_source = false;
+
+                    // delete dest from used set
+                    used_registers.reset(dest_register);
+
+                    break;
                 }
+                case Instruction::OPERATOR:
+                {
+                    OperatorInstruction * operator_instruction = (OperatorInstruction *) instruction;
+
+                    int dest_register = operator_instruction->dest._int;
+
+                    // see if this is unecessary
+                    if (! used_registers.test(dest_register)) {
+                        it = block->instructions.erase(it);
+
+                        delete instruction;
+                        instruction = NULL;
+                    } else {
+                        // add the operands to used set
+                        operator_instruction->setReadRegisters(used_registers);
+                    }
+
+                    // delete dest from used set
+                    used_registers.reset(dest_register);
+
+
+                    break;
+                }
+                case Instruction::UNARY:
+                {
+                    UnaryInstruction * unary_instruction = (UnaryInstruction *) instruction;
+
+
+                    int dest_register = unary_instruction->dest._int;
+
+                    // see if this is unecessary
+                    if (! used_registers.test(dest_register)) {
+                        it = block->instructions.erase(it);
+
+                        delete instruction;
+                        instruction = NULL;
+                    } else {
+                        // add the source to used set
+                        unary_instruction->setReadRegisters(used_registers);
+                    }
+
+                    // delete dest from used set
+                    used_registers.reset(dest_register);
+
+
+                    break;
+                }
+                case Instruction::PRINT:
+                {
+                    PrintInstruction * print_instruction = (PrintInstruction *) instruction;
+                    print_instruction->setReadRegisters(used_registers);
+                    break;
+                }
+                case Instruction::IF:
+                {
+                    IfInstruction * if_instruction = (IfInstruction *) instruction;
+                    if_instruction->setReadRegisters(used_registers);
+                    break;
+                }
+                case Instruction::GOTO:
+                    break;
+                case Instruction::RETURN:
+                {
+                    ReturnInstruction * return_instruction = (ReturnInstruction *) instruction;
+                    return_instruction->setReadRegisters(used_registers);
+                    break;
+                }
+                case Instruction::NON_VOID_METHOD_CALL:
+                case Instruction::METHOD_CALL:
+                {
+                    MethodCallInstruction * method_call_instruction = (MethodCallInstruction *) instruction;
+                    method_call_instruction->setReadRegisters(used_registers);
+                    break;
+                }
+                case Instruction::ALLOCATE_OBJECT:
+                    break;
+                case Instruction::ALLOCATE_ARRAY:
+                    break;
+                case Instruction::WRITE_POINTER:
+                {
+                    WritePointerInstruction * write_pointer_instruction = (WritePointerInstruction *) instruction;
+                    write_pointer_instruction->setReadRegisters(used_registers);
+                    break;
+                }
+                case Instruction::READ_POINTER:
+                {
+                    ReadPointerInstruction * read_pointer_instruction = (ReadPointerInstruction *) instruction;
+                    read_pointer_instruction->setReadRegisters(used_registers);
+                    break;
+                }
+                case Instruction::BOUNDS_CHECK:
+                {
+                    BoundsCheckInstruction * bounds_check_instruction = (BoundsCheckInstruction *) instruction;
+                    bounds_check_instruction->setReadRegisters(used_registers);
+                    break;
+                }
+                case Instruction::PHI:
+                    // dependency management runs before ssa form
+                    assert(false);
+                    break;
+            }
+        }
+    }
+
+}
+
+void MethodGenerator::calculate_live_registers(Liveness & liveness) {
+    liveness.registers.clear();
+    liveness.bits.assign(m_register_count, -1);
+
+    // read before anything in the block assigns them. anything that isn't is never
+    // live across a block boundary, so it doesn't get a bit.
+    std::vector<std::vector<int> > exposed(m_basic_blocks.size());
+    // what the phis want from each parent
+    std::vector<std::vector<int> > phi_sources(m_basic_blocks.size());
+    BitVector live(m_register_count);
+    for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+        BasicBlock * block = m_basic_blocks[b];
+        if (block->deleted)
+            continue;
+        live.clear();
+        for (InstructionList::reverse_iterator it = block->instructions.rbegin(); it != block->instructions.rend(); ++it)
+            step_live_registers(*it, live);
+        for (int r = live.next(0); r != -1; r = live.next(r + 1))
+            exposed[b].push_back(r);
+
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end() && (*it)->type == Instruction::PHI; ++it) {
+            PhiInstruction * phi_instruction = (PhiInstruction *) *it;
+            for (int i = 0; i < (int)phi_instruction->parents.size(); i++) {
+                if (phi_instruction->sources[i].type == Variant::REGISTER)
+                    phi_sources[phi_instruction->parents[i]].push_back(phi_instruction->sources[i]._int);
+            }
+        }
+    }
+    for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+        for (int pass = 0; pass < 2; pass++) {
+            std::vector<int> & registers = pass == 0 ? exposed[b] : phi_sources[b];
+            for (int i = 0; i < (int)registers.size(); i++) {
+                if (liveness.bits[registers[i]] == -1) {
+                    liveness.bits[registers[i]] = liveness.registers.size();
+                    liveness.registers.push_back(registers[i]);
+                }
+            }
+        }
+    }
+
+    DataflowProblem problem(DataflowProblem::BACKWARD, m_basic_blocks.size(), liveness.registers.size());
+    for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+        BasicBlock * block = m_basic_blocks[b];
+        if (block->deleted)
+            continue;
+        if (block->jump_child != -1)
+            problem.add_edge(b, block->jump_child);
+        if (block->fallthrough_child != -1)
+            problem.add_edge(b, block->fallthrough_child);
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+            int mangled = (*it)->mangledRegister();
+            if (mangled != -1 && liveness.bits[mangled] != -1)
+                problem.kill[b].set(liveness.bits[mangled]);
+        }
+        for (int i = 0; i < (int)exposed[b].size(); i++)
+            problem.gen[b].set(liveness.bits[exposed[b][i]]);
+        for (int i = 0; i < (int)phi_sources[b].size(); i++)
+            problem.boundary[b].set(liveness.bits[phi_sources[b][i]]);
+    }
+    problem.solve();
+    liveness.in.swap(problem.in);
+    liveness.out.swap(problem.out);
+}
+
+// only the assignments in the given blocks are tracked, but assignments anywhere can kill them
+void MethodGenerator::calculate_reaching_definitions(std::set<int> & blocks, std::vector<Definition> & definitions, std::vector<BitVector> & reaching_in) {
+    definitions.clear();
+    // index in register_definition_bits of every register with a tracked assignment, or -1
+    std::vector<int> tracked_registers(m_register_count, -1);
+    std::vector<std::vector<int> > register_definitions;
+    for (std::set<int>::iterator block_it = blocks.begin(); block_it != blocks.end(); ++block_it) {
+        BasicBlock * block = m_basic_blocks[*block_it];
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+            int mangled = (*it)->mangledRegister();
+            if (mangled == -1)
+                continue;
+            if (tracked_registers[mangled] == -1) {
+                tracked_registers[mangled] = register_definitions.size();
+                register_definitions.push_back(std::vector<int>());
+            }
+            register_definitions[tracked_registers[mangled]].push_back(definitions.size());
+            definitions.push_back(Definition(*it, mangled, *block_it));
+        }
+    }
+    std::vector<BitVector> register_definition_bits(register_definitions.size(), BitVector(definitions.size()));
+    for (int r = 0; r < (int)register_definitions.size(); r++) {
+        for (int i = 0; i < (int)register_definitions[r].size(); i++)
+            register_definition_bits[r].set(register_definitions[r][i]);
+    }
+
+    // an assignment kills every other assignment to the same register
+    DataflowProblem problem(DataflowProblem::FORWARD, m_basic_blocks.size(), definitions.size());
+    int d = 0;
+    for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+        BasicBlock * block = m_basic_blocks[b];
+        if (block->deleted)
+            continue;
+        if (block->jump_child != -1)
+            problem.add_edge(b, block->jump_child);
+        if (block->fallthrough_child != -1)
+            problem.add_edge(b, block->fallthrough_child);
+        bool tracked = blocks.count(b) > 0;
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+            int mangled = (*it)->mangledRegister();
+            if (mangled == -1 || tracked_registers[mangled] == -1)
+                continue;
+            problem.kill[b].union_with(register_definition_bits[tracked_registers[mangled]]);
+            problem.gen[b].subtract(register_definition_bits[tracked_registers[mangled]]);
+            if (tracked)
+                problem.gen[b].set(d++);
+        }
+    }
+    problem.solve();
+    reaching_in.swap(problem.in);
+}
+
+// turn the registers live just after the instruction into the ones live just before it
+void MethodGenerator::step_live_registers(Instruction * instruction, BitVector & live) {
+    int mangled = instruction->mangledRegister();
+    if (mangled != -1)
+        live.reset(mangled);
+    // a phi reads its sources at the end of the parents, not here
+    if (instruction->type != Instruction::PHI)
+        instruction->setReadRegisters(live);
+}
+
+MethodGenerator::ControlFlow & MethodGenerator::control_flow() {
+    if (m_control_flow.valid)
+        return m_control_flow;
+    calculate_dominators(m_control_flow.immediate_dominator, m_control_flow.reverse_postorder);
+    std::vector<int> & reverse_postorder = m_control_flow.reverse_postorder;
+    m_control_flow.dominator_children.assign(m_basic_blocks.size(), std::vector<int>());
+    for (int i = 1; i < (int)reverse_postorder.size(); i++)
+        m_control_flow.dominator_children[m_control_flow.immediate_dominator[reverse_postorder[i]]].push_back(reverse_postorder[i]);
+    find_natural_loops(m_control_flow);
+    m_control_flow.valid = true;
+    return m_control_flow;
+}
+
+// anything that adds, deletes or moves an edge has to call this
+void MethodGenerator::invalidate_control_flow() {
+    m_control_flow.valid = false;
+}
+
+void MethodGenerator::find_natural_loops(ControlFlow & control_flow) {
+    std::vector<Loop> & loops = control_flow.loops;
+    std::vector<int> & immediate_dominator = control_flow.immediate_dominator;
+    std::vector<int> & reverse_postorder = control_flow.reverse_postorder;
+    loops.clear();
+    for (int i = 0; i < (int)reverse_postorder.size(); i++) {
+        int header = reverse_postorder[i];
+        BasicBlock * header_block = m_basic_blocks[header];
+        Loop loop;
+        loop.header = header;
+        loop.blocks.insert(header);
+        // a parent that the header dominates is a back edge. everything that can reach
+        // the back edge without going through the header is in the loop.
+        std::vector<int> stack;
+        for (std::set<int>::iterator it = header_block->parents.begin(); it != header_block->parents.end(); ++it) {
+            int runner = *it;
+            if (runner != reverse_postorder[0] && immediate_dominator[runner] == -1)
+                continue; // parent can't be reached
+            while (runner != -1 && runner != header)
+                runner = immediate_dominator[runner];
+            if (runner == header)
+                stack.push_back(*it);
+        }
+        if (stack.empty())
+            continue;
+        while (! stack.empty()) {
+            int index = stack.back();
+            stack.pop_back();
+            if (loop.blocks.count(index))
+                continue;
+            loop.blocks.insert(index);
+            BasicBlock * block = m_basic_blocks[index];
+            stack.insert(stack.end(), block->parents.begin(), block->parents.end());
+        }
+        // only the header may be entered from outside the loop.
+        // anything else is a goto-shaped mess that we leave alone.
+        bool natural = true;
+        for (std::set<int>::iterator it = loop.blocks.begin(); it != loop.blocks.end() && natural; ++it) {
+            if (*it == header)
+                continue;
+            BasicBlock * block = m_basic_blocks[*it];
+            for (std::set<int>::iterator parent_it = block->parents.begin(); parent_it != block->parents.end(); ++parent_it) {
+                if (! loop.blocks.count(*parent_it))
+                    natural = false;
+            }
+        }
+        if (natural)
+            loops.push_back(loop);
+    }
+
+    // two loops are either disjoint or one is inside the other. going from the biggest
+    // to the smallest, the last loop to claim a header before its own loop does is the
+    // next one out.
+    std::vector<std::pair<int, int> > order;
+    for (int i = 0; i < (int)loops.size(); i++)
+        order.push_back(std::pair<int, int>(-(int)loops[i].blocks.size(), i));
+    std::sort(order.begin(), order.end());
+    std::vector<int> innermost_loop(m_basic_blocks.size(), -1);
+    control_flow.loop_parent.assign(loops.size(), -1);
+    for (int i = 0; i < (int)order.size(); i++) {
+        int index = order[i].second;
+        control_flow.loop_parent[index] = innermost_loop[loops[index].header];
+        for (std::set<int>::iterator it = loops[index].blocks.begin(); it != loops[index].blocks.end(); ++it)
+            innermost_loop[*it] = index;
+    }
+}
+
+int MethodGenerator::insert_block(int index) {
+    invalidate_control_flow();
+    // make room by renumbering every reference to a block at or after index
+    for (int i = 0; i < (int)m_basic_blocks.size(); i++) {
+        BasicBlock * block = m_basic_blocks[i];
+        if (block->jump_child >= index)
+            block->jump_child++;
+        if (block->fallthrough_child >= index)
+            block->fallthrough_child++;
+        std::set<int> parents;
+        for (std::set<int>::iterator it = block->parents.begin(); it != block->parents.end(); ++it)
+            parents.insert(*it >= index ? *it + 1 : *it);
+        block->parents = parents;
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end() && (*it)->type == Instruction::PHI; ++it) {
+            PhiInstruction * phi_instruction = (PhiInstruction *) *it;
+            for (int j = 0; j < (int)phi_instruction->parents.size(); j++) {
+                if (phi_instruction->parents[j] >= index)
+                    phi_instruction->parents[j]++;
+            }
+        }
+    }
+    BasicBlock * block = new (m_block_arena) BasicBlock(0, 0, m_node_arena);
+    block->jump_child = -1;
+    block->fallthrough_child = index + 1;
+    m_basic_blocks.insert(m_basic_blocks.begin() + index, block);
+    m_basic_blocks[index + 1]->parents.insert(index);
+    return index;
+}
+
+int MethodGenerator::insert_preheader(Loop & loop) {
+    bool control_flow_valid = m_control_flow.valid;
+    int preheader = insert_block(loop.header);
+    std::set<int> blocks;
+    for (std::set<int>::iterator it = loop.blocks.begin(); it != loop.blocks.end(); ++it)
+        blocks.insert(*it >= preheader ? *it + 1 : *it);
+    loop.blocks = blocks;
+    loop.header++;
+
+    // send everyone from outside the loop through the preheader
+    BasicBlock * header_block = m_basic_blocks[loop.header];
+    BasicBlock * preheader_block = m_basic_blocks[preheader];
+    std::set<int> parents = header_block->parents;
+    for (std::set<int>::iterator it = parents.begin(); it != parents.end(); ++it) {
+        int parent_index = *it;
+        if (parent_index == preheader || loop.blocks.count(parent_index))
+            continue;
+        BasicBlock * parent = m_basic_blocks[parent_index];
+        if (parent->jump_child == loop.header)
+            parent->jump_child = preheader;
+        if (parent->fallthrough_child == loop.header)
+            parent->fallthrough_child = preheader;
+        header_block->parents.erase(parent_index);
+        preheader_block->parents.insert(parent_index);
+    }
+
+    if (control_flow_valid) {
+        update_control_flow_for_preheader(preheader);
+        m_control_flow.valid = true;
+    }
+    return preheader;
+}
+
+// the preheader was put in right in front of the header, and took over the edges from outside the loop
+void MethodGenerator::update_control_flow_for_preheader(int preheader) {
+    int header = preheader + 1;
+    ControlFlow & control_flow = m_control_flow;
+
+    // everything at or after the preheader moved up one
+    std::vector<int> shifted(m_basic_blocks.size() - 1);
+    for (int i = 0; i < (int)shifted.size(); i++)
+        shifted[i] = i >= preheader ? i + 1 : i;
+
+    std::vector<int> immediate_dominator(m_basic_blocks.size(), -1);
+    std::vector<std::vector<int> > dominator_children(m_basic_blocks.size());
+    for (int i = 0; i < (int)shifted.size(); i++) {
+        int dominator = control_flow.immediate_dominator[i];
+        immediate_dominator[shifted[i]] = dominator == -1 ? -1 : shifted[dominator];
+        for (int j = 0; j < (int)control_flow.dominator_children[i].size(); j++)
+            dominator_children[shifted[i]].push_back(shifted[control_flow.dominator_children[i][j]]);
+    }
+    // the preheader takes the header's place in the dominator tree
+    std::vector<int> & siblings = dominator_children[immediate_dominator[header]];
+    std::replace(siblings.begin(), siblings.end(), header, preheader);
+    immediate_dominator[preheader] = immediate_dominator[header];
+    immediate_dominator[header] = preheader;
+    dominator_children[preheader].push_back(header);
+    control_flow.immediate_dominator.swap(immediate_dominator);
+    control_flow.dominator_children.swap(dominator_children);
+
+    std::vector<int> reverse_postorder;
+    for (int i = 0; i < (int)control_flow.reverse_postorder.size(); i++) {
+        int index = shifted[control_flow.reverse_postorder[i]];
+        if (index == header)
+            reverse_postorder.push_back(preheader);
+        reverse_postorder.push_back(index);
+    }
+    control_flow.reverse_postorder.swap(reverse_postorder);
+
+    // and joins every loop around the header's loop
+    int header_loop = -1;
+    for (int i = 0; i < (int)control_flow.loops.size(); i++) {
+        Loop & loop = control_flow.loops[i];
+        std::set<int> blocks;
+        for (std::set<int>::iterator it = loop.blocks.begin(); it != loop.blocks.end(); ++it)
+            blocks.insert(shifted[*it]);
+        loop.blocks.swap(blocks);
+        loop.header = shifted[loop.header];
+        if (loop.header == header)
+            header_loop = i;
+    }
+    assert(header_loop != -1);
+    for (int i = control_flow.loop_parent[header_loop]; i != -1; i = control_flow.loop_parent[i])
+        control_flow.loops[i].blocks.insert(preheader);
+}
+
+void MethodGenerator::calculate_this_field_pointers(std::set<int> & field_pointers) {
+    // registers assigned exactly once, to this + constant, where "this" is never reassigned
+    std::map<int, Instruction *> definitions;
+    std::set<int> reassigned;
+    for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+        BasicBlock * block = m_basic_blocks[b];
+        if (block->deleted)
+            continue;
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+            int mangled = (*it)->mangledRegister();
+            if (mangled == -1)
+                continue;
+            if (definitions.count(mangled))
+                reassigned.insert(mangled);
+            definitions[mangled] = *it;
+        }
+    }
+    if (definitions.count(0))
+        return;
+    for (std::map<int, Instruction *>::iterator it = definitions.begin(); it != definitions.end(); ++it) {
+        if (reassigned.count(it->first) || it->second->type != Instruction::OPERATOR)
+            continue;
+        OperatorInstruction * definition = (OperatorInstruction *) it->second;
+        if (definition->_operator == OperatorInstruction::PLUS &&
+            definition->left.type == Variant::REGISTER && definition->left._int == 0 &&
+            definition->right.type == Variant::CONST_INT)
+        {
+            field_pointers.insert(it->first);
+        }
+    }
+}
+
+bool MethodGenerator::hoist_loop_invariants(Loop & loop) {
+    // the preheader goes right in front of the header so it can fall through into it.
+    // that only works if nothing inside the loop falls through into the header.
+    BasicBlock * header_block = m_basic_blocks[loop.header];
+    for (std::set<int>::iterator it = header_block->parents.begin(); it != header_block->parents.end(); ++it) {
+        if (loop.blocks.count(*it) && m_basic_blocks[*it]->fallthrough_child == loop.header)
+            return false;
+    }
+
+    Liveness liveness;
+    calculate_live_registers(liveness);
+    std::set<int> field_pointers;
+    calculate_this_field_pointers(field_pointers);
+
+    // the assignments in the loop that each instruction's operands might have come from
+    std::vector<Definition> definitions;
+    std::vector<BitVector> reaching_in;
+    calculate_reaching_definitions(loop.blocks, definitions, reaching_in);
+    std::map<int, std::vector<int> > register_definitions;
+    for (int d = 0; d < (int)definitions.size(); d++)
+        register_definitions[definitions[d].register_index].push_back(d);
+    std::map<Instruction *, std::vector<Instruction *> > loop_operand_definitions;
+    int d = 0;
+    for (std::set<int>::iterator block_it = loop.blocks.begin(); block_it != loop.blocks.end(); ++block_it) {
+        BasicBlock * block = m_basic_blocks[*block_it];
+        BitVector reaching = reaching_in[*block_it];
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+            std::set<int> read;
+            (*it)->insertReadRegisters(read);
+            std::vector<Instruction *> & operand_definitions = loop_operand_definitions[*it];
+            for (std::set<int>::iterator read_it = read.begin(); read_it != read.end(); ++read_it) {
+                std::vector<int> & candidates = register_definitions[*read_it];
+                for (int i = 0; i < (int)candidates.size(); i++) {
+                    if (reaching.test(candidates[i]))
+                        operand_definitions.push_back(definitions[candidates[i]].instruction);
+                }
+            }
+            // this instruction's own assignments replace the others to the same registers
+            for (; d < (int)definitions.size() && definitions[d].instruction == *it; d++) {
+                std::vector<int> & others = register_definitions[definitions[d].register_index];
+                for (int i = 0; i < (int)others.size(); i++)
+                    reaching.reset(others[i]);
+                reaching.set(d);
+            }
+        }
+    }
+
+    // how many times each register is assigned in the loop, and whether anything in the
+    // loop could change memory that we'd like to read ahead of time.
+    std::map<int, int> definition_count;
+    bool writes_memory = false;
+    bool checks_bounds = false;
+    for (std::set<int>::iterator block_it = loop.blocks.begin(); block_it != loop.blocks.end(); ++block_it) {
+        BasicBlock * block = m_basic_blocks[*block_it];
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+            Instruction * instruction = *it;
+            std::set<int> mangled;
+            instruction->insertMangledRegisters(mangled);
+            for (std::set<int>::iterator mangled_it = mangled.begin(); mangled_it != mangled.end(); ++mangled_it)
+                definition_count[*mangled_it]++;
+            if (instruction->type == Instruction::WRITE_POINTER ||
+                instruction->type == Instruction::METHOD_CALL ||
+                instruction->type == Instruction::NON_VOID_METHOD_CALL)
+            {
+                writes_memory = true;
+            }
+            if (instruction->type == Instruction::BOUNDS_CHECK)
+                checks_bounds = true;
+        }
+    }
+
+    std::vector<Instruction *> hoisted;
+    std::set<Instruction *> hoisted_set;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (std::set<int>::iterator block_it = loop.blocks.begin(); block_it != loop.blocks.end(); ++block_it) {
+            BasicBlock * block = m_basic_blocks[*block_it];
+            InstructionList::iterator it = block->instructions.begin();
+            while (it != block->instructions.end()) {
+                Instruction * instruction = *it;
+                bool invariant = false;
+                if (instruction->type == Instruction::OPERATOR) {
+                    OperatorInstruction * operator_instruction = (OperatorInstruction *) instruction;
+                    invariant = true;
+                    // division by something that might be zero has to stay where it was
+                    if (operator_instruction->_operator == OperatorInstruction::DIVIDE || operator_instruction->_operator == OperatorInstruction::MOD)
+                        invariant = operator_instruction->right.type == Variant::CONST_INT && operator_instruction->right._int != 0;
+                } else if (instruction->type == Instruction::UNARY) {
+                    invariant = true;
+                } else if (instruction->type == Instruction::READ_POINTER) {
+                    // the loop body might never run, so only read ahead from places we know are valid
+                    ReadPointerInstruction * read_pointer_instruction = (ReadPointerInstruction *) instruction;
+                    invariant = ! writes_memory && ((*block_it == loop.header && ! checks_bounds) ||
+                        (read_pointer_instruction->source_pointer.type == Variant::REGISTER && field_pointers.count(read_pointer_instruction->source_pointer._int)));
+                }
+
+                if (invariant) {
+                    std::set<int> mangled;
+                    instruction->insertMangledRegisters(mangled);
+                    int dest = *mangled.begin();
+                    // the one and only assignment in the loop, and nobody in the loop
+                    // wants the value from before the loop
+                    invariant = definition_count[dest] == 1 && ! liveness.is_live_in(loop.header, dest);
+
+                    // and the operands can only come from outside the loop, or from what we already took out
+                    std::vector<Instruction *> & operand_definitions = loop_operand_definitions[instruction];
+                    for (int i = 0; i < (int)operand_definitions.size(); i++) {
+                        if (! hoisted_set.count(operand_definitions[i]))
+                            invariant = false;
+                    }
+
+                    if (invariant) {
+                        hoisted.push_back(instruction);
+                        hoisted_set.insert(instruction);
+                        it = block->instructions.erase(it);
+                        changed = true;
+                        continue;
+                    }
+                }
+                ++it;
+            }
+        }
+    }
+
+    if (hoisted.empty())
+        return false;
+
+    int preheader = insert_preheader(loop);
+    BasicBlock * preheader_block = m_basic_blocks[preheader];
+    preheader_block->instructions.insert(preheader_block->instructions.end(), hoisted.begin(), hoisted.end());
+    return true;
+}
+
+void MethodGenerator::loop_invariant_code_motion() {
+    // inner loops first, so that what comes out of them can keep going out of the outer ones.
+    // hoisting only adds preheaders, and insert_preheader keeps the loops up to date.
+    std::vector<bool> done(control_flow().loops.size(), false);
+    while (true) {
+        assert(m_control_flow.valid);
+        std::vector<Loop> & loops = m_control_flow.loops;
+        int smallest = -1;
+        for (int i = 0; i < (int)loops.size(); i++) {
+            if (done[i])
+                continue;
+            if (smallest == -1 || loops[i].blocks.size() < loops[smallest].blocks.size())
+                smallest = i;
+        }
+        if (smallest == -1 || over_budget())
+            break;
+        m_work += instruction_count();
+        done[smallest] = true;
+        Loop loop = loops[smallest];
+        hoist_loop_invariants(loop);
+    }
+}
+
+void MethodGenerator::calculate_parents() {
+    for (int i = 0; i < (int)m_basic_blocks.size(); i++)
+        m_basic_blocks[i]->parents.clear();
+    for (int i = 0; i < (int)m_basic_blocks.size(); i++) {
+        BasicBlock * block = m_basic_blocks[i];
+        if (block->deleted)
+            continue;
+        if (block->jump_child != -1)
+            m_basic_blocks[block->jump_child]->parents.insert(i);
+        if (block->fallthrough_child != -1)
+            m_basic_blocks[block->fallthrough_child]->parents.insert(i);
+    }
+}
+
+void MethodGenerator::calculate_postorder(int block_index, std::vector<bool> & visited, std::vector<int> & order) {
+    if (visited[block_index])
+        return;
+    visited[block_index] = true;
+    BasicBlock * block = m_basic_blocks[block_index];
+    if (block->jump_child != -1)
+        calculate_postorder(block->jump_child, visited, order);
+    if (block->fallthrough_child != -1)
+        calculate_postorder(block->fallthrough_child, visited, order);
+    order.push_back(block_index);
+}
+
+void MethodGenerator::calculate_dominators(std::vector<int> & immediate_dominator, std::vector<int> & reverse_postorder) {
+    // Cooper, Harvey and Kennedy's "A Simple, Fast Dominance Algorithm".
+    // blocks that can't be reached are left out of the order and have no dominator.
+    int entry = 0;
+    while (m_basic_blocks[entry]->deleted)
+        entry++;
+    std::vector<bool> visited(m_basic_blocks.size(), false);
+    reverse_postorder.clear();
+    calculate_postorder(entry, visited, reverse_postorder);
+    std::reverse(reverse_postorder.begin(), reverse_postorder.end());
+    std::vector<int> order_number(m_basic_blocks.size(), -1);
+    for (int i = 0; i < (int)reverse_postorder.size(); i++)
+        order_number[reverse_postorder[i]] = i;
+
+    immediate_dominator.assign(m_basic_blocks.size(), -1);
+    immediate_dominator[entry] = entry;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 1; i < (int)reverse_postorder.size(); i++) {
+            int index = reverse_postorder[i];
+            BasicBlock * block = m_basic_blocks[index];
+            int new_dominator = -1;
+            for (std::set<int>::iterator it = block->parents.begin(); it != block->parents.end(); ++it) {
+                int parent = *it;
+                if (immediate_dominator[parent] == -1)
+                    continue; // not processed yet
+                if (new_dominator == -1) {
+                    new_dominator = parent;
+                    continue;
+                }
+                // walk up from both until they meet
+                int left = parent;
+                int right = new_dominator;
+                while (left != right) {
+                    while (order_number[left] > order_number[right])
+                        left = immediate_dominator[left];
+                    while (order_number[right] > order_number[left])
+                        right = immediate_dominator[right];
+                }
+                new_dominator = left;
+            }
+            if (immediate_dominator[index] != new_dominator) {
+                immediate_dominator[index] = new_dominator;
+                changed = true;
+            }
+        }
+    }
+    immediate_dominator[entry] = -1;
+}
+
+void MethodGenerator::calculate_dominance_frontiers(std::vector<int> & immediate_dominator, std::vector<int> & reverse_postorder, std::vector<std::set<int> > & frontiers) {
+    frontiers.clear();
+    frontiers.resize(m_basic_blocks.size());
+    for (int i = 0; i < (int)reverse_postorder.size(); i++) {
+        int index = reverse_postorder[i];
+        BasicBlock * block = m_basic_blocks[index];
+        if (block->parents.size() < 2)
+            continue;
+        // everything between a parent and our dominator sees us on its frontier
+        for (std::set<int>::iterator it = block->parents.begin(); it != block->parents.end(); ++it) {
+            int runner = *it;
+            if (runner != reverse_postorder[0] && immediate_dominator[runner] == -1)
+                continue; // parent can't be reached
+            while (runner != immediate_dominator[index]) {
+                frontiers[runner].insert(index);
+                runner = immediate_dominator[runner];
+            }
+        }
+    }
+}
+
+void MethodGenerator::construct_ssa() {
+    calculate_parents();
+
+    // the entry block can't merge values from its parents, so a loop
+    // that starts right away gets an empty block in front of it.
+    int entry = 0;
+    while (m_basic_blocks[entry]->deleted)
+        entry++;
+    if (! m_basic_blocks[entry]->parents.empty())
+        insert_block(entry);
+
+    ControlFlow & flow = control_flow();
+    std::vector<int> & immediate_dominator = flow.immediate_dominator;
+    std::vector<int> & reverse_postorder = flow.reverse_postorder;
+    std::vector<std::set<int> > frontiers;
+    calculate_dominance_frontiers(immediate_dominator, reverse_postorder, frontiers);
+    Liveness liveness;
+    calculate_live_registers(liveness);
+
+    // where each register is assigned
+    std::map<int, std::set<int> > definition_blocks;
+    for (int i = 0; i < (int)reverse_postorder.size(); i++) {
+        BasicBlock * block = m_basic_blocks[reverse_postorder[i]];
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+            int mangled = (*it)->mangledRegister();
+            if (mangled != -1)
+                definition_blocks[mangled].insert(reverse_postorder[i]);
+        }
+    }
+
+    // a phi goes wherever two assignments meet, unless nobody reads the register after that.
+    // remember which register each phi is for, the renaming loses track.
+    std::map<Instruction *, int> phi_variables;
+    for (std::map<int, std::set<int> >::iterator it = definition_blocks.begin(); it != definition_blocks.end(); ++it) {
+        int variable = it->first;
+        std::vector<int> work(it->second.begin(), it->second.end());
+        std::set<int> has_phi;
+        while (! work.empty()) {
+            int index = work.back();
+            work.pop_back();
+            for (std::set<int>::iterator frontier_it = frontiers[index].begin(); frontier_it != frontiers[index].end(); ++frontier_it) {
+                int frontier = *frontier_it;
+                if (has_phi.count(frontier) || ! liveness.is_live_in(frontier, variable))
+                    continue;
+                has_phi.insert(frontier);
+                BasicBlock * frontier_block = m_basic_blocks[frontier];
+                PhiInstruction * phi_instruction = new (m_instruction_arena) PhiInstruction(Variant(variable, Variant::REGISTER));
+                for (std::set<int>::iterator parent_it = frontier_block->parents.begin(); parent_it != frontier_block->parents.end(); ++parent_it) {
+                    phi_instruction->parents.push_back(*parent_it);
+                    phi_instruction->sources.push_back(Variant(variable, Variant::REGISTER));
+                }
+                frontier_block->instructions.push_front(phi_instruction);
+                phi_variables[phi_instruction] = variable;
+                // the phi is an assignment too
+                if (! it->second.count(frontier))
+                    work.push_back(frontier);
+            }
+        }
+    }
+
+    // every assignment gets a fresh register. the original registers are left holding
+    // whatever they had on the way in, which is how parameters keep their stack slots.
+    std::vector<int> current_version(m_register_count);
+    for (int i = 0; i < m_register_count; i++)
+        current_version[i] = i;
+    rename_ssa_registers(reverse_postorder[0], flow.dominator_children, current_version, phi_variables);
+}
+
+void MethodGenerator::rename_ssa_registers(int block_index, std::vector<std::vector<int> > & dominator_children, std::vector<int> & current_version, std::map<Instruction *, int> & phi_variables) {
+    BasicBlock * block = m_basic_blocks[block_index];
+    // what to put back when we're done with the blocks we dominate
+    std::vector<std::pair<int, int> > previous_versions;
+    for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+        Instruction * instruction = *it;
+        if (instruction->type != Instruction::PHI)
+            instruction->remapReadRegisters(current_version);
+        std::set<int> mangled;
+        instruction->insertMangledRegisters(mangled);
+        for (std::set<int>::iterator mangled_it = mangled.begin(); mangled_it != mangled.end(); ++mangled_it) {
+            int variable = *mangled_it;
+            previous_versions.push_back(std::pair<int, int>(variable, current_version[variable]));
+            current_version[variable] = next_available_register(m_register_type[variable])._int;
+        }
+        instruction->remapMangledRegisters(current_version);
+    }
+
+    // tell the children's phis what we ended up with
+    int children[] = { block->jump_child, block->fallthrough_child };
+    for (int c = 0; c < 2; c++) {
+        if (children[c] == -1 || (c == 1 && children[1] == children[0]))
+            continue;
+        BasicBlock * child = m_basic_blocks[children[c]];
+        for (InstructionList::iterator it = child->instructions.begin(); it != child->instructions.end() && (*it)->type == Instruction::PHI; ++it) {
+            PhiInstruction * phi_instruction = (PhiInstruction *) *it;
+            for (int i = 0; i < (int)phi_instruction->parents.size(); i++) {
+                if (phi_instruction->parents[i] == block_index)
+                    phi_instruction->sources[i] = Variant(current_version[phi_variables[phi_instruction]], Variant::REGISTER);
+            }
+        }
+    }
+
+    for (int i = 0; i < (int)dominator_children[block_index].size(); i++)
+        rename_ssa_registers(dominator_children[block_index][i], dominator_children, current_version, phi_variables);
+
+    for (int i = previous_versions.size() - 1; i >= 0; i--)
+        current_version[previous_versions[i].first] = previous_versions[i].second;
+}
+
+int MethodGenerator::find_register_class(RegisterClasses & classes, int register_index) {
+    int root = register_index;
+    while (classes.representative[root] != root)
+        root = classes.representative[root];
+    // point everyone on the way straight at the root
+    while (classes.representative[register_index] != root) {
+        int next = classes.representative[register_index];
+        classes.representative[register_index] = root;
+        register_index = next;
+    }
+    return root;
+}
+
+bool MethodGenerator::coalesce_registers(RegisterClasses & classes, int left, int right) {
+    left = find_register_class(classes, left);
+    right = find_register_class(classes, right);
+    if (left == right)
+        return true;
+    if (m_register_type[left] != m_register_type[right])
+        return false;
+    // parameters each have their own stack slot
+    int parameter_count = parameter_register_count();
+    if (left < parameter_count && right < parameter_count)
+        return false;
+    for (std::set<int>::iterator it = classes.members[right].begin(); it != classes.members[right].end(); ++it) {
+        if (classes.interference[left].count(*it))
+            return false;
+    }
+
+    // the lower one survives, so a parameter stays where the caller put it
+    if (right < left)
+        std::swap(left, right);
+    classes.representative[right] = left;
+    classes.members[left].insert(classes.members[right].begin(), classes.members[right].end());
+    classes.interference[left].insert(classes.interference[right].begin(), classes.interference[right].end());
+    classes.members[right].clear();
+    classes.interference[right].clear();
+    return true;
+}
+
+int MethodGenerator::split_edge(int parent_index, int child_index) {
+    invalidate_control_flow();
+    BasicBlock * parent = m_basic_blocks[parent_index];
+    int index;
+    if (parent->fallthrough_child == child_index) {
+        // right after the parent, falling through into the child
+        index = insert_block(parent_index + 1);
+        m_basic_blocks[parent_index]->fallthrough_child = index;
+    } else {
+        int previous = child_index - 1;
+        while (previous >= 0 && m_basic_blocks[previous]->deleted)
+            previous--;
+        if (previous == -1 || m_basic_blocks[previous]->fallthrough_child != child_index) {
+            // nothing falls into the child, so we can sit right in front of it
+            index = insert_block(child_index);
+            if (parent_index >= index)
+                parent_index++;
+        } else {
+            // no room in front of the child. go at the end and jump back.
+            BasicBlock * block = new (m_block_arena) BasicBlock(0, 0, m_node_arena);
+            block->instructions.push_back(new (m_instruction_arena) GotoInstruction(-1));
+            block->jump_child = child_index;
+            block->fallthrough_child = -1;
+            index = m_basic_blocks.size();
+            m_basic_blocks.push_back(block);
+            m_basic_blocks[child_index]->parents.insert(index);
+        }
+        m_basic_blocks[parent_index]->jump_child = index;
+    }
+    BasicBlock * block = m_basic_blocks[index];
+    BasicBlock * child = m_basic_blocks[block->jump_child != -1 ? block->jump_child : block->fallthrough_child];
+    child->parents.erase(parent_index);
+    block->parents.insert(parent_index);
+    return index;
+}
+
+void MethodGenerator::insert_parallel_copies(BasicBlock * block, std::vector<std::pair<int, Variant> > & copies) {
+    // copies go in front of the jump at the end of the block
+    InstructionList::iterator position = block->instructions.end();
+    if (! block->instructions.empty()) {
+        Instruction * last_instruction = block->instructions.back();
+        if (last_instruction->type == Instruction::IF || last_instruction->type == Instruction::GOTO)
+            --position;
+    }
+
+    // the copies all happen at once, so don't overwrite anything another copy still has to read
+    while (! copies.empty()) {
+        bool progress = false;
+        for (int i = 0; i < (int)copies.size() && ! progress; i++) {
+            int dest = copies[i].first;
+            bool still_needed = false;
+            for (int j = 0; j < (int)copies.size(); j++) {
+                if (j != i && copies[j].second.type == Variant::REGISTER && copies[j].second._int == dest)
+                    still_needed = true;
+            }
+            if (still_needed)
+                continue;
+            block->instructions.insert(position, new (m_instruction_arena) CopyInstruction(Variant(dest, Variant::REGISTER), copies[i].second));
+            copies.erase(copies.begin() + i);
+            progress = true;
+        }
+        if (! progress) {
+            // everything left is a cycle. move one value out of the way to break it.
+            int dest = copies[0].first;
+            Variant temporary = next_available_register(m_register_type[dest]);
+            block->instructions.insert(position, new (m_instruction_arena) CopyInstruction(temporary, Variant(dest, Variant::REGISTER)));
+            for (int j = 0; j < (int)copies.size(); j++) {
+                if (copies[j].second.type == Variant::REGISTER && copies[j].second._int == dest)
+                    copies[j].second = temporary;
+            }
+        }
+    }
+}
+
+void MethodGenerator::destruct_ssa() {
+    Liveness liveness;
+    calculate_live_registers(liveness);
+
+    // two registers interfere if one is assigned while the other is live.
+    // a copy doesn't make its dest interfere with its source; they hold the same value.
+    RegisterClasses classes;
+    classes.representative.resize(m_register_count);
+    classes.members.resize(m_register_count);
+    classes.interference.resize(m_register_count);
+    for (int i = 0; i < m_register_count; i++) {
+        classes.representative[i] = i;
+        classes.members[i].insert(i);
+    }
+    BitVector live(m_register_count);
+    for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+        BasicBlock * block = m_basic_blocks[b];
+        if (block->deleted)
+            continue;
+        liveness.get_live_out(b, live);
+        for (InstructionList::reverse_iterator it = block->instructions.rbegin(); it != block->instructions.rend(); ++it) {
+            Instruction * instruction = *it;
+            int copy_source = -1;
+            if (instruction->type == Instruction::COPY && ((CopyInstruction *) instruction)->source.type == Variant::REGISTER)
+                copy_source = ((CopyInstruction *) instruction)->source._int;
+            std::set<int> mangled;
+            instruction->insertMangledRegisters(mangled);
+            for (std::set<int>::iterator mangled_it = mangled.begin(); mangled_it != mangled.end(); ++mangled_it) {
+                for (int live_register = live.next(0); live_register != -1; live_register = live.next(live_register + 1)) {
+                    if (live_register == *mangled_it || live_register == copy_source)
+                        continue;
+                    classes.interference[*mangled_it].insert(live_register);
+                    classes.interference[live_register].insert(*mangled_it);
+                }
+            }
+            // the phis are all assigned at once at the top of the block, so they stay live for each other
+            if (instruction->type == Instruction::PHI)
+                continue;
+            step_live_registers(instruction, live);
+        }
+    }
+
+    // share registers across phis first, since their copies are the expensive ones, then plain copies
+    for (int pass = 0; pass < 2; pass++) {
+        for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+            BasicBlock * block = m_basic_blocks[b];
+            if (block->deleted)
+                continue;
+            for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+                Instruction * instruction = *it;
+                if (pass == 0 && instruction->type == Instruction::PHI) {
+                    PhiInstruction * phi_instruction = (PhiInstruction *) instruction;
+                    for (int i = 0; i < (int)phi_instruction->sources.size(); i++) {
+                        if (phi_instruction->sources[i].type == Variant::REGISTER)
+                            coalesce_registers(classes, phi_instruction->dest._int, phi_instruction->sources[i]._int);
+                    }
+                } else if (pass == 1 && instruction->type == Instruction::COPY) {
+                    CopyInstruction * copy_instruction = (CopyInstruction *) instruction;
+                    if (copy_instruction->source.type == Variant::REGISTER)
+                        coalesce_registers(classes, copy_instruction->dest._int, copy_instruction->source._int);
+                }
+            }
+        }
+    }
+
+    std::vector<int> new_number(m_register_count);
+    for (int i = 0; i < m_register_count; i++)
+        new_number[i] = find_register_class(classes, i);
+    for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+        BasicBlock * block = m_basic_blocks[b];
+        if (block->deleted)
+            continue;
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it)
+            (*it)->remapRegisters(new_number);
+    }
+
+    // whatever the phis still need copied, grouped by edge
+    std::map<std::pair<int, int>, std::vector<std::pair<int, Variant> > > edge_copies;
+    for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+        BasicBlock * block = m_basic_blocks[b];
+        if (block->deleted)
+            continue;
+        InstructionList::iterator it = block->instructions.begin();
+        while (it != block->instructions.end() && (*it)->type == Instruction::PHI) {
+            PhiInstruction * phi_instruction = (PhiInstruction *) *it;
+            for (int i = 0; i < (int)phi_instruction->sources.size(); i++) {
+                if (phi_instruction->sources[i] == phi_instruction->dest)
+                    continue;
+                edge_copies[std::pair<int, int>(phi_instruction->parents[i], b)].push_back(std::pair<int, Variant>(phi_instruction->dest._int, phi_instruction->sources[i]));
+            }
+            it = block->instructions.erase(it);
+            delete phi_instruction;
+        }
+    }
+
+    // splitting edges moves blocks around, so hang on to the blocks themselves
+    std::vector<std::pair<BasicBlock *, BasicBlock *> > edges;
+    std::vector<std::vector<std::pair<int, Variant> > > copies;
+    for (std::map<std::pair<int, int>, std::vector<std::pair<int, Variant> > >::iterator it = edge_copies.begin(); it != edge_copies.end(); ++it) {
+        edges.push_back(std::pair<BasicBlock *, BasicBlock *>(m_basic_blocks[it->first.first], m_basic_blocks[it->first.second]));
+        copies.push_back(it->second);
+    }
+    for (int i = 0; i < (int)edges.size(); i++) {
+        int parent_index = std::find(m_basic_blocks.begin(), m_basic_blocks.end(), edges[i].first) - m_basic_blocks.begin();
+        int child_index = std::find(m_basic_blocks.begin(), m_basic_blocks.end(), edges[i].second) - m_basic_blocks.begin();
+        BasicBlock * parent = edges[i].first;
+        // a parent with somewhere else to go needs a block of its own for the copies
+        bool only_child = parent->jump_child == -1 || parent->fallthrough_child == -1 || parent->jump_child == parent->fallthrough_child;
+        BasicBlock * block = only_child ? parent : m_basic_blocks[split_edge(parent_index, child_index)];
+        insert_parallel_copies(block, copies[i]);
+    }
+
+    // copies between registers that ended up shared don't do anything anymore
+    for (int b = 0; b < (int)m_basic_blocks.size(); b++) {
+        BasicBlock * block = m_basic_blocks[b];
+        InstructionList::iterator it = block->instructions.begin();
+        while (it != block->instructions.end()) {
+            Instruction * instruction = *it;
+            if (instruction->type == Instruction::COPY && ((CopyInstruction *) instruction)->source == ((CopyInstruction *) instruction)->dest) {
+                it = block->instructions.erase(it);
+                delete instruction;
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+int MethodGenerator::next_value_number(ValueNumbers & values, Variant leader) {
+    values.leader.push_back(leader);
+    return values.leader.size() - 1;
+}
+
+int MethodGenerator::get_value_number(ValueNumbers & values, Variant register_or_const) {
+    if (register_or_const.type == Variant::REGISTER)
+        return values.register_value[register_or_const._int];
+    std::map<Variant, int>::iterator it = values.constant_value.find(register_or_const);
+    if (it != values.constant_value.end())
+        return it->second;
+    int value = next_value_number(values, register_or_const);
+    values.constant_value[register_or_const] = value;
+    return value;
+}
+
+MethodGenerator::Variant MethodGenerator::get_leader(ValueNumbers & values, Variant register_or_const) {
+    if (register_or_const.type != Variant::REGISTER || values.register_value[register_or_const._int] == -1)
+        return register_or_const;
+    return values.leader[values.register_value[register_or_const._int]];
+}
+
+void MethodGenerator::insert_assigned_registers(std::set<int> & assigned) {
+    for (int i = 0; i < (int)m_basic_blocks.size(); i++) {
+        BasicBlock * block = m_basic_blocks[i];
+        if (block->deleted)
+            continue;
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it)
+            (*it)->insertMangledRegisters(assigned);
+    }
+}
+
+MethodGenerator::LatticeValue MethodGenerator::get_lattice_value(std::vector<LatticeValue> & values, Variant register_or_const) {
+    if (register_or_const.type == Variant::REGISTER)
+        return values[register_or_const._int];
+    return LatticeValue(register_or_const);
+}
+
+bool MethodGenerator::lower_lattice_value(LatticeValue & value, LatticeValue other) {
+    // values only ever go from unknown to constant to varying
+    if (other.state == LatticeValue::UNKNOWN || value.state == LatticeValue::VARYING)
+        return false;
+    if (value.state == LatticeValue::UNKNOWN) {
+        value = other;
+        return true;
+    }
+    if (other.state == LatticeValue::CONSTANT && other.constant == value.constant)
+        return false;
+    value = LatticeValue(LatticeValue::VARYING);
+    return true;
+}
+
+MethodGenerator::LatticeValue MethodGenerator::evaluate_lattice_value(std::vector<LatticeValue> & values, Instruction * instruction) {
+    switch (instruction->type) {
+        case Instruction::COPY:
+        {
+            CopyInstruction * copy_instruction = (CopyInstruction *) instruction;
+            return get_lattice_value(values, copy_instruction->source);
+        }
+        case Instruction::OPERATOR:
+        {
+            OperatorInstruction * operator_instruction = (OperatorInstruction *) instruction;
+            LatticeValue left = get_lattice_value(values, operator_instruction->left);
+            LatticeValue right = get_lattice_value(values, operator_instruction->right);
+            // one side is enough to decide these
+            if (operator_instruction->_operator == OperatorInstruction::AND || operator_instruction->_operator == OperatorInstruction::OR) {
+                bool decider = operator_instruction->_operator == OperatorInstruction::OR;
+                if (left.state == LatticeValue::CONSTANT && left.constant._bool == decider)
+                    return left;
+                if (right.state == LatticeValue::CONSTANT && right.constant._bool == decider)
+                    return right;
+            }
+            if (left.state == LatticeValue::UNKNOWN || right.state == LatticeValue::UNKNOWN)
+                return LatticeValue();
+            if (left.state == LatticeValue::VARYING || right.state == LatticeValue::VARYING)
+                return LatticeValue(LatticeValue::VARYING);
+            OperatorInstruction * constant_instruction = new (m_instruction_arena) OperatorInstruction(operator_instruction->dest,
+                left.constant, operator_instruction->_operator, right.constant);
+            CopyInstruction * copy_instruction = constant_expression_evaluated(constant_instruction);
+            if (copy_instruction == NULL) {
+                delete constant_instruction;
+                return LatticeValue(LatticeValue::VARYING);
+            }
+            LatticeValue value(copy_instruction->source);
+            delete copy_instruction;
+            return value;
+        }
+        case Instruction::UNARY:
+        {
+            UnaryInstruction * unary_instruction = (UnaryInstruction *) instruction;
+            LatticeValue source = get_lattice_value(values, unary_instruction->source);
+            if (source.state != LatticeValue::CONSTANT)
+                return source;
+            UnaryInstruction * constant_instruction = new (m_instruction_arena) UnaryInstruction(unary_instruction->dest, unary_instruction->_operator, source.constant);
+            CopyInstruction * copy_instruction = constant_expression_evaluated(constant_instruction);
+            if (copy_instruction == NULL) {
+                delete constant_instruction;
+                return LatticeValue(LatticeValue::VARYING);
+            }
+            LatticeValue value(copy_instruction->source);
+            delete copy_instruction;
+            return value;
+        }
+        default:
+            // calls, allocations and memory reads could be anything
+            return LatticeValue(LatticeValue::VARYING);
+    }
+}
+
+bool MethodGenerator::mark_edge_executable(int parent_index, int child_index, std::set<std::pair<int, int> > & executable_edges, std::vector<bool> & executable_blocks) {
+    if (child_index == -1 || ! executable_edges.insert(std::pair<int, int>(parent_index, child_index)).second)
+        return false;
+    executable_blocks[child_index] = true;
+    return true;
+}
+
+void MethodGenerator::sparse_conditional_constant_propagation() {
+    // Wegman and Zadeck. a block is only looked at once some path can reach it,
+    // and a phi only listens to the parents that can get to it.
+    std::vector<int> reverse_postorder = control_flow().reverse_postorder;
+
+    // registers that are never assigned came from the caller
+    std::vector<LatticeValue> values(m_register_count);
+    std::set<int> assigned;
+    insert_assigned_registers(assigned);
+    for (int i = 0; i < m_register_count; i++) {
+        if (! assigned.count(i))
+            values[i] = LatticeValue(LatticeValue::VARYING);
+    }
+
+    std::set<std::pair<int, int> > executable_edges;
+    std::vector<bool> executable_blocks(m_basic_blocks.size(), false);
+    executable_blocks[reverse_postorder[0]] = true;
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < (int)reverse_postorder.size(); i++) {
+            int block_index = reverse_postorder[i];
+            BasicBlock * block = m_basic_blocks[block_index];
+            if (! executable_blocks[block_index])
+                continue;
+
+            for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+                Instruction * instruction = *it;
+                if (instruction->type == Instruction::PHI) {
+                    PhiInstruction * phi_instruction = (PhiInstruction *) instruction;
+                    LatticeValue value;
+                    for (int j = 0; j < (int)phi_instruction->sources.size(); j++) {
+                        if (executable_edges.count(std::pair<int, int>(phi_instruction->parents[j], block_index)))
+                            lower_lattice_value(value, get_lattice_value(values, phi_instruction->sources[j]));
+                    }
+                    changed |= lower_lattice_value(values[phi_instruction->dest._int], value);
+                    continue;
+                }
+                std::set<int> mangled;
+                instruction->insertMangledRegisters(mangled);
+                if (mangled.empty())
+                    continue;
+                LatticeValue value = evaluate_lattice_value(values, instruction);
+                for (std::set<int>::iterator mangled_it = mangled.begin(); mangled_it != mangled.end(); ++mangled_it)
+                    changed |= lower_lattice_value(values[*mangled_it], value);
+            }
+
+            // follow the ways out of the block that can happen
+            Instruction * last_instruction = block->instructions.empty() ? NULL : block->instructions.back();
+            if (last_instruction != NULL && last_instruction->type == Instruction::IF) {
+                IfInstruction * if_instruction = (IfInstruction *) last_instruction;
+                LatticeValue condition = get_lattice_value(values, if_instruction->condition);
+                if (condition.state == LatticeValue::CONSTANT) {
+                    if (condition.constant._bool)
+                        changed |= mark_edge_executable(block_index, block->fallthrough_child, executable_edges, executable_blocks);
+                    else
+                        changed |= mark_edge_executable(block_index, block->jump_child, executable_edges, executable_blocks);
+                } else if (condition.state == LatticeValue::VARYING) {
+                    changed |= mark_edge_executable(block_index, block->fallthrough_child, executable_edges, executable_blocks);
+                    changed |= mark_edge_executable(block_index, block->jump_child, executable_edges, executable_blocks);
+                }
+            } else {
+                changed |= mark_edge_executable(block_index, block->fallthrough_child, executable_edges, executable_blocks);
+                changed |= mark_edge_executable(block_index, block->jump_child, executable_edges, executable_blocks);
+            }
+        }
+    }
+
+    for (int i = 0; i < (int)m_basic_blocks.size(); i++) {
+        BasicBlock * block = m_basic_blocks[i];
+        if (block->deleted)
+            continue;
+        if (! executable_blocks[i]) {
+            // nothing can get here
+            for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it)
+                delete *it;
+            block->instructions.clear();
+            block->jump_child = -1;
+            block->fallthrough_child = -1;
+            block->deleted = true;
+            invalidate_control_flow();
+            continue;
+        }
+
+        // constants are assigned directly. value numbering takes care of the uses.
+        std::vector<Instruction *> constant_phis;
+        InstructionList::iterator it = block->instructions.begin();
+        while (it != block->instructions.end()) {
+            Instruction * instruction = *it;
+            std::set<int> mangled;
+            instruction->insertMangledRegisters(mangled);
+            if (mangled.size() != 1 || values[*mangled.begin()].state != LatticeValue::CONSTANT || instruction->type == Instruction::COPY) {
+                ++it;
+                continue;
+            }
+            int dest = *mangled.begin();
+            switch (instruction->type) {
+                case Instruction::PHI:
+                    constant_phis.push_back(new (m_instruction_arena) CopyInstruction(Variant(dest, Variant::REGISTER), values[dest].constant));
+                    it = block->instructions.erase(it);
+                    delete instruction;
+                    break;
+                case Instruction::OPERATOR:
+                case Instruction::UNARY:
+                    *it = new (m_instruction_arena) CopyInstruction(Variant(dest, Variant::REGISTER), values[dest].constant);
+                    delete instruction;
+                    ++it;
+                    break;
+                default:
+                    ++it;
+                    break;
+            }
+        }
+        it = block->instructions.begin();
+        while (it != block->instructions.end() && (*it)->type == Instruction::PHI)
+            ++it;
+        block->instructions.insert(it, constant_phis.begin(), constant_phis.end());
+
+        // a branch that always goes the same way doesn't need to look
+        Instruction * last_instruction = block->instructions.empty() ? NULL : block->instructions.back();
+        if (last_instruction != NULL && last_instruction->type == Instruction::IF) {
+            IfInstruction * if_instruction = (IfInstruction *) last_instruction;
+            LatticeValue condition = get_lattice_value(values, if_instruction->condition);
+            if (condition.state == LatticeValue::CONSTANT) {
+                block->instructions.pop_back();
+                invalidate_control_flow();
+                if (condition.constant._bool) {
+                    block->jump_child = -1;
+                } else {
+                    block->instructions.push_back(new (m_instruction_arena) GotoInstruction(if_instruction->goto_index));
+                    block->fallthrough_child = -1;
+                }
+                delete if_instruction;
+            }
+        }
+    }
+
+    // phis forget about the parents that went away
+    calculate_parents();
+    for (int i = 0; i < (int)m_basic_blocks.size(); i++) {
+        BasicBlock * block = m_basic_blocks[i];
+        if (block->deleted)
+            continue;
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end() && (*it)->type == Instruction::PHI; ++it) {
+            PhiInstruction * phi_instruction = (PhiInstruction *) *it;
+            std::vector<int> parents;
+            std::vector<Variant> sources;
+            for (int j = 0; j < (int)phi_instruction->parents.size(); j++) {
+                if (block->parents.count(phi_instruction->parents[j])) {
+                    parents.push_back(phi_instruction->parents[j]);
+                    sources.push_back(phi_instruction->sources[j]);
+                }
+            }
+            phi_instruction->parents = parents;
+            phi_instruction->sources = sources;
+        }
+    }
+}
+
+// as far as range analysis is concerned, anything bigger than this could be anything
+const long long unbounded_value = (long long)1 << 40;
+// how far to follow assignments back when working out a range
+const int max_range_depth = 8;
+
+void MethodGenerator::bounds_check_elimination() {
+    if (! m_bounds_check)
+        return;
+
+    RangeAnalysis analysis;
+    calculate_range_analysis(analysis);
+    eliminate_bounds_checks(control_flow().reverse_postorder[0], analysis);
+}
+
+void MethodGenerator::calculate_range_analysis(RangeAnalysis & analysis) {
+    calculate_parents();
+    ControlFlow & flow = control_flow();
+    std::vector<int> & reverse_postorder = flow.reverse_postorder;
+    analysis.immediate_dominator = flow.immediate_dominator;
+    analysis.dominator_children = flow.dominator_children;
+
+    analysis.definitions.assign(m_register_count, (Instruction *) NULL);
+    analysis.definition_block.assign(m_register_count, -1);
+    for (int i = 0; i < (int)reverse_postorder.size(); i++) {
+        BasicBlock * block = m_basic_blocks[reverse_postorder[i]];
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+            std::set<int> mangled;
+            (*it)->insertMangledRegisters(mangled);
+            for (std::set<int>::iterator mangled_it = mangled.begin(); mangled_it != mangled.end(); ++mangled_it) {
+                analysis.definitions[*mangled_it] = *it;
+                analysis.definition_block[*mangled_it] = reverse_postorder[i];
+            }
+        }
+    }
+}
+
+bool MethodGenerator::scaled_range_fits(ValueRange range, int scale, ValueRange offset) {
+    if (range.min < -2147483648LL || range.max > 2147483647LL || offset.min < -2147483648LL || offset.max > 2147483647LL)
+        return false;
+    long long low = scale >= 0 ? range.min * scale + offset.min : range.max * scale + offset.min;
+    long long high = scale >= 0 ? range.max * scale + offset.max : range.min * scale + offset.max;
+    return low >= -2147483648LL && high <= 2147483647LL;
+}
+
+void MethodGenerator::eliminate_bounds_checks(int block_index, RangeAnalysis & analysis) {
+    BasicBlock * block = m_basic_blocks[block_index];
+    // what the checks in this block knew before we got here, to put back when we leave
+    std::vector<std::pair<Variant, ValueRange> > previously_checked;
+    std::vector<Variant> newly_checked;
+
+    InstructionList::iterator it = block->instructions.begin();
+    while (it != block->instructions.end()) {
+        if ((*it)->type != Instruction::BOUNDS_CHECK) {
+            ++it;
+            continue;
+        }
+        BoundsCheckInstruction * bounds_check_instruction = (BoundsCheckInstruction *) *it;
+        ValueRange range = calculate_value_range(bounds_check_instruction->index, block_index, analysis, 0);
+        std::map<Variant, ValueRange>::iterator checked_it = analysis.checked.find(bounds_check_instruction->index);
+        if (checked_it != analysis.checked.end()) {
+            range.min = std::max(range.min, checked_it->second.min);
+            range.max = std::min(range.max, checked_it->second.max);
+        }
+        if (range.min >= bounds_check_instruction->min && range.max <= bounds_check_instruction->max) {
+            it = block->instructions.erase(it);
+            delete bounds_check_instruction;
+            continue;
+        }
+
+        // everything after here knows the check passed
+        if (checked_it != analysis.checked.end())
+            previously_checked.push_back(*checked_it);
+        else
+            newly_checked.push_back(bounds_check_instruction->index);
+        analysis.checked.erase(bounds_check_instruction->index);
+        analysis.checked.insert(std::pair<Variant, ValueRange>(bounds_check_instruction->index,
+            ValueRange(std::max(range.min, (long long)bounds_check_instruction->min), std::min(range.max, (long long)bounds_check_instruction->max))));
+        ++it;
+    }
+
+    for (int i = 0; i < (int)analysis.dominator_children[block_index].size(); i++)
+        eliminate_bounds_checks(analysis.dominator_children[block_index][i], analysis);
+
+    for (int i = 0; i < (int)newly_checked.size(); i++)
+        analysis.checked.erase(newly_checked[i]);
+    for (int i = previously_checked.size() - 1; i >= 0; i--) {
+        analysis.checked.erase(previously_checked[i].first);
+        analysis.checked.insert(previously_checked[i]);
+    }
+}
+
+MethodGenerator::ValueRange MethodGenerator::calculate_value_range(Variant value, int block_index, RangeAnalysis & analysis, int depth) {
+    if (value.type == Variant::CONST_INT)
+        return ValueRange(value._int, value._int);
+    ValueRange range(-unbounded_value, unbounded_value);
+    if (value.type != Variant::REGISTER || depth > max_range_depth)
+        return range;
+    int register_index = value._int;
+
+    // the value never changes in ssa form, so what we know about the operands
+    // here is true of them where they were used too.
+    Instruction * definition = analysis.definitions[register_index];
+    if (definition != NULL && definition->type == Instruction::OPERATOR) {
+        OperatorInstruction * operator_instruction = (OperatorInstruction *) definition;
+        ValueRange left = calculate_value_range(operator_instruction->left, block_index, analysis, depth + 1);
+        ValueRange right = calculate_value_range(operator_instruction->right, block_index, analysis, depth + 1);
+        switch (operator_instruction->_operator) {
+            case OperatorInstruction::PLUS:
+                range = ValueRange(left.min + right.min, left.max + right.max);
+                break;
+            case OperatorInstruction::MINUS:
+                range = ValueRange(left.min - right.max, left.max - right.min);
+                break;
+            case OperatorInstruction::TIMES:
+                if (operator_instruction->right.type == Variant::CONST_INT) {
+                    long long factor = operator_instruction->right._int;
+                    range = factor >= 0 ? ValueRange(left.min * factor, left.max * factor) : ValueRange(left.max * factor, left.min * factor);
+                }
+                break;
+            default:
+                break;
+        }
+        if (range.min < -unbounded_value)
+            range.min = -unbounded_value;
+        if (range.max > unbounded_value)
+            range.max = unbounded_value;
+    } else if (definition != NULL && definition->type == Instruction::PHI) {
+        // a counter only goes one way from where it starts, as long as it can't wrap around
+        PhiInstruction * phi_instruction = (PhiInstruction *) definition;
+        for (int i = 0; i < (int)phi_instruction->sources.size() && phi_instruction->sources.size() == 2; i++) {
+            Variant increment = phi_instruction->sources[i];
+            if (increment.type != Variant::REGISTER || analysis.definitions[increment._int] == NULL ||
+                analysis.definitions[increment._int]->type != Instruction::OPERATOR)
+            {
+                continue;
+            }
+            OperatorInstruction * operator_instruction = (OperatorInstruction *) analysis.definitions[increment._int];
+            if (operator_instruction->left != phi_instruction->dest || operator_instruction->right.type != Variant::CONST_INT)
+                continue;
+            long long step = operator_instruction->right._int;
+            if (operator_instruction->_operator == OperatorInstruction::MINUS)
+                step = -step;
+            else if (operator_instruction->_operator != OperatorInstruction::PLUS)
+                continue;
+            ValueRange start = calculate_value_range(phi_instruction->sources[1 - i], phi_instruction->parents[1 - i], analysis, depth + 1);
+            ValueRange before_increment(-unbounded_value, unbounded_value);
+            apply_branch_conditions(before_increment, register_index, analysis.definition_block[increment._int], analysis, depth + 1);
+            if (step >= 0 && before_increment.max + step <= 2147483647LL)
+                range.min = start.min;
+            else if (step < 0 && before_increment.min + step >= -2147483648LL)
+                range.max = start.max;
+        }
+    }
+
+    apply_branch_conditions(range, register_index, block_index, analysis, depth);
+    return range;
+}
+
+void MethodGenerator::apply_branch_conditions(ValueRange & range, int register_index, int block_index, RangeAnalysis & analysis, int depth) {
+    // every branch on the way down the dominator tree that can only have gone one way to get here
+    for (int child = block_index; analysis.immediate_dominator[child] != -1; child = analysis.immediate_dominator[child]) {
+        BasicBlock * parent_block = m_basic_blocks[analysis.immediate_dominator[child]];
+        if (m_basic_blocks[child]->parents.size() != 1 || parent_block->jump_child == parent_block->fallthrough_child)
+            continue;
+        if (parent_block->instructions.empty() || parent_block->instructions.back()->type != Instruction::IF)
+            continue;
+        IfInstruction * if_instruction = (IfInstruction *) parent_block->instructions.back();
+        // if !condition goto jump_child
+        bool truth = parent_block->fallthrough_child == child;
+        narrow_value_range(range, register_index, if_instruction->condition, truth, block_index, analysis, depth);
+    }
+}
+
+void MethodGenerator::narrow_value_range(ValueRange & range, int register_index, Variant condition, bool truth, int block_index, RangeAnalysis & analysis, int depth) {
+    if (condition.type != Variant::REGISTER || depth > max_range_depth)
+        return;
+    Instruction * definition = analysis.definitions[condition._int];
+    if (definition == NULL)
+        return;
+    if (definition->type == Instruction::UNARY) {
+        UnaryInstruction * unary_instruction = (UnaryInstruction *) definition;
+        if (unary_instruction->_operator == UnaryInstruction::NOT)
+            narrow_value_range(range, register_index, unary_instruction->source, ! truth, block_index, analysis, depth + 1);
+        return;
+    }
+    if (definition->type != Instruction::OPERATOR)
+        return;
+    OperatorInstruction * operator_instruction = (OperatorInstruction *) definition;
+    OperatorInstruction::Operator _operator = operator_instruction->_operator;
+    if ((_operator == OperatorInstruction::AND && truth) || (_operator == OperatorInstruction::OR && ! truth)) {
+        narrow_value_range(range, register_index, operator_instruction->left, truth, block_index, analysis, depth + 1);
+        narrow_value_range(range, register_index, operator_instruction->right, truth, block_index, analysis, depth + 1);
+        return;
+    }
+
+    // put our register on the left
+    Variant other;
+    if (operator_instruction->left == Variant(register_index, Variant::REGISTER)) {
+        other = operator_instruction->right;
+    } else if (operator_instruction->right == Variant(register_index, Variant::REGISTER)) {
+        other = operator_instruction->left;
+        switch (_operator) {
+            case OperatorInstruction::LESS:
+                _operator = OperatorInstruction::GREATER;
+                break;
+            case OperatorInstruction::GREATER:
+                _operator = OperatorInstruction::LESS;
+                break;
+            case OperatorInstruction::LESS_EQUAL:
+                _operator = OperatorInstruction::GREATER_EQUAL;
+                break;
+            case OperatorInstruction::GREATER_EQUAL:
+                _operator = OperatorInstruction::LESS_EQUAL;
+                break;
+            default:
+                break;
+        }
+    } else {
+        return;
+    }
+    if (! truth) {
+        switch (_operator) {
+            case OperatorInstruction::LESS:
+                _operator = OperatorInstruction::GREATER_EQUAL;
+                break;
+            case OperatorInstruction::GREATER_EQUAL:
+                _operator = OperatorInstruction::LESS;
+                break;
+            case OperatorInstruction::GREATER:
+                _operator = OperatorInstruction::LESS_EQUAL;
+                break;
+            case OperatorInstruction::LESS_EQUAL:
+                _operator = OperatorInstruction::GREATER;
+                break;
+            case OperatorInstruction::EQUAL:
+                _operator = OperatorInstruction::NOT_EQUAL;
+                break;
+            case OperatorInstruction::NOT_EQUAL:
+                _operator = OperatorInstruction::EQUAL;
+                break;
+            default:
+                return;
+        }
+    }
+
+    ValueRange other_range = calculate_value_range(other, block_index, analysis, depth + 1);
+    switch (_operator) {
+        case OperatorInstruction::LESS:
+            range.max = std::min(range.max, other_range.max - 1);
+            break;
+        case OperatorInstruction::LESS_EQUAL:
+            range.max = std::min(range.max, other_range.max);
+            break;
+        case OperatorInstruction::GREATER:
+            range.min = std::max(range.min, other_range.min + 1);
+            break;
+        case OperatorInstruction::GREATER_EQUAL:
+            range.min = std::max(range.min, other_range.min);
+            break;
+        case OperatorInstruction::EQUAL:
+            range.min = std::max(range.min, other_range.min);
+            range.max = std::min(range.max, other_range.max);
+            break;
+        default:
+            break;
+    }
+}
+
+void MethodGenerator::induction_variable_strength_reduction() {
+    ControlFlow & flow = control_flow();
+    std::vector<Loop> & loops = flow.loops;
+    std::vector<int> & reverse_postorder = flow.reverse_postorder;
+
+    // inner loops first, so that the outer loop can reduce what they leave in front of themselves
+    std::vector<std::pair<int, int> > order;
+    for (int i = 0; i < (int)loops.size(); i++)
+        order.push_back(std::pair<int, int>(loops[i].blocks.size(), i));
+    std::sort(order.begin(), order.end());
+    for (int i = 0; i < (int)order.size() && ! over_budget(); i++) {
+        m_work += instruction_count();
+        reduce_induction_variables(loops[order[i].second], reverse_postorder);
+    }
+
+    remove_dead_ssa_code();
+}
+
+MethodGenerator::Variant MethodGenerator::insert_preheader_operation(BasicBlock * block, Variant left, OperatorInstruction::Operator _operator, Variant right, RegisterType type) {
+    if (left.type == Variant::CONST_INT && right.type == Variant::CONST_INT) {
+        switch (_operator) {
+            case OperatorInstruction::PLUS:
+                return Variant(left._int + right._int, Variant::CONST_INT);
+            case OperatorInstruction::MINUS:
+                return Variant(left._int - right._int, Variant::CONST_INT);
+            case OperatorInstruction::TIMES:
+                return Variant(left._int * right._int, Variant::CONST_INT);
+            default:
+                assert(false);
+        }
+    }
+    if (left.type == Variant::CONST_INT && _operator != OperatorInstruction::MINUS) {
+        // constants go on the right
+        Variant tmp = left;
+        left = right;
+        right = tmp;
+    }
+    if (right.type == Variant::CONST_INT && right._int == 0 && _operator != OperatorInstruction::TIMES)
+        return left;
+    if (right.type == Variant::CONST_INT && right._int == 1 && _operator == OperatorInstruction::TIMES)
+        return left;
+    if (left.type == Variant::REGISTER && right.type == Variant::CONST_INT &&
+        (_operator == OperatorInstruction::PLUS || _operator == OperatorInstruction::MINUS)) {
+        // (x + a) + b is x + (a + b)
+        int amount = _operator == OperatorInstruction::PLUS ? right._int : -right._int;
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+            if ((*it)->type != Instruction::OPERATOR)
+                continue;
+            OperatorInstruction * operator_instruction = (OperatorInstruction *) *it;
+            if (operator_instruction->dest == left && operator_instruction->_operator == OperatorInstruction::PLUS &&
+                operator_instruction->right.type == Variant::CONST_INT) {
+                return insert_preheader_operation(block, operator_instruction->left, OperatorInstruction::PLUS,
+                    Variant(operator_instruction->right._int + amount, Variant::CONST_INT), type);
+            }
+        }
+    }
+
+    // before the jump, if there is one
+    InstructionList::iterator position = block->instructions.end();
+    if (! block->instructions.empty()) {
+        Instruction::Type last_type = block->instructions.back()->type;
+        if (last_type == Instruction::IF || last_type == Instruction::GOTO)
+            --position;
+    }
+    Variant dest = next_available_register(type);
+    block->instructions.insert(position, new (m_instruction_arena) OperatorInstruction(dest, left, _operator, right));
+    return dest;
+}
+
+void MethodGenerator::reduce_induction_variables(Loop & loop, std::vector<int> & reverse_postorder) {
+    BasicBlock * header_block = m_basic_blocks[loop.header];
+
+    // new code has to go in the one block that enters the loop
+    int preheader = -1;
+    for (std::set<int>::iterator it = header_block->parents.begin(); it != header_block->parents.end(); ++it) {
+        if (loop.blocks.count(*it))
+            continue;
+        if (preheader != -1)
+            return;
+        preheader = *it;
+    }
+    if (preheader == -1)
+        return;
+    BasicBlock * preheader_block = m_basic_blocks[preheader];
+
+    std::map<int, Instruction *> definitions;
+    std::map<int, int> definition_block;
+    for (std::set<int>::iterator it = loop.blocks.begin(); it != loop.blocks.end(); ++it) {
+        BasicBlock * block = m_basic_blocks[*it];
+        for (InstructionList::iterator instruction_it = block->instructions.begin(); instruction_it != block->instructions.end(); ++instruction_it) {
+            std::set<int> mangled;
+            (*instruction_it)->insertMangledRegisters(mangled);
+            for (std::set<int>::iterator mangled_it = mangled.begin(); mangled_it != mangled.end(); ++mangled_it) {
+                definitions[*mangled_it] = *instruction_it;
+                definition_block[*mangled_it] = *it;
+            }
+        }
+    }
+
+    // basic induction variables: i = phi(preheader: start, latch: i + step)
+    std::map<int, InductionVariable> induction_variables;
+    std::map<int, Variant> basic_start;
+    std::map<int, int> basic_step;
+    std::map<int, int> basic_latch;
+    std::map<int, int> basic_increment; // register holding i + step
+    for (InstructionList::iterator it = header_block->instructions.begin(); it != header_block->instructions.end() && (*it)->type == Instruction::PHI; ++it) {
+        PhiInstruction * phi_instruction = (PhiInstruction *) *it;
+        int basic = phi_instruction->dest._int;
+        if (m_register_type[basic] != INTEGER || phi_instruction->sources.size() != 2)
+            continue;
+        int outside = phi_instruction->parents[0] == preheader ? 0 : 1;
+        Variant increment = phi_instruction->sources[1 - outside];
+        if (phi_instruction->parents[outside] != preheader || increment.type != Variant::REGISTER || ! definitions.count(increment._int))
+            continue;
+        if (definitions[increment._int]->type != Instruction::OPERATOR)
+            continue;
+        OperatorInstruction * operator_instruction = (OperatorInstruction *) definitions[increment._int];
+        if (operator_instruction->left != phi_instruction->dest || operator_instruction->right.type != Variant::CONST_INT)
+            continue;
+        if (operator_instruction->_operator == OperatorInstruction::PLUS)
+            basic_step[basic] = operator_instruction->right._int;
+        else if (operator_instruction->_operator == OperatorInstruction::MINUS)
+            basic_step[basic] = -operator_instruction->right._int;
+        else
+            continue;
+        basic_start[basic] = phi_instruction->sources[outside];
+        basic_latch[basic] = phi_instruction->parents[1 - outside];
+        basic_increment[basic] = increment._int;
+        induction_variables[basic] = InductionVariable(basic, 1, Variant(0, Variant::CONST_INT));
+    }
+    if (induction_variables.empty())
+        return;
+
+    // derived induction variables, in an order where operands come before their uses
+    std::vector<int> derived;
+    for (int i = 0; i < (int)reverse_postorder.size(); i++) {
+        if (! loop.blocks.count(reverse_postorder[i]))
+            continue;
+        BasicBlock * block = m_basic_blocks[reverse_postorder[i]];
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+            if ((*it)->type != Instruction::OPERATOR)
+                continue;
+            OperatorInstruction * operator_instruction = (OperatorInstruction *) *it;
+            int dest = operator_instruction->dest._int;
+            if (m_register_type[dest] != INTEGER && m_register_type[dest] != POINTER)
+                continue;
+            Variant left = operator_instruction->left;
+            Variant right = operator_instruction->right;
+            bool left_variable = left.type == Variant::REGISTER && induction_variables.count(left._int);
+            bool right_variable = right.type == Variant::REGISTER && induction_variables.count(right._int);
+            if (left_variable == right_variable)
+                continue;
+            Variant other = left_variable ? right : left;
+            if (other.type == Variant::REGISTER && (definitions.count(other._int) || (m_register_type[other._int] != INTEGER && m_register_type[other._int] != POINTER)))
+                continue; // changes inside the loop
+            if (other.type != Variant::REGISTER && other.type != Variant::CONST_INT)
+                continue;
+            InductionVariable variable = induction_variables[left_variable ? left._int : right._int];
+            RegisterType type = m_register_type[dest];
+            switch (operator_instruction->_operator) {
+                case OperatorInstruction::PLUS:
+                    variable.offset = insert_preheader_operation(preheader_block, variable.offset, OperatorInstruction::PLUS, other, type);
+                    break;
+                case OperatorInstruction::MINUS:
+                    if (left_variable) {
+                        variable.offset = insert_preheader_operation(preheader_block, variable.offset, OperatorInstruction::MINUS, other, type);
+                    } else {
+                        if (variable.scale == -2147483647 - 1)
+                            continue;
+                        variable.offset = insert_preheader_operation(preheader_block, other, OperatorInstruction::MINUS, variable.offset, type);
+                        variable.scale = -variable.scale;
+                    }
+                    break;
+                case OperatorInstruction::TIMES:
+                {
+                    if (other.type != Variant::CONST_INT)
+                        continue;
+                    // the scale has to be the real one for the test replacement below
+                    long long scale = (long long)variable.scale * other._int;
+                    if (scale < -2147483648LL || scale > 2147483647LL)
+                        continue;
+                    variable.offset = insert_preheader_operation(preheader_block, variable.offset, OperatorInstruction::TIMES, other, type);
+                    variable.scale = scale;
+                    break;
+                }
+                default:
+                    continue;
+            }
+            induction_variables[dest] = variable;
+            derived.push_back(dest);
+        }
+    }
+
+    // only worth a phi of its own if it saves a multiplication
+    std::vector<int> reduced;
+    for (int i = 0; i < (int)derived.size(); i++) {
+        int dest = derived[i];
+        InductionVariable & variable = induction_variables[dest];
+        if (variable.scale == 1 || variable.scale == 0)
+            continue;
+        RegisterType type = m_register_type[dest];
+
+        // start at scale * start + offset
+        Variant start = insert_preheader_operation(preheader_block, basic_start[variable.basic], OperatorInstruction::TIMES,
+            Variant(variable.scale, Variant::CONST_INT), INTEGER);
+        if (variable.offset.type == Variant::REGISTER && m_register_type[variable.offset._int] == POINTER)
+            start = insert_preheader_operation(preheader_block, variable.offset, OperatorInstruction::PLUS, start, type);
+        else
+            start = insert_preheader_operation(preheader_block, start, OperatorInstruction::PLUS, variable.offset, type);
+
+        // and go up by scale * step when the counter does
+        Variant phi_dest = next_available_register(type);
+        Variant next = next_available_register(type);
+        PhiInstruction * phi_instruction = new (m_instruction_arena) PhiInstruction(phi_dest);
+        phi_instruction->parents.push_back(preheader);
+        phi_instruction->sources.push_back(start);
+        phi_instruction->parents.push_back(basic_latch[variable.basic]);
+        phi_instruction->sources.push_back(next);
+        InstructionList::iterator it = header_block->instructions.begin();
+        while (it != header_block->instructions.end() && (*it)->type == Instruction::PHI)
+            ++it;
+        header_block->instructions.insert(it, phi_instruction);
+
+        int increment = basic_increment[variable.basic];
+        BasicBlock * increment_block = m_basic_blocks[definition_block[increment]];
+        it = std::find(increment_block->instructions.begin(), increment_block->instructions.end(), definitions[increment]);
+        assert(it != increment_block->instructions.end());
+        ++it;
+        increment_block->instructions.insert(it, new (m_instruction_arena) OperatorInstruction(next, phi_dest, OperatorInstruction::PLUS,
+            Variant(variable.scale * basic_step[variable.basic], Variant::CONST_INT)));
+
+        // the old calculation is just a copy now
+        BasicBlock * block = m_basic_blocks[definition_block[dest]];
+        it = std::find(block->instructions.begin(), block->instructions.end(), definitions[dest]);
+        assert(it != block->instructions.end());
+        delete *it;
+        *it = new (m_instruction_arena) CopyInstruction(Variant(dest, Variant::REGISTER), phi_dest);
+        definitions[dest] = *it;
+        variable.reduced = phi_dest._int;
+        reduced.push_back(dest);
+    }
+
+    // registers used by something other than another induction variable
+    std::set<int> used;
+    for (int i = 0; i < (int)m_basic_blocks.size(); i++) {
+        BasicBlock * block = m_basic_blocks[i];
+        if (block->deleted)
+            continue;
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+            if ((*it)->type == Instruction::OPERATOR && induction_variables.count(((OperatorInstruction *) *it)->dest._int))
+                continue;
+            (*it)->insertReadRegisters(used);
+        }
+    }
+
+    // linear function test replacement. if the counter is compared against something that
+    // doesn't change, compare a reduced variable that is used anyway against its value there.
+    // only where neither side can wrap around, or the comparison could come out the other way.
+    RangeAnalysis analysis;
+    bool have_analysis = false;
+    for (std::map<int, int>::iterator basic_it = basic_step.begin(); basic_it != basic_step.end(); ++basic_it) {
+        int basic = basic_it->first;
+        int replacement = -1;
+        for (int i = 0; i < (int)reduced.size() && replacement == -1; i++) {
+            InductionVariable & variable = induction_variables[reduced[i]];
+            if (variable.basic == basic && variable.scale > 0 && used.count(reduced[i]))
+                replacement = reduced[i];
+        }
+        if (replacement == -1)
+            continue;
+        InductionVariable & variable = induction_variables[replacement];
+
+        if (! have_analysis) {
+            calculate_range_analysis(analysis);
+            have_analysis = true;
+        }
+        // the counter is either where it starts or one step past where it was when it went up
+        int step = basic_it->second;
+        ValueRange start = calculate_value_range(basic_start[basic], preheader, analysis, 0);
+        ValueRange before_increment = calculate_value_range(Variant(basic, Variant::REGISTER), definition_block[basic_increment[basic]], analysis, 0);
+        ValueRange counter_range(std::min(start.min, before_increment.min + step), std::max(start.max, before_increment.max + step));
+        ValueRange offset_range = calculate_value_range(variable.offset, preheader, analysis, 0);
+        if (! scaled_range_fits(counter_range, variable.scale, offset_range))
+            continue;
+
+        for (std::set<int>::iterator block_it = loop.blocks.begin(); block_it != loop.blocks.end(); ++block_it) {
+            BasicBlock * block = m_basic_blocks[*block_it];
+            for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
+                if ((*it)->type != Instruction::OPERATOR)
+                    continue;
+                OperatorInstruction * operator_instruction = (OperatorInstruction *) *it;
+                if (operator_instruction->_operator > OperatorInstruction::GREATER_EQUAL)
+                    continue; // not a comparison
+                Variant * counter = NULL;
+                Variant * limit = NULL;
+                if (operator_instruction->left == Variant(basic, Variant::REGISTER)) {
+                    counter = &operator_instruction->left;
+                    limit = &operator_instruction->right;
+                } else if (operator_instruction->right == Variant(basic, Variant::REGISTER)) {
+                    counter = &operator_instruction->right;
+                    limit = &operator_instruction->left;
+                } else {
+                    continue;
+                }
+                if (limit->type == Variant::REGISTER && (definitions.count(limit->_int) || m_register_type[limit->_int] != INTEGER))
+                    continue;
+                if (limit->type != Variant::REGISTER && limit->type != Variant::CONST_INT)
+                    continue;
+                if (! scaled_range_fits(calculate_value_range(*limit, *block_it, analysis, 0), variable.scale, offset_range))
+                    continue;
+                Variant scaled_limit = insert_preheader_operation(preheader_block, *limit, OperatorInstruction::TIMES,
+                    Variant(variable.scale, Variant::CONST_INT), INTEGER);
+                if (variable.offset.type == Variant::REGISTER && m_register_type[variable.offset._int] == POINTER)
+                    *limit = insert_preheader_operation(preheader_block, variable.offset, OperatorInstruction::PLUS, scaled_limit, POINTER);
+                else
+                    *limit = insert_preheader_operation(preheader_block, scaled_limit, OperatorInstruction::PLUS, variable.offset, m_register_type[replacement]);
+                *counter = Variant(variable.reduced, Variant::REGISTER);
             }
         }
-
     }
+}
 
-    if (m_function_declaration->type != NULL) {
-        // mark the return value as required
-        m_basic_blocks[m_basic_blocks.size() - 1]->used_registers.insert(m_variable_numbers.get(m_function_declaration->identifier->text)._int);
-    }
-    for (int i = m_basic_blocks.size() - 1; i >= 0; --i) {
+void MethodGenerator::remove_dead_ssa_code() {
+    // anything that does something other than compute a register is needed,
+    // and so is everything it reads from, and everything they read from...
+    std::vector<Instruction *> definition(m_register_count, (Instruction *) NULL);
+    std::set<Instruction *> needed;
+    std::vector<Instruction *> stack;
+    for (int i = 0; i < (int)m_basic_blocks.size(); i++) {
         BasicBlock * block = m_basic_blocks[i];
-
-        if (block->jump_child != -1) {
-            BasicBlock * child = m_basic_blocks[block->jump_child];
-            block->used_registers.insert(child->used_registers.begin(), child->used_registers.end());
-        }
-        if (block->fallthrough_child != -1) {
-            BasicBlock * child = m_basic_blocks[block->fallthrough_child];
-            block->used_registers.insert(child->used_registers.begin(), child->used_registers.end());
-        }
-
-        InstructionList::iterator it = block->instructions.end();
-        while (it != block->instructions.begin()) {
-            --it;
+        if (block->deleted)
+            continue;
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end(); ++it) {
             Instruction * instruction = *it;
             switch (instruction->type) {
                 case Instruction::COPY:
+                case Instruction::OPERATOR:
+                case Instruction::UNARY:
+                case Instruction::PHI:
                 {
-                    CopyInstruction * copy_instruction = (CopyInstruction *) instruction;
-
-                    int dest_register = copy_instruction->dest._int;
-
-                    // see if instruction is unecessary
-                    if (copy_instruction->source.type == Variant::REGISTER && copy_instruction->source._int == dest_register) {
-                        bool beg = (block->instructions.begin() == it);
-                        block->instructions.erase(it);
-                        if (beg)
-                            it = block->instructions.begin();
-
-                        delete instruction;
-                        instruction = NULL;
-                        break;
-                    } else if (! block->used_registers.count(dest_register)) {
-                        // delete because nothing depends on it
-                        bool beg = (block->instructions.begin() == it);
-                        block->instructions.erase(it);
-                        if (beg)
-                            it = block->instructions.begin();
-
-                        delete instruction;
-                        instruction = NULL;
-                    } else {
-                        // add the source to used set
-                        copy_instruction->insertReadRegisters(block->used_registers);
-                    }
-
-                    // delete dest from used set
-                    block->used_registers.erase(dest_register);
-
+                    std::set<int> mangled;
+                    instruction->insertMangledRegisters(mangled);
+                    for (std::set<int>::iterator mangled_it = mangled.begin(); mangled_it != mangled.end(); ++mangled_it)
+                        definition[*mangled_it] = instruction;
                     break;
                 }
-                case Instruction::OPERATOR:
-                {
-                    OperatorInstruction * operator_instruction = (OperatorInstruction *) instruction;
+                default:
+                    needed.insert(instruction);
+                    stack.push_back(instruction);
+                    break;
+            }
+        }
+    }
+    while (! stack.empty()) {
+        Instruction * instruction = stack.back();
+        stack.pop_back();
+        std::set<int> read;
+        instruction->insertReadRegisters(read);
+        for (std::set<int>::iterator it = read.begin(); it != read.end(); ++it) {
+            Instruction * source = definition[*it];
+            if (source != NULL && needed.insert(source).second)
+                stack.push_back(source);
+        }
+    }
 
-                    int dest_register = operator_instruction->dest._int;
+    for (int i = 0; i < (int)m_basic_blocks.size(); i++) {
+        BasicBlock * block = m_basic_blocks[i];
+        if (block->deleted)
+            continue;
+        InstructionList::iterator it = block->instructions.begin();
+        while (it != block->instructions.end()) {
+            if (needed.count(*it)) {
+                ++it;
+                continue;
+            }
+            delete *it;
+            it = block->instructions.erase(it);
+        }
+    }
+}
 
-                    // see if this is unecessary
-                    if (! block->used_registers.count(dest_register)) {
-                        bool beg = (block->instructions.begin() == it);
-                        block->instructions.erase(it);
-                        if (beg)
-                            it = block->instructions.begin();
+void MethodGenerator::global_value_numbering() {
+    ControlFlow & flow = control_flow();
+    std::vector<int> & reverse_postorder = flow.reverse_postorder;
+
+    // registers that are never assigned hold whatever they came in with, each its own value
+    ValueNumbers values;
+    values.register_value.assign(m_register_count, -1);
+    std::set<int> assigned;
+    insert_assigned_registers(assigned);
+    for (int i = 0; i < m_register_count; i++) {
+        if (! assigned.count(i))
+            values.register_value[i] = next_value_number(values, Variant(i, Variant::REGISTER));
+    }
 
-                        delete instruction;
-                        instruction = NULL;
-                    } else {
-                        // add the operands to used set
-                        operator_instruction->insertReadRegisters(block->used_registers);
-                    }
+    value_number_block(reverse_postorder[0], flow.dominator_children, values);
 
-                    // delete dest from used set
-                    block->used_registers.erase(dest_register);
+    // phis read from the ends of their parents, which might have come after them
+    for (int i = 0; i < (int)reverse_postorder.size(); i++) {
+        BasicBlock * block = m_basic_blocks[reverse_postorder[i]];
+        for (InstructionList::iterator it = block->instructions.begin(); it != block->instructions.end() && (*it)->type == Instruction::PHI; ++it) {
+            PhiInstruction * phi_instruction = (PhiInstruction *) *it;
+            for (int j = 0; j < (int)phi_instruction->sources.size(); j++)
+                phi_instruction->sources[j] = get_leader(values, phi_instruction->sources[j]);
+        }
+    }
+}
 
+void MethodGenerator::value_number_block(int block_index, std::vector<std::vector<int> > & dominator_children, ValueNumbers & values) {
+    BasicBlock * block = m_basic_blocks[block_index];
+    // expressions we make available to the blocks we dominate, and only to them
+    std::vector<ValueExpression> available;
 
-                    break;
+    InstructionList::iterator it = block->instructions.begin();
+    while (it != block->instructions.end()) {
+        Instruction * instruction = *it;
+        switch (instruction->type) {
+            case Instruction::PHI:
+            {
+                // if every way in brings the same value, we don't need the phi
+                PhiInstruction * phi_instruction = (PhiInstruction *) instruction;
+                Variant same;
+                bool all_same = true;
+                bool have_one = false;
+                for (int i = 0; i < (int)phi_instruction->sources.size() && all_same; i++) {
+                    Variant source = phi_instruction->sources[i];
+                    if (source == phi_instruction->dest)
+                        continue; // around a loop that doesn't change it
+                    if (source.type == Variant::REGISTER && values.register_value[source._int] == -1) {
+                        all_same = false; // comes from further down. could be anything.
+                        break;
+                    }
+                    source = get_leader(values, source);
+                    if (! have_one) {
+                        same = source;
+                        have_one = true;
+                    } else if (source != same) {
+                        all_same = false;
+                    }
                 }
-                case Instruction::UNARY:
-                {
-                    UnaryInstruction * unary_instruction = (UnaryInstruction *) instruction;
-
-
-                    int dest_register = unary_instruction->dest._int;
+                if (all_same && have_one) {
+                    values.register_value[phi_instruction->dest._int] = get_value_number(values, same);
+                    it = block->instructions.erase(it);
+                    delete phi_instruction;
+                    continue;
+                }
+                values.register_value[phi_instruction->dest._int] = next_value_number(values, phi_instruction->dest);
+                break;
+            }
+            case Instruction::COPY:
+            {
+                // uses of the dest get the source instead, so the copy can go
+                CopyInstruction * copy_instruction = (CopyInstruction *) instruction;
+                copy_instruction->source = get_leader(values, copy_instruction->source);
+                values.register_value[copy_instruction->dest._int] = get_value_number(values, copy_instruction->source);
+                it = block->instructions.erase(it);
+                delete copy_instruction;
+                continue;
+            }
+            case Instruction::OPERATOR:
+            {
+                OperatorInstruction * operator_instruction = (OperatorInstruction *) instruction;
+                operator_instruction->left = get_leader(values, operator_instruction->left);
+                operator_instruction->right = get_leader(values, operator_instruction->right);
 
-                    // see if this is unecessary
-                    if (! block->used_registers.count(dest_register)) {
-                        bool beg = (block->instructions.begin() == it);
-                        block->instructions.erase(it);
-                        if (beg)
-                            it = block->instructions.begin();
+                CopyInstruction * copy_instruction = constant_expression_evaluated(operator_instruction);
+                if (copy_instruction != NULL) {
+                    // look at it again as a copy
+                    *it = copy_instruction;
+                    continue;
+                }
 
-                        delete instruction;
-                        instruction = NULL;
-                    } else {
-                        // add the source to used set
-                        unary_instruction->insertReadRegisters(block->used_registers);
+                // normalize parameter order
+                // constant on the right and lower value number first
+                bool swap = false;
+                if (operator_instruction->left.type != Variant::REGISTER) {
+                    // left is constant, swap
+                    swap = true;
+                } else if (operator_instruction->right.type == Variant::REGISTER) {
+                    // right is not constant. order by lower value number first
+                    swap = get_value_number(values, operator_instruction->left) > get_value_number(values, operator_instruction->right);
+                }
+                switch (operator_instruction->_operator) {
+                    case OperatorInstruction::MINUS:
+                    case OperatorInstruction::DIVIDE:
+                    case OperatorInstruction::MOD:
+                        swap = false;
+                    default:
+                        break;
+                }
+                if (swap) {
+                    Variant tmp = operator_instruction->left;
+                    operator_instruction->left = operator_instruction->right;
+                    operator_instruction->right = tmp;
+                    // a < b is b > a
+                    switch (operator_instruction->_operator) {
+                        case OperatorInstruction::LESS:
+                            operator_instruction->_operator = OperatorInstruction::GREATER;
+                            break;
+                        case OperatorInstruction::GREATER:
+                            operator_instruction->_operator = OperatorInstruction::LESS;
+                            break;
+                        case OperatorInstruction::LESS_EQUAL:
+                            operator_instruction->_operator = OperatorInstruction::GREATER_EQUAL;
+                            break;
+                        case OperatorInstruction::GREATER_EQUAL:
+                            operator_instruction->_operator = OperatorInstruction::LESS_EQUAL;
+                            break;
+                        default:
+                            break;
                     }
-
-                    // delete dest from used set
-                    block->used_registers.erase(dest_register);
-
-
-                    break;
                 }
-                case Instruction::PRINT:
-                {
-                    PrintInstruction * print_instruction = (PrintInstruction *) instruction;
-                    print_instruction->insertReadRegisters(block->used_registers);
-                    break;
+
+                Instruction * folded_instruction = constant_folded(operator_instruction);
+                if (folded_instruction != operator_instruction) {
+                    *it = folded_instruction;
+                    continue;
                 }
-                case Instruction::IF:
-                {
-                    IfInstruction * if_instruction = (IfInstruction *) instruction;
-                    if_instruction->insertReadRegisters(block->used_registers);
-                    break;
+
+                // replace operator instruction with a copy instruction if we can
+                ValueExpression expression(Instruction::OPERATOR, operator_instruction->_operator,
+                    get_value_number(values, operator_instruction->left), get_value_number(values, operator_instruction->right));
+                int found = values.expression_value.find(expression);
+                if (found != -1) {
+                    *it = new (m_instruction_arena) CopyInstruction(operator_instruction->dest, values.leader[found]);
+                    delete operator_instruction;
+                    continue;
                 }
-                case Instruction::GOTO:
-                    break;
-                case Instruction::RETURN:
-                    break;
-                case Instruction::NON_VOID_METHOD_CALL:
-                case Instruction::METHOD_CALL:
-                {
-                    MethodCallInstruction * method_call_instruction = (MethodCallInstruction *) instruction;
-                    method_call_instruction->insertReadRegisters(block->used_registers);
-                    break;
+                values.register_value[operator_instruction->dest._int] = next_value_number(values, operator_instruction->dest);
+                values.expression_value.insert(expression, values.register_value[operator_instruction->dest._int]);
+                available.push_back(expression);
+                break;
+            }
+            case Instruction::UNARY:
+            {
+                UnaryInstruction * unary_instruction = (UnaryInstruction *) instruction;
+                unary_instruction->source = get_leader(values, unary_instruction->source);
+
+                CopyInstruction * copy_instruction = constant_expression_evaluated(unary_instruction);
+                if (copy_instruction != NULL) {
+                    *it = copy_instruction;
+                    continue;
                 }
-                case Instruction::ALLOCATE_OBJECT:
-                    break;
-                case Instruction::ALLOCATE_ARRAY:
-                    break;
-                case Instruction::WRITE_POINTER:
-                {
-                    WritePointerInstruction * write_pointer_instruction = (WritePointerInstruction *) instruction;
-                    write_pointer_instruction->insertReadRegisters(block->used_registers);
-                    break;
+
+                ValueExpression expression(Instruction::UNARY, unary_instruction->_operator, get_value_number(values, unary_instruction->source), -1);
+                int found = values.expression_value.find(expression);
+                if (found != -1) {
+                    *it = new (m_instruction_arena) CopyInstruction(unary_instruction->dest, values.leader[found]);
+                    delete unary_instruction;
+                    continue;
                 }
-                case Instruction::READ_POINTER:
-                {
-                    ReadPointerInstruction * read_pointer_instruction = (ReadPointerInstruction *) instruction;
-                    read_pointer_instruction->insertReadRegisters(block->used_registers);
-                    break;
+                values.register_value[unary_instruction->dest._int] = next_value_number(values, unary_instruction->dest);
+                values.expression_value.insert(expression, values.register_value[unary_instruction->dest._int]);
+                available.push_back(expression);
+                break;
+            }
+            case Instruction::IF:
+            {
+                IfInstruction * if_instruction = (IfInstruction *) instruction;
+                if_instruction->condition = get_leader(values, if_instruction->condition);
+                break;
+            }
+            case Instruction::GOTO:
+                break;
+            case Instruction::RETURN:
+            {
+                ReturnInstruction * return_instruction = (ReturnInstruction *) instruction;
+                if (return_instruction->has_value)
+                    return_instruction->value = get_leader(values, return_instruction->value);
+                break;
+            }
+            case Instruction::PRINT:
+            {
+                PrintInstruction * print_instruction = (PrintInstruction *) instruction;
+                print_instruction->value = get_leader(values, print_instruction->value);
+                break;
+            }
+            case Instruction::NON_VOID_METHOD_CALL:
+            case Instruction::METHOD_CALL:
+            {
+                MethodCallInstruction * method_call_instruction = (MethodCallInstruction *) instruction;
+                for (int i = 0; i < (int)method_call_instruction->parameters.size(); i++)
+                    method_call_instruction->parameters[i] = get_leader(values, method_call_instruction->parameters[i]);
+                // leave result value as unknown
+                if (instruction->type == Instruction::NON_VOID_METHOD_CALL) {
+                    NonVoidMethodCallInstruction * non_void_instruction = (NonVoidMethodCallInstruction *) instruction;
+                    values.register_value[non_void_instruction->dest._int] = next_value_number(values, non_void_instruction->dest);
                 }
+                break;
+            }
+            case Instruction::ALLOCATE_OBJECT:
+            {
+                AllocateObjectInstruction * allocate_instruction = (AllocateObjectInstruction *) instruction;
+                values.register_value[allocate_instruction->dest._int] = next_value_number(values, allocate_instruction->dest);
+                break;
+            }
+            case Instruction::ALLOCATE_ARRAY:
+            {
+                AllocateArrayInstruction * allocate_instruction = (AllocateArrayInstruction *) instruction;
+                values.register_value[allocate_instruction->dest._int] = next_value_number(values, allocate_instruction->dest);
+                break;
+            }
+            case Instruction::WRITE_POINTER:
+            {
+                WritePointerInstruction * write_pointer_instruction = (WritePointerInstruction *) instruction;
+                write_pointer_instruction->source = get_leader(values, write_pointer_instruction->source);
+                write_pointer_instruction->pointer = get_leader(values, write_pointer_instruction->pointer);
+                break;
+            }
+            case Instruction::READ_POINTER:
+            {
+                // memory can change between reads, so every read is a new value
+                ReadPointerInstruction * read_pointer_instruction = (ReadPointerInstruction *) instruction;
+                read_pointer_instruction->source_pointer = get_leader(values, read_pointer_instruction->source_pointer);
+                values.register_value[read_pointer_instruction->dest._int] = next_value_number(values, read_pointer_instruction->dest);
+                break;
+            }
+            case Instruction::BOUNDS_CHECK:
+            {
+                BoundsCheckInstruction * bounds_check_instruction = (BoundsCheckInstruction *) instruction;
+                bounds_check_instruction->index = get_leader(values, bounds_check_instruction->index);
+                break;
             }
         }
+        ++it;
     }
 
+    for (int i = 0; i < (int)dominator_children[block_index].size(); i++)
+        value_number_block(dominator_children[block_index][i], dominator_children, values);
+
+    for (int i = 0; i < (int)available.size(); i++)
+        values.expression_value.erase(available[i]);
 }
 
-MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluated(BasicBlock * block, UnaryInstruction * instruction) {
+MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluated(UnaryInstruction * instruction) {
     if (instruction->source.type == Variant::REGISTER)
         return NULL;
     switch (instruction->_operator) {
         case UnaryInstruction::NEGATE:
             switch (instruction->source.type) {
                 case Variant::CONST_INT:
-                    return make_immediate(block, instruction, -instruction->source._int);
+                    return make_immediate(instruction, -instruction->source._int);
                 case Variant::CONST_REAL:
-                    return make_immediate(block, instruction, -instruction->source._float);
+                    return make_immediate(instruction, -instruction->source._float);
                 default:
                     assert(false);
             }
@@ -2184,7 +6022,7 @@ MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluate
         case UnaryInstruction::NOT:
             switch (instruction->source.type) {
                 case Variant::CONST_BOOL:
-                    return make_immediate(block, instruction, !instruction->source._bool);
+                    return make_immediate(instruction, !instruction->source._bool);
                 default:
                     assert(false);
             }
@@ -2194,7 +6032,7 @@ MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluate
 }
 
 
-MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluated(BasicBlock * block, OperatorInstruction * instruction) {
+MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluated(OperatorInstruction * instruction) {
     if (instruction->left.type == Variant::REGISTER || instruction->right.type == Variant::REGISTER)
         return NULL;
 
@@ -2204,11 +6042,11 @@ MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluate
         case OperatorInstruction::EQUAL:
             switch (instruction->left.type) {
                 case Variant::CONST_BOOL:
-                    return make_immediate(block, instruction, instruction->left._bool == instruction->right._bool);
+                    return make_immediate(instruction, instruction->left._bool == instruction->right._bool);
                 case Variant::CONST_INT:
-                    return make_immediate(block, instruction, instruction->left._int == instruction->right._int);
+                    return make_immediate(instruction, instruction->left._int == instruction->right._int);
                 case Variant::CONST_REAL:
-                    return make_immediate(block, instruction, instruction->left._float == instruction->right._float);
+                    return make_immediate(instruction, instruction->left._float == instruction->right._float);
                 default:
                     assert(false);
             }
@@ -2216,11 +6054,11 @@ MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluate
         case OperatorInstruction::NOT_EQUAL:
             switch (instruction->left.type) {
                 case Variant::CONST_BOOL:
-                    return make_immediate(block, instruction, instruction->left._bool != instruction->right._bool);
+                    return make_immediate(instruction, instruction->left._bool != instruction->right._bool);
                 case Variant::CONST_INT:
-                    return make_immediate(block, instruction, instruction->left._int != instruction->right._int);
+                    return make_immediate(instruction, instruction->left._int != instruction->right._int);
                 case Variant::CONST_REAL:
-                    return make_immediate(block, instruction, instruction->left._float != instruction->right._float);
+                    return make_immediate(instruction, instruction->left._float != instruction->right._float);
                 default:
                     assert(false);
             }
@@ -2228,9 +6066,9 @@ MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluate
         case OperatorInstruction::LESS:
             switch (instruction->left.type) {
                 case Variant::CONST_INT:
-                    return make_immediate(block, instruction, instruction->left._int < instruction->right._int);
+                    return make_immediate(instruction, instruction->left._int < instruction->right._int);
                 case Variant::CONST_REAL:
-                    return make_immediate(block, instruction, instruction->left._float < instruction->right._float);
+                    return make_immediate(instruction, instruction->left._float < instruction->right._float);
                 default:
                     assert(false);
             }
@@ -2238,9 +6076,9 @@ MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluate
         case OperatorInstruction::GREATER:
             switch (instruction->left.type) {
                 case Variant::CONST_INT:
-                    return make_immediate(block, instruction, instruction->left._int > instruction->right._int);
+                    return make_immediate(instruction, instruction->left._int > instruction->right._int);
                 case Variant::CONST_REAL:
-                    return make_immediate(block, instruction, instruction->left._float > instruction->right._float);
+                    return make_immediate(instruction, instruction->left._float > instruction->right._float);
                 default:
                     assert(false);
             }
@@ -2248,9 +6086,9 @@ MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluate
         case OperatorInstruction::LESS_EQUAL:
             switch (instruction->left.type) {
                 case Variant::CONST_INT:
-                    return make_immediate(block, instruction, instruction->left._int <= instruction->right._int);
+                    return make_immediate(instruction, instruction->left._int <= instruction->right._int);
                 case Variant::CONST_REAL:
-                    return make_immediate(block, instruction, instruction->left._float <= instruction->right._float);
+                    return make_immediate(instruction, instruction->left._float <= instruction->right._float);
                 default:
                     assert(false);
             }
@@ -2258,9 +6096,9 @@ MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluate
         case OperatorInstruction::GREATER_EQUAL:
             switch (instruction->left.type) {
                 case Variant::CONST_INT:
-                    return make_immediate(block, instruction, instruction->left._int >= instruction->right._int);
+                    return make_immediate(instruction, instruction->left._int >= instruction->right._int);
                 case Variant::CONST_REAL:
-                    return make_immediate(block, instruction, instruction->left._float >= instruction->right._float);
+                    return make_immediate(instruction, instruction->left._float >= instruction->right._float);
                 default:
                     assert(false);
             }
@@ -2268,9 +6106,9 @@ MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluate
         case OperatorInstruction::PLUS:
             switch (instruction->left.type) {
                 case Variant::CONST_INT:
-                    return make_immediate(block, instruction, instruction->left._int + instruction->right._int);
+                    return make_immediate(instruction, instruction->left._int + instruction->right._int);
                 case Variant::CONST_REAL:
-                    return make_immediate(block, instruction, instruction->left._float + instruction->right._float);
+                    return make_immediate(instruction, instruction->left._float + instruction->right._float);
                 default:
                     assert(false);
             }
@@ -2278,9 +6116,9 @@ MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluate
         case OperatorInstruction::MINUS:
             switch (instruction->left.type) {
                 case Variant::CONST_INT:
-                    return make_immediate(block, instruction, instruction->left._int - instruction->right._int);
+                    return make_immediate(instruction, instruction->left._int - instruction->right._int);
                 case Variant::CONST_REAL:
-                    return make_immediate(block, instruction, instruction->left._float - instruction->right._float);
+                    return make_immediate(instruction, instruction->left._float - instruction->right._float);
                 default:
                     assert(false);
             }
@@ -2288,7 +6126,7 @@ MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluate
         case OperatorInstruction::OR:
             switch (instruction->left.type) {
                 case Variant::CONST_BOOL:
-                    return make_immediate(block, instruction, instruction->left._bool || instruction->right._bool);
+                    return make_immediate(instruction, instruction->left._bool || instruction->right._bool);
                 default:
                     assert(false);
             }
@@ -2296,9 +6134,9 @@ MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluate
         case OperatorInstruction::TIMES:
             switch (instruction->left.type) {
                 case Variant::CONST_INT:
-                    return make_immediate(block, instruction, instruction->left._int * instruction->right._int);
+                    return make_immediate(instruction, instruction->left._int * instruction->right._int);
                 case Variant::CONST_REAL:
-                    return make_immediate(block, instruction, instruction->left._float * instruction->right._float);
+                    return make_immediate(instruction, instruction->left._float * instruction->right._float);
                 default:
                     assert(false);
             }
@@ -2306,9 +6144,11 @@ MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluate
         case OperatorInstruction::DIVIDE:
             switch (instruction->left.type) {
                 case Variant::CONST_INT:
-                    return make_immediate(block, instruction, instruction->left._int / instruction->right._int);
+                    if (instruction->right._int == 0)
+                        return NULL; // leave it for run time
+                    return make_immediate(instruction, instruction->left._int / instruction->right._int);
                 case Variant::CONST_REAL:
-                    return make_immediate(block, instruction, instruction->left._float / instruction->right._float);
+                    return make_immediate(instruction, instruction->left._float / instruction->right._float);
                 default:
                     assert(false);
             }
@@ -2316,7 +6156,9 @@ MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluate
         case OperatorInstruction::MOD:
             switch (instruction->left.type) {
                 case Variant::CONST_INT:
-                    return make_immediate(block, instruction, instruction->left._int % instruction->right._int);
+                    if (instruction->right._int == 0)
+                        return NULL; // leave it for run time
+                    return make_immediate(instruction, instruction->left._int % instruction->right._int);
                 default:
                     assert(false);
             }
@@ -2324,7 +6166,7 @@ MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluate
         case OperatorInstruction::AND:
             switch (instruction->left.type) {
                 case Variant::CONST_BOOL:
-                    return make_immediate(block, instruction, instruction->left._bool && instruction->right._bool);
+                    return make_immediate(instruction, instruction->left._bool && instruction->right._bool);
                 default:
                     assert(false);
             }
@@ -2333,10 +6175,9 @@ MethodGenerator::CopyInstruction * MethodGenerator::constant_expression_evaluate
     return NULL;
 }
 
-MethodGenerator::CopyInstruction * MethodGenerator::make_copy(BasicBlock * block, OperatorInstruction * operator_instruction) {
-    CopyInstruction * copy_instruction = new CopyInstruction(operator_instruction->dest, operator_instruction->left);
+MethodGenerator::CopyInstruction * MethodGenerator::make_copy(OperatorInstruction * operator_instruction) {
+    CopyInstruction * copy_instruction = new (m_instruction_arena) CopyInstruction(operator_instruction->dest, operator_instruction->left);
     delete operator_instruction;
-    block->value_numbers.associate(copy_instruction->dest._int, get_value_number(block, copy_instruction->source));
     return copy_instruction;
 }
 
@@ -2357,56 +6198,50 @@ bool MethodGenerator::left_constant_is(OperatorInstruction * instruction, int co
            (instruction->left.type == Variant::CONST_BOOL && instruction->left._bool == (bool)constant);
 }
 
-MethodGenerator::CopyInstruction * MethodGenerator::make_immediate(BasicBlock *block, UnaryInstruction *unary_instruction, int constant) {
-    CopyInstruction * copy_instruction = new CopyInstruction(unary_instruction->dest, Variant(constant, Variant::CONST_INT));
+MethodGenerator::CopyInstruction * MethodGenerator::make_immediate(UnaryInstruction *unary_instruction, int constant) {
+    CopyInstruction * copy_instruction = new (m_instruction_arena) CopyInstruction(unary_instruction->dest, Variant(constant, Variant::CONST_INT));
     delete unary_instruction;
-    block->value_numbers.associate(copy_instruction->dest._int, get_value_number(block, copy_instruction->source));
     return copy_instruction;
 }
 
-MethodGenerator::CopyInstruction * MethodGenerator::make_immediate(BasicBlock *block, UnaryInstruction *unary_instruction, float constant) {
-    CopyInstruction * copy_instruction = new CopyInstruction(unary_instruction->dest, Variant(constant));
+MethodGenerator::CopyInstruction * MethodGenerator::make_immediate(UnaryInstruction *unary_instruction, float constant) {
+    CopyInstruction * copy_instruction = new (m_instruction_arena) CopyInstruction(unary_instruction->dest, Variant(constant));
     delete unary_instruction;
-    block->value_numbers.associate(copy_instruction->dest._int, get_value_number(block, copy_instruction->source));
     return copy_instruction;
 }
 
-MethodGenerator::CopyInstruction * MethodGenerator::make_immediate(BasicBlock *block, UnaryInstruction *unary_instruction, bool constant) {
-    CopyInstruction * copy_instruction = new CopyInstruction(unary_instruction->dest, Variant(constant));
+MethodGenerator::CopyInstruction * MethodGenerator::make_immediate(UnaryInstruction *unary_instruction, bool constant) {
+    CopyInstruction * copy_instruction = new (m_instruction_arena) CopyInstruction(unary_instruction->dest, Variant(constant));
     delete unary_instruction;
-    block->value_numbers.associate(copy_instruction->dest._int, get_value_number(block, copy_instruction->source));
     return copy_instruction;
 }
 
-MethodGenerator::CopyInstruction * MethodGenerator::make_immediate(BasicBlock * block, OperatorInstruction * operator_instruction, int constant) {
-    CopyInstruction * copy_instruction = new CopyInstruction(operator_instruction->dest, Variant(constant, Variant::CONST_INT));
+MethodGenerator::CopyInstruction * MethodGenerator::make_immediate(OperatorInstruction * operator_instruction, int constant) {
+    CopyInstruction * copy_instruction = new (m_instruction_arena) CopyInstruction(operator_instruction->dest, Variant(constant, Variant::CONST_INT));
     delete operator_instruction;
-    block->value_numbers.associate(copy_instruction->dest._int, get_value_number(block, copy_instruction->source));
     return copy_instruction;
 }
 
-MethodGenerator::CopyInstruction * MethodGenerator::make_immediate(BasicBlock * block, OperatorInstruction * operator_instruction, float constant) {
-    CopyInstruction * copy_instruction = new CopyInstruction(operator_instruction->dest, Variant(constant));
+MethodGenerator::CopyInstruction * MethodGenerator::make_immediate(OperatorInstruction * operator_instruction, float constant) {
+    CopyInstruction * copy_instruction = new (m_instruction_arena) CopyInstruction(operator_instruction->dest, Variant(constant));
     delete operator_instruction;
-    block->value_numbers.associate(copy_instruction->dest._int, get_value_number(block, copy_instruction->source));
     return copy_instruction;
 }
 
-MethodGenerator::CopyInstruction * MethodGenerator::make_immediate(BasicBlock * block, OperatorInstruction * operator_instruction, bool constant) {
-    CopyInstruction * copy_instruction = new CopyInstruction(operator_instruction->dest, Variant(constant));
+MethodGenerator::CopyInstruction * MethodGenerator::make_immediate(OperatorInstruction * operator_instruction, bool constant) {
+    CopyInstruction * copy_instruction = new (m_instruction_arena) CopyInstruction(operator_instruction->dest, Variant(constant));
     delete operator_instruction;
-    block->value_numbers.associate(copy_instruction->dest._int, get_value_number(block, copy_instruction->source));
     return copy_instruction;
 }
 
-MethodGenerator::Instruction * MethodGenerator::constant_folded(BasicBlock * block, OperatorInstruction * instruction) {
+MethodGenerator::Instruction * MethodGenerator::constant_folded(OperatorInstruction * instruction) {
     // we know that constants are on the right
     switch (instruction->_operator) {
         case OperatorInstruction::PLUS:
         {
             // a + 0 = a
             if (right_constant_is(instruction, 0))
-                return make_copy(block, instruction);
+                return make_copy(instruction);
             break;
         }
         case OperatorInstruction::MINUS:
@@ -2415,11 +6250,11 @@ MethodGenerator::Instruction * MethodGenerator::constant_folded(BasicBlock * blo
             // b := a - a;
             // 0 - a = -a
             if (right_constant_is(instruction, 0))
-                return make_copy(block, instruction);
+                return make_copy(instruction);
             else if (operands_same(instruction))
-                return make_immediate(block, instruction, 0);
+                return make_immediate(instruction, 0);
             else if (left_constant_is(instruction, 0)) {
-                UnaryInstruction * unary_instruction = new UnaryInstruction(instruction->dest, UnaryInstruction::NEGATE, instruction->right);
+                UnaryInstruction * unary_instruction = new (m_instruction_arena) UnaryInstruction(instruction->dest, UnaryInstruction::NEGATE, instruction->right);
                 delete instruction;
                 return unary_instruction;
             }
@@ -2432,9 +6267,9 @@ MethodGenerator::Instruction * MethodGenerator::constant_folded(BasicBlock * blo
             // b := a * 0;
             // b := a * 2;
             if (right_constant_is(instruction, 1))
-                return make_copy(block, instruction);
+                return make_copy(instruction);
             else if (right_constant_is(instruction, 0))
-                return make_immediate(block, instruction, 0);
+                return make_immediate(instruction, 0);
             else if (right_constant_is(instruction, 2)) {
                 instruction->_operator = OperatorInstruction::PLUS;
                 instruction->right = instruction->left;
@@ -2448,11 +6283,11 @@ MethodGenerator::Instruction * MethodGenerator::constant_folded(BasicBlock * blo
             // b := a / a;
             // 0 / a = 0
             if (right_constant_is(instruction, 1))
-                return make_copy(block, instruction);
+                return make_copy(instruction);
             else if (operands_same(instruction))
-                return make_immediate(block, instruction, 1);
+                return make_immediate(instruction, 1);
             else if (left_constant_is(instruction, 0))
-                return make_immediate(block, instruction, 0);
+                return make_immediate(instruction, 0);
             break;
         }
         case OperatorInstruction::AND:
@@ -2460,9 +6295,9 @@ MethodGenerator::Instruction * MethodGenerator::constant_folded(BasicBlock * blo
             // d := c and c;
             // a and false -> false
             if (operands_same(instruction))
-                return make_copy(block, instruction);
+                return make_copy(instruction);
             else if (right_constant_is(instruction, false))
-                return make_immediate(block, instruction, false);
+                return make_immediate(instruction, false);
             break;
         }
         case OperatorInstruction::OR:
@@ -2470,9 +6305,9 @@ MethodGenerator::Instruction * MethodGenerator::constant_folded(BasicBlock * blo
             // d := c or c;
             // a or true -> true
             if (operands_same(instruction))
-                return make_copy(block, instruction);
+                return make_copy(instruction);
             else if (right_constant_is(instruction, true))
-                return make_immediate(block, instruction, true);
+                return make_immediate(instruction, true);
             break;
         }
         case OperatorInstruction::MOD:
@@ -2480,9 +6315,9 @@ MethodGenerator::Instruction * MethodGenerator::constant_folded(BasicBlock * blo
             // 0 % a = 0
             // a % a = 0
             if (left_constant_is(instruction, 0))
-                return make_immediate(block, instruction, 0);
+                return make_immediate(instruction, 0);
             else if (operands_same(instruction))
-                return make_immediate(block, instruction, 0);
+                return make_immediate(instruction, 0);
         }
         default:
             break;
@@ -2490,54 +6325,3 @@ MethodGenerator::Instruction * MethodGenerator::constant_folded(BasicBlock * blo
     return instruction;
 }
 
-std::string MethodGenerator::hash_operand(BasicBlock * block, Variant operand) {
-    if (operand.type == Variant::REGISTER) {
-        Variant value = block->value_numbers.get(operand._int);
-        if (value.type == Variant::VALUE_NUMBER) {
-            std::stringstream ss;
-            ss << "(" << value.str() << ")";
-            return ss.str();
-        } else {
-            return value.str();
-        }
-    } else {
-        return operand.str();
-    }
-}
-
-std::string MethodGenerator::hash_operator_instruction(BasicBlock * block, OperatorInstruction * instruction) {
-    std::stringstream ss;
-    ss << hash_operand(block, instruction->left);
-    ss << " " << instruction->operator_str() << " ";
-    ss << hash_operand(block, instruction->right);
-
-    return ss.str();
-}
-
-std::string MethodGenerator::next_unique_value() {
-    std::stringstream ss;
-    ss << "?" << m_unique_value_count++;
-    return ss.str();
-}
-
-MethodGenerator::Variant MethodGenerator::inline_value(BasicBlock * block, Variant register_or_const) {
-    if (register_or_const.type == Variant::REGISTER) {
-        Variant value = block->value_numbers.get(register_or_const._int);
-        if (value.type == Variant::VALUE_NUMBER) {
-            std::list<int> * registers = block->value_numbers.keys(value);
-            int lowest = *(registers->begin());
-            return Variant(lowest, Variant::REGISTER);
-        } else {
-            return value;
-        }
-    } else {
-        return register_or_const;
-    }
-}
-
-MethodGenerator::Variant MethodGenerator::get_value_number(BasicBlock * block, Variant register_or_const) {
-    if (register_or_const.type == Variant::REGISTER)
-        return block->value_numbers.get(register_or_const._int);
-    else
-        return register_or_const;
-}
@@ -1,5 +1,77 @@
-
 #include "parser.h"
 #include "symbol_table.h"
 
-void generate_code(Program * program, SymbolTable * symbol_table, bool debug, bool disable_optimization, bool skip_lame_stuff);
+#include <set>
+#include <string>
+#include <vector>
+
+// what generate_code writes to standard out
+enum OutputFormat {
+    OUTPUT_ASSEMBLY,
+    // every method's control flow graph, for graphviz
+    OUTPUT_CFG_DOT,
+    // every method's blocks, instructions, register types and liveness
+    OUTPUT_IR_JSON,
+    // what the program prints, running the intermediate code instead of writing the assembly
+    OUTPUT_RUN_IR,
+};
+
+// which passes run when -fpasses doesn't say
+enum OptimizationLevel {
+    // -O0: the code just the way the generator made it
+    OPTIMIZE_NONE,
+    // -O1: a few cheap passes, for quick compiles
+    OPTIMIZE_LOCAL,
+    // -O2, the default: all of them, repeating the ones on SSA form until they settle down.
+    // -O3 is the same, since there's no pass that's only worth it for the fastest code.
+    OPTIMIZE_GLOBAL,
+    // -Os: -O2 without loop invariant code motion, the one pass that makes the code bigger
+    OPTIMIZE_SIZE,
+};
+
+struct CodeGenerationOptions {
+    // print the intermediate code as it goes through the passes
+    bool debug;
+    OptimizationLevel optimization_level;
+    // only print the intermediate code once it's done
+    bool skip_lame_stuff;
+    // check array indexes at run time
+    bool bounds_check;
+    OutputFormat output_format;
+    // the optimization passes to run instead of the usual ones, in order
+    std::vector<std::string> passes;
+    // whether there was a -fpasses at all, since it can name none
+    bool passes_given;
+    std::set<std::string> disabled_passes;
+    // repeat the passes on SSA form until they stop finding anything to remove, even at -O1
+    bool iterate_passes;
+    // print what each pass did and how long it took to standard error
+    bool pass_statistics;
+    // methods with more instructions or blocks than these, or whose loop passes go over this much
+    // work, only get the local passes. 0 for no limit. each loop costs the size of the whole method.
+    int method_instruction_limit;
+    int method_block_limit;
+    long long method_work_limit;
+    // the same for seconds taken to optimize, which depends on the machine and how busy it is,
+    // so it's off unless asked for
+    double method_time_limit;
+
+    CodeGenerationOptions() :
+        debug(false),
+        optimization_level(OPTIMIZE_GLOBAL),
+        skip_lame_stuff(false),
+        bounds_check(false),
+        output_format(OUTPUT_ASSEMBLY),
+        passes_given(false),
+        iterate_passes(false),
+        pass_statistics(false),
+        method_instruction_limit(50000),
+        method_block_limit(10000),
+        method_work_limit(10000000),
+        method_time_limit(0) {}
+};
+
+// whether -fpasses and -fno- can name it
+bool is_optimization_pass(std::string name);
+
+void generate_code(Program * program, SymbolTable * symbol_table, CodeGenerationOptions & options);
@@ -0,0 +1,62 @@
+#include "dataflow.h"
+
+DataflowProblem::DataflowProblem(Direction direction, int block_count, int fact_count) :
+    gen(block_count, BitVector(fact_count)),
+    kill(block_count, BitVector(fact_count)),
+    boundary(block_count, BitVector(fact_count)),
+    in(block_count, BitVector(fact_count)),
+    out(block_count, BitVector(fact_count)),
+    m_direction(direction),
+    m_children(block_count),
+    m_parents(block_count)
+{
+}
+
+void DataflowProblem::add_edge(int parent, int child) {
+    m_children[parent].push_back(child);
+    m_parents[child].push_back(parent);
+}
+
+void DataflowProblem::solve() {
+    // flip a backward problem around so the loop below only has to go one way
+    bool forward = m_direction == FORWARD;
+    std::vector<BitVector> & before = forward ? in : out;
+    std::vector<BitVector> & after = forward ? out : in;
+    std::vector<std::vector<int> > & predecessors = forward ? m_parents : m_children;
+    std::vector<std::vector<int> > & successors = forward ? m_children : m_parents;
+
+    // start with every block, in the order that gets the most done on the first pass
+    int block_count = gen.size();
+    std::vector<int> work;
+    BitVector queued(block_count);
+    for (int i = 0; i < block_count; i++) {
+        work.push_back(forward ? block_count - 1 - i : i);
+        queued.set(i);
+    }
+
+    BitVector result;
+    while (! work.empty()) {
+        int block = work.back();
+        work.pop_back();
+        queued.reset(block);
+
+        before[block] = boundary[block];
+        for (int i = 0; i < (int)predecessors[block].size(); i++)
+            before[block].union_with(after[predecessors[block][i]]);
+
+        result = before[block];
+        result.subtract(kill[block]);
+        result.union_with(gen[block]);
+        if (result == after[block])
+            continue;
+        after[block] = result;
+
+        for (int i = 0; i < (int)successors[block].size(); i++) {
+            int successor = successors[block][i];
+            if (! queued.test(successor)) {
+                queued.set(successor);
+                work.push_back(successor);
+            }
+        }
+    }
+}
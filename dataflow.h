@@ -0,0 +1,35 @@
+#ifndef DATAFLOW_H
+#define DATAFLOW_H
+
+#include "bit_vector.h"
+
+#include <vector>
+
+// a gen/kill problem over the blocks of a control flow graph, where facts are bit indexes
+// (registers for liveness, assignments for reaching definitions) and paths meet by union.
+// fill in the edges, gen, kill and boundary, then solve() fills in in and out.
+class DataflowProblem
+{
+public:
+    enum Direction {FORWARD, BACKWARD};
+
+    DataflowProblem(Direction direction, int block_count, int fact_count);
+
+    void add_edge(int parent, int child);
+    void solve();
+
+    // facts a block creates, and facts it destroys that come in from the other side
+    std::vector<BitVector> gen;
+    std::vector<BitVector> kill;
+    // facts that come into a block whatever its neighbours say
+    std::vector<BitVector> boundary;
+    // at the top and bottom of each block
+    std::vector<BitVector> in;
+    std::vector<BitVector> out;
+private:
+    Direction m_direction;
+    std::vector<std::vector<int> > m_children;
+    std::vector<std::vector<int> > m_parents;
+};
+
+#endif // DATAFLOW_H
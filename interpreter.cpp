@@ -0,0 +1,391 @@
+#include "interpreter.h"
+
+#include <climits>
+#include <map>
+#include <sstream>
+
+// where the addresses of the heap and of objects and arrays in frames start. nothing's near 0, so
+// following a nil pointer to any of its fields is an error like it is on the machine.
+const int heap_start = 0x10000000;
+const int stack_start = 0x40000000;
+// the assembly runs out when sbrk does. we stop at 256MB instead.
+const int memory_limit = 256 * 1024 * 1024;
+// every heap block starts with its layout (0 when it's free) and its size in words
+const int heap_header_words = 2;
+// how big the heap gets before the first collection, the same as the assembly's first heap
+const int initial_heap_words = 64 * 1024 / 4;
+
+class Interpreter
+{
+public:
+    Interpreter(std::vector<IrMethod> & methods, std::ostream & out);
+
+    void run(int method);
+
+private:
+    struct Frame {
+        int method;
+        // the next operation, while it's calling something
+        int pc;
+        // where its slots start in m_slots
+        int base;
+        // where its objects and arrays start in m_stack, in words
+        int stack_base;
+        // the caller's slot for what it hands back, -1 for none
+        int return_dest;
+    };
+
+    std::vector<IrMethod> & m_methods;
+    // the index of each method's callees in m_methods
+    std::vector<std::vector<int> > m_callees;
+    std::ostream & m_out;
+
+    // the frames of every method that's running, one after another
+    std::vector<int> m_slots;
+    std::vector<Frame> m_frames;
+    std::vector<int> m_heap;
+    std::vector<int> m_stack;
+
+    // every method's layouts in one list, so a heap block can say which is its own
+    std::vector<std::vector<int> > m_layouts;
+    std::vector<std::vector<int> > m_layout_indexes;
+    // a bit for every word of the heap where a block's header is
+    std::vector<bool> m_block_starts;
+    // free blocks' contents by their size in words
+    std::map<int, std::vector<int> > m_free_blocks;
+    // the next collection happens when the heap would grow past this many words
+    int m_collect_at;
+
+    // start running method with the caller's argument slots in its first registers.
+    // returns false if there's no room for its frame.
+    bool call(int method, int caller_base, const int * argument_slots, int argument_count, int return_dest);
+    // returns the address, 0 if there's no room
+    int allocate(int size, int layout);
+    // mark everything reachable from the frames and sweep the rest into m_free_blocks
+    void collect();
+    // the word at address, NULL if there isn't one
+    int * word(int address);
+    // stop the program the way the assembly would
+    void fail(std::string message);
+};
+
+Interpreter::Interpreter(std::vector<IrMethod> & methods, std::ostream & out) :
+    m_methods(methods),
+    m_callees(methods.size()),
+    m_out(out),
+    m_layout_indexes(methods.size()),
+    m_collect_at(initial_heap_words)
+{
+    std::map<std::string, int> method_indexes;
+    for (int i = 0; i < (int)methods.size(); i++) {
+        method_indexes[methods[i].label] = i;
+        for (int j = 0; j < (int)methods[i].layouts.size(); j++) {
+            m_layout_indexes[i].push_back(m_layouts.size());
+            m_layouts.push_back(methods[i].layouts[j]);
+        }
+    }
+    for (int i = 0; i < (int)methods.size(); i++) {
+        for (int j = 0; j < (int)methods[i].callees.size(); j++) {
+            std::map<std::string, int>::iterator it = method_indexes.find(methods[i].callees[j]);
+            m_callees[i].push_back(it == method_indexes.end() ? -1 : it->second);
+        }
+    }
+}
+
+void Interpreter::fail(std::string message) {
+    m_out << message << "\n";
+    m_frames.clear();
+}
+
+int Interpreter::allocate(int size, int layout) {
+    // at least a word, so no two blocks have the same address
+    int words = size > 0 ? (size + 3) / 4 : 1;
+    if (m_free_blocks[words].empty() && (int)m_heap.size() + heap_header_words + words > m_collect_at) {
+        int heap_words = m_heap.size();
+        collect();
+        // grow instead if less than a quarter of the heap came free, so collections don't keep getting
+        // closer together. free blocks only get reused at the same size, so none of that size counts too.
+        int free_words = 0;
+        for (std::map<int, std::vector<int> >::iterator it = m_free_blocks.begin(); it != m_free_blocks.end(); ++it)
+            free_words += (it->first + heap_header_words) * it->second.size();
+        if (free_words < heap_words / 4 || m_free_blocks[words].empty())
+            m_collect_at = heap_words * 2;
+    }
+
+    int start;
+    std::vector<int> & free_blocks = m_free_blocks[words];
+    if (! free_blocks.empty()) {
+        start = free_blocks.back();
+        free_blocks.pop_back();
+        for (int i = 0; i < words; i++)
+            m_heap[start + i] = 0;
+    } else {
+        if ((int)m_heap.size() > (memory_limit - size) / 4 - heap_header_words)
+            return 0;
+        start = m_heap.size() + heap_header_words;
+        m_heap.resize(start + words, 0);
+        m_block_starts.resize(start + words, false);
+        m_block_starts[start - heap_header_words] = true;
+        m_heap[start - 1] = words;
+    }
+    m_heap[start - 2] = layout + 1;
+    return heap_start + start * 4;
+}
+
+void Interpreter::collect() {
+    // the frames' pointers
+    std::vector<int> pending;
+    for (int i = 0; i < (int)m_frames.size(); i++) {
+        IrMethod & method = m_methods[m_frames[i].method];
+        for (int j = 0; j < (int)method.pointer_registers.size(); j++)
+            pending.push_back(m_slots[m_frames[i].base + method.pointer_registers[j]]);
+        for (int j = 0; j < (int)method.stack_pointer_offsets.size(); j++)
+            pending.push_back(m_stack[m_frames[i].stack_base + method.stack_pointer_offsets[j] / 4]);
+    }
+
+    // and what they point to. like the assembly's, a pointer into the middle of a block keeps all of it.
+    std::vector<bool> marked(m_heap.size(), false);
+    while (! pending.empty()) {
+        int address = pending.back();
+        pending.pop_back();
+        if (address < heap_start || address >= heap_start + (int)m_heap.size() * 4)
+            continue;
+        int header = (address - heap_start) / 4;
+        while (! m_block_starts[header])
+            header--;
+        if (m_heap[header] == 0 || marked[header])
+            continue;
+        marked[header] = true;
+        int start = header + heap_header_words;
+        int words = m_heap[start - 1];
+        std::vector<int> & layout = m_layouts[m_heap[start - 2] - 1];
+        if (layout.size() == 1 && layout[0] == -1) {
+            for (int i = 0; i < words; i++)
+                pending.push_back(m_heap[start + i]);
+        } else {
+            for (int i = 0; i < (int)layout.size(); i++) {
+                if (layout[i] / 4 < words)
+                    pending.push_back(m_heap[start + layout[i] / 4]);
+            }
+        }
+    }
+
+    m_free_blocks.clear();
+    for (int header = 0; header < (int)m_heap.size(); header += heap_header_words + m_heap[header + 1]) {
+        if (marked[header])
+            continue;
+        m_heap[header] = 0;
+        m_free_blocks[m_heap[header + 1]].push_back(header + heap_header_words);
+    }
+}
+
+int * Interpreter::word(int address) {
+    if (address % 4 != 0)
+        return NULL;
+    if (address >= stack_start) {
+        int index = (address - stack_start) / 4;
+        return index < (int)m_stack.size() ? &m_stack[index] : NULL;
+    }
+    if (address >= heap_start) {
+        int index = (address - heap_start) / 4;
+        return index < (int)m_heap.size() ? &m_heap[index] : NULL;
+    }
+    return NULL;
+}
+
+bool Interpreter::call(int method, int caller_base, const int * argument_slots, int argument_count, int return_dest) {
+    IrMethod & callee = m_methods[method];
+    if ((m_slots.size() + callee.initial_frame.size() + m_stack.size()) * 4 + callee.stack_allocation_size > (size_t)memory_limit)
+        return false;
+    int base = m_slots.size();
+    m_slots.insert(m_slots.end(), callee.initial_frame.begin(), callee.initial_frame.end());
+    for (int i = 0; i < argument_count && i < callee.register_count; i++)
+        m_slots[base + i] = m_slots[caller_base + argument_slots[i]];
+
+    Frame frame;
+    frame.method = method;
+    frame.pc = 0;
+    frame.base = base;
+    frame.stack_base = m_stack.size();
+    frame.return_dest = return_dest;
+    m_stack.resize(m_stack.size() + (callee.stack_allocation_size + 3) / 4);
+    m_frames.push_back(frame);
+    return true;
+}
+
+void Interpreter::run(int method) {
+    if (! call(method, 0, NULL, 0, -1))
+        return;
+    while (! m_frames.empty()) {
+        // run this frame until it calls something or returns. the slots can move when it does.
+        Frame & frame = m_frames.back();
+        IrMethod & ir_method = m_methods[frame.method];
+        const IrOperation * operations = &ir_method.operations[0];
+        int * slots = &m_slots[frame.base];
+        int pc = frame.pc;
+        bool running = true;
+        while (running) {
+            const IrOperation & operation = operations[pc++];
+            switch (operation.opcode) {
+                case IrOperation::COPY:
+                    slots[operation.dest] = slots[operation.left];
+                    break;
+                case IrOperation::EQUAL:
+                    slots[operation.dest] = slots[operation.left] == slots[operation.right];
+                    break;
+                case IrOperation::NOT_EQUAL:
+                    slots[operation.dest] = slots[operation.left] != slots[operation.right];
+                    break;
+                case IrOperation::LESS:
+                    slots[operation.dest] = slots[operation.left] < slots[operation.right];
+                    break;
+                case IrOperation::GREATER:
+                    slots[operation.dest] = slots[operation.left] > slots[operation.right];
+                    break;
+                case IrOperation::LESS_EQUAL:
+                    slots[operation.dest] = slots[operation.left] <= slots[operation.right];
+                    break;
+                case IrOperation::GREATER_EQUAL:
+                    slots[operation.dest] = slots[operation.left] >= slots[operation.right];
+                    break;
+                // wrapping around instead of overflowing, which int arithmetic isn't allowed to do
+                case IrOperation::PLUS:
+                    slots[operation.dest] = (int)((unsigned int)slots[operation.left] + (unsigned int)slots[operation.right]);
+                    break;
+                case IrOperation::MINUS:
+                    slots[operation.dest] = (int)((unsigned int)slots[operation.left] - (unsigned int)slots[operation.right]);
+                    break;
+                case IrOperation::TIMES:
+                    slots[operation.dest] = (int)((unsigned int)slots[operation.left] * (unsigned int)slots[operation.right]);
+                    break;
+                case IrOperation::OR:
+                    slots[operation.dest] = slots[operation.left] | slots[operation.right];
+                    break;
+                case IrOperation::AND:
+                    slots[operation.dest] = slots[operation.left] & slots[operation.right];
+                    break;
+                case IrOperation::DIVIDE:
+                case IrOperation::MOD:
+                {
+                    int left = slots[operation.left];
+                    int right = slots[operation.right];
+                    if (right == 0) {
+                        fail("ERROR: division by zero");
+                        return;
+                    }
+                    if (left == INT_MIN && right == -1)
+                        slots[operation.dest] = operation.opcode == IrOperation::DIVIDE ? INT_MIN : 0;
+                    else
+                        slots[operation.dest] = operation.opcode == IrOperation::DIVIDE ? left / right : left % right;
+                    break;
+                }
+                case IrOperation::NOT:
+                    slots[operation.dest] = slots[operation.left] ^ 1;
+                    break;
+                case IrOperation::NEGATE:
+                    slots[operation.dest] = (int)(0u - (unsigned int)slots[operation.left]);
+                    break;
+                case IrOperation::IF_NOT:
+                    if (slots[operation.left] == 0)
+                        pc = operation.target;
+                    break;
+                case IrOperation::GOTO:
+                    pc = operation.target;
+                    break;
+                case IrOperation::RETURN:
+                {
+                    int value = operation.left == -1 ? 0 : slots[operation.left];
+                    Frame finished = frame;
+                    m_frames.pop_back();
+                    m_slots.resize(finished.base);
+                    m_stack.resize(finished.stack_base);
+                    if (! m_frames.empty() && finished.return_dest != -1)
+                        m_slots[m_frames.back().base + finished.return_dest] = value;
+                    running = false;
+                    break;
+                }
+                case IrOperation::PRINT_INT:
+                    m_out << slots[operation.left] << "\n";
+                    break;
+                case IrOperation::PRINT_BOOL:
+                    m_out << (slots[operation.left] != 0 ? "true" : "false") << "\n";
+                    break;
+                case IrOperation::CALL:
+                {
+                    int callee = m_callees[frame.method][operation.target];
+                    if (callee == -1) {
+                        fail("ERROR: no method " + ir_method.callees[operation.target]);
+                        return;
+                    }
+                    frame.pc = pc;
+                    const int * argument_slots = operation.right == 0 ? NULL : &ir_method.arguments[operation.left];
+                    if (! call(callee, frame.base, argument_slots, operation.right, operation.dest)) {
+                        fail("ERROR: out of memory");
+                        return;
+                    }
+                    running = false;
+                    break;
+                }
+                case IrOperation::ALLOCATE_HEAP:
+                {
+                    int address = allocate(operation.target, m_layout_indexes[frame.method][operation.min]);
+                    if (address == 0) {
+                        fail("ERROR: out of memory");
+                        return;
+                    }
+                    slots[operation.dest] = address;
+                    break;
+                }
+                case IrOperation::ALLOCATE_STACK:
+                {
+                    int start = frame.stack_base + operation.right / 4;
+                    for (int i = 0; i < (operation.target + 3) / 4; i++)
+                        m_stack[start + i] = 0;
+                    slots[operation.dest] = stack_start + start * 4;
+                    break;
+                }
+                case IrOperation::WRITE_POINTER:
+                {
+                    int * address = word(slots[operation.left]);
+                    if (address == NULL) {
+                        fail("ERROR: bad pointer");
+                        return;
+                    }
+                    *address = slots[operation.right];
+                    break;
+                }
+                case IrOperation::READ_POINTER:
+                {
+                    int * address = word(slots[operation.left]);
+                    if (address == NULL) {
+                        fail("ERROR: bad pointer");
+                        return;
+                    }
+                    slots[operation.dest] = *address;
+                    break;
+                }
+                case IrOperation::BOUNDS_CHECK:
+                {
+                    int index = slots[operation.left];
+                    if (index < operation.min || index > operation.max) {
+                        std::stringstream message;
+                        message << "ERROR: array index out of bounds on line " << operation.target;
+                        fail(message.str());
+                        return;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void run_ir(std::vector<IrMethod> & methods, std::string entry_label, std::ostream & out) {
+    Interpreter interpreter(methods, out);
+    for (int i = 0; i < (int)methods.size(); i++) {
+        if (methods[i].label == entry_label) {
+            interpreter.run(i);
+            return;
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// one step of a method's intermediate code, flattened out for -run-ir.
+// operands are slots in the method's frame: its registers first, then its constants.
+struct IrOperation {
+    enum Opcode {
+        // dest = left
+        COPY,
+        // dest = left op right
+        EQUAL, NOT_EQUAL, LESS, GREATER, LESS_EQUAL, GREATER_EQUAL,
+        PLUS, MINUS, OR, TIMES, DIVIDE, MOD, AND,
+        // dest = op left
+        NOT, NEGATE,
+        // go to operation target if left is false
+        IF_NOT,
+        GOTO,
+        // hand back left, -1 for nothing
+        RETURN,
+        PRINT_INT,
+        PRINT_BOOL,
+        // call method target with the right slots in arguments starting at left, and put what it
+        // hands back in dest, -1 to throw it away
+        CALL,
+        // dest = the address of target zeroed bytes, with pointers where the method's layouts[min] says
+        ALLOCATE_HEAP,
+        // the same, at offset right in the frame's space for objects and arrays that don't escape
+        ALLOCATE_STACK,
+        // *left = right
+        WRITE_POINTER,
+        // dest = *left
+        READ_POINTER,
+        // stop the program with an error for line target if left isn't in min..max
+        BOUNDS_CHECK,
+    };
+    Opcode opcode;
+    int dest;
+    int left;
+    int right;
+    int target;
+    int min;
+    int max;
+
+    IrOperation(Opcode opcode) : opcode(opcode), dest(-1), left(-1), right(-1), target(-1), min(0), max(0) {}
+};
+
+struct IrMethod {
+    // class_method, the same as its label in the assembly
+    std::string label;
+    std::vector<IrOperation> operations;
+    // what a frame starts out as: zeros for the registers, then the constants
+    std::vector<int> initial_frame;
+    // the registers come first in the frame. the caller puts this and the parameters in the first ones.
+    int register_count;
+    int stack_allocation_size;
+    // where the garbage collector looks for pointers: registers, and byte offsets in the space for
+    // objects and arrays that don't escape
+    std::vector<int> pointer_registers;
+    std::vector<int> stack_pointer_offsets;
+    // the byte offsets of the pointers in what each ALLOCATE_HEAP allocates. just -1 for arrays of
+    // pointers, where every word is one.
+    std::vector<std::vector<int> > layouts;
+    // frame slots passed by the calls
+    std::vector<int> arguments;
+    // the labels of the methods the calls call, by their target. the interpreter turns them into method indexes.
+    std::vector<std::string> callees;
+};
+
+// runs a program's methods, starting from the one labeled entry_label,
+// and writes what it prints to out the way the assembly would have
+void run_ir(std::vector<IrMethod> & methods, std::string entry_label, std::ostream & out);
+
+#endif // INTERPRETER_H
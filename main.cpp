@@ -4,6 +4,8 @@
 #include "code_generation.h"
 
 #include <string>
+#include <sstream>
+#include <cstdlib>
 
 void print_usage(std::string exe_name);
 void add_entry_point(Program * program);
@@ -12,20 +14,60 @@ int main(int argc, char * argv[]) {
     char * filename = NULL;
 
     bool only_semantic_checking = false;
-    bool output_intermediate = false;
-    bool disable_optimization = false;
-    bool skip_lame_stuff = false;
+    CodeGenerationOptions options;
     for (int i=1; i<argc; ++i) {
         std::string arg = argv[i];
         if (arg[0] == '-') {
             if (arg.compare("-p1") == 0) {
                 only_semantic_checking = true;
             } else if (arg.compare("-p2") == 0) {
-                output_intermediate = true;
+                options.debug = true;
             } else if (arg.compare("-O0") == 0) {
-                disable_optimization = true;
+                options.optimization_level = OPTIMIZE_NONE;
+            } else if (arg.compare("-O1") == 0) {
+                options.optimization_level = OPTIMIZE_LOCAL;
+            } else if (arg.compare("-O2") == 0 || arg.compare("-O3") == 0) {
+                options.optimization_level = OPTIMIZE_GLOBAL;
+            } else if (arg.compare("-Os") == 0) {
+                options.optimization_level = OPTIMIZE_SIZE;
             } else if (arg.compare("-s") == 0) {
-                skip_lame_stuff = true;
+                options.skip_lame_stuff = true;
+            } else if (arg.compare("-fbounds-check") == 0) {
+                options.bounds_check = true;
+            } else if (arg.compare("-emit-cfg=dot") == 0) {
+                options.output_format = OUTPUT_CFG_DOT;
+            } else if (arg.compare("-emit-ir=json") == 0) {
+                options.output_format = OUTPUT_IR_JSON;
+            } else if (arg.compare("-run-ir") == 0) {
+                options.output_format = OUTPUT_RUN_IR;
+            } else if (arg.compare(0, 9, "-fpasses=") == 0) {
+                options.passes_given = true;
+                std::stringstream names(arg.substr(9));
+                std::string name;
+                while (std::getline(names, name, ',')) {
+                    if (name.empty())
+                        continue;
+                    if (! is_optimization_pass(name)) {
+                        std::cerr << "Unrecognized optimization pass: " << name << std::endl;
+                        print_usage(argv[0]);
+                        return 1;
+                    }
+                    options.passes.push_back(name);
+                }
+            } else if (arg.compare(0, 5, "-fno-") == 0 && is_optimization_pass(arg.substr(5))) {
+                options.disabled_passes.insert(arg.substr(5));
+            } else if (arg.compare("-fiterate-passes") == 0) {
+                options.iterate_passes = true;
+            } else if (arg.compare("-fpass-stats") == 0) {
+                options.pass_statistics = true;
+            } else if (arg.compare(0, 27, "-fmethod-instruction-limit=") == 0) {
+                options.method_instruction_limit = atoi(arg.substr(27).c_str());
+            } else if (arg.compare(0, 21, "-fmethod-block-limit=") == 0) {
+                options.method_block_limit = atoi(arg.substr(21).c_str());
+            } else if (arg.compare(0, 20, "-fmethod-work-limit=") == 0) {
+                options.method_work_limit = atoll(arg.substr(20).c_str());
+            } else if (arg.compare(0, 20, "-fmethod-time-limit=") == 0) {
+                options.method_time_limit = atof(arg.substr(20).c_str());
             } else {
                 std::cerr << "Unrecognized parameter: " << arg << std::endl;
                 print_usage(argv[0]);
@@ -36,6 +78,13 @@ int main(int argc, char * argv[]) {
         }
     }
 
+    // -O0 doesn't run any passes, so there would be nothing for it to pick from
+    if (options.passes_given && options.optimization_level == OPTIMIZE_NONE) {
+        std::cerr << "-fpasses can't be used with -O0" << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
     Program * program = parse_input(filename);
 
     add_entry_point(program);
@@ -51,7 +100,7 @@ int main(int argc, char * argv[]) {
     if (only_semantic_checking)
         return 0;
 
-    generate_code(program, symbol_table, output_intermediate, disable_optimization, skip_lame_stuff);
+    generate_code(program, symbol_table, options);
 
     return 0;
 }
@@ -82,4 +131,46 @@ void print_usage(std::string exe_name) {
 
     std::cerr << "Disable optimization:\n";
     std::cerr << exe_name << " -O0 [file]\n";
+
+    std::cerr << "Only run the quick optimizations:\n";
+    std::cerr << exe_name << " -O1 [file]\n";
+
+    std::cerr << "Run all the optimizations, repeating them until they stop finding anything (the default):\n";
+    std::cerr << exe_name << " -O2 [file]\n";
+
+    std::cerr << "The same as -O2:\n";
+    std::cerr << exe_name << " -O3 [file]\n";
+
+    std::cerr << "Like -O2, without the optimizations that make the code bigger:\n";
+    std::cerr << exe_name << " -Os [file]\n";
+
+    std::cerr << "Stop with an error when an array index is out of range:\n";
+    std::cerr << exe_name << " -fbounds-check [file]\n";
+
+    std::cerr << "Output each method's control flow graph in graphviz format instead of assembly:\n";
+    std::cerr << exe_name << " -emit-cfg=dot [file]\n";
+
+    std::cerr << "Output each method's intermediate representation and liveness as JSON instead of assembly:\n";
+    std::cerr << exe_name << " -emit-ir=json [file]\n";
+
+    std::cerr << "Run the optimized intermediate representation and output what the program prints instead of assembly:\n";
+    std::cerr << exe_name << " -run-ir [file]\n";
+
+    std::cerr << "Run only these optimization passes, in this order:\n";
+    std::cerr << exe_name << " -fpasses=constant-propagation,value-numbering,bounds-check-elimination,strength-reduction,dependency-management,loop-invariant-code-motion,block-deletion,stack-allocation [file]\n";
+
+    std::cerr << "Skip one of the optimization passes:\n";
+    std::cerr << exe_name << " -fno-value-numbering [file]\n";
+
+    std::cerr << "Repeat the passes on SSA form until they stop removing anything, even with -O1:\n";
+    std::cerr << exe_name << " -fiterate-passes [file]\n";
+
+    std::cerr << "Print what each optimization pass removed and how long it took to standard error:\n";
+    std::cerr << exe_name << " -fpass-stats [file]\n";
+
+    std::cerr << "Only run the quick optimizations on methods bigger than this, or whose loops take more than this much work (0 for no limit):\n";
+    std::cerr << exe_name << " -fmethod-instruction-limit=50000 -fmethod-block-limit=10000 -fmethod-work-limit=10000000 [file]\n";
+
+    std::cerr << "The same for methods that take longer than this many seconds to optimize (off unless given):\n";
+    std::cerr << exe_name << " -fmethod-time-limit=10 [file]\n";
 }
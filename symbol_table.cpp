@@ -192,6 +192,24 @@ VariableData * get_field(SymbolTable * symbol_table, std::string class_name, std
     }
 }
 
+ClassLayout * get_class_layout(SymbolTable * symbol_table, std::string class_name) {
+    ClassSymbolTable * class_symbols = symbol_table->get(class_name);
+    if (class_symbols->layout != NULL)
+        return class_symbols->layout;
+
+    ClassLayout * layout = new ClassLayout();
+    if (class_symbols->class_declaration->parent_identifier != NULL)
+        *layout = *get_class_layout(symbol_table, class_symbols->class_declaration->parent_identifier->text);
+    for (int i = 0; i < class_symbols->variables->count(); i++) {
+        VariableData * field = class_symbols->variables->get(i);
+        layout->offsets[Utils::to_lower(field->name)] = layout->size;
+        layout->fields.push_back(field);
+        layout->size += 4;
+    }
+    class_symbols->layout = layout;
+    return layout;
+}
+
 bool add_variables(OrderedInsensitiveMap<VariableData *> * function_variables, VariableDeclaration * variable_declaration, std::string function_name) {
     bool success = true;
     for (IdentifierList * id_list = variable_declaration->id_list; id_list != NULL; id_list = id_list->next) {
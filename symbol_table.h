@@ -5,6 +5,8 @@
 
 #include "insensitive_map.h"
 #include <string>
+#include <map>
+#include <vector>
 
 
 struct VariableData {
@@ -29,17 +31,32 @@ struct FunctionSymbolTable {
         variables(new OrderedInsensitiveMap<VariableData *>) {}
 };
 
+// where the fields of an instance live, including the ones it inherits
+struct ClassLayout {
+    // size of an instance in bytes
+    int size;
+    // every field in memory order, the root class first. field i is at offset i * 4
+    std::vector<VariableData *> fields;
+    // maps lowercase field name to offset in bytes
+    std::map<std::string, int> offsets;
+
+    ClassLayout() : size(0) {}
+};
+
 struct ClassSymbolTable {
     ClassDeclaration * class_declaration;
     // class variables, maps variable name to variable declaration
     VariableTable * variables;
     // maps function name to function symbol table
     OrderedInsensitiveMap<FunctionSymbolTable *> * function_symbols;
+    // filled in by get_class_layout the first time it's asked for
+    ClassLayout * layout;
 
     ClassSymbolTable(ClassDeclaration * class_declaration) :
         class_declaration(class_declaration),
         variables(new OrderedInsensitiveMap<VariableData *>),
-        function_symbols(new OrderedInsensitiveMap<FunctionSymbolTable *>) {}
+        function_symbols(new OrderedInsensitiveMap<FunctionSymbolTable *>),
+        layout(NULL) {}
 };
 // maps class name to symbol table
 typedef OrderedInsensitiveMap<ClassSymbolTable *> SymbolTable;
@@ -50,6 +67,7 @@ SymbolTable * build_symbol_table(Program * program);
 
 bool add_variables(OrderedInsensitiveMap<VariableData *> * function_variables, VariableDeclaration * variable_declaration, std::string function_name);
 VariableData * get_field(SymbolTable * symbol_table, std::string class_name, std::string field_name);
+ClassLayout * get_class_layout(SymbolTable * symbol_table, std::string class_name);
 FunctionDeclaration * get_method(SymbolTable * symbol_table, std::string class_name, std::string method_name);
 std::string get_declaring_class(SymbolTable * symbol_table, std::string class_name, std::string method_name);
 VariableDeclarationList * reverse_variable_declaration_list(VariableDeclarationList * variable_declaration_list, VariableDeclarationList * prev = NULL);
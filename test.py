@@ -47,6 +47,23 @@ def superwalk(folder):
 def absolute(relative_path):
     return os.path.abspath(os.path.join(os.path.dirname(__file__), relative_path))
 
+def assembly_size(asm_code):
+    "the number of instructions, leaving out labels, directives and comments"
+    size = 0
+    for line in asm_code.split('\n'):
+        line = line.split('#')[0].strip()
+        if line == '' or line.startswith('.') or line.endswith(':'):
+            continue
+        if line.find(':') != -1 and line.split(':', 1)[1].strip().startswith('.'):
+            continue
+        size += 1
+    return size
+
+def compile_source(compiler_exe, flags, source):
+    compiler = subprocess.Popen([compiler_exe] + flags, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    stdout, stderr = compiler.communicate(source)
+    return stdout
+
 def execute_spim_code(asm_code):
     "execute asm_code and return stdout"
     exe = which('spim')
@@ -67,12 +84,19 @@ def execute_spim_code(asm_code):
 
     return clean_out
 
+# with one of these the compiler outputs what to check instead of assembly
+output_format_flags = ['-run-ir', '-emit-cfg=dot', '-emit-ir=json']
+# the tests in these folders also run through -run-ir, so the compiler's interpreter, with its
+# own heap, garbage collector and bounds checks, is checked against the same .out files
+run_ir_folders = ['generation', 'control_flow']
+
 def main():
     parser = optparse.OptionParser()
     parser.add_option('-f', '--failfast', help="Stop on first failed test", action="store_true")
     parser.add_option("-q", "--quiet", help="only print dots and summary", action="store_true")
     parser.add_option("-b", "--backwards", help="run tests in reverse order", action="store_true")
     parser.add_option("-v", "--verbose", action="store_true", default=False)
+    parser.add_option("-i", "--run-ir", help="run the intermediate code with the compiler's -run-ir instead of the assembly with spim", action="store_true")
     options, args = parser.parse_args()
 
     if not options.quiet:
@@ -91,6 +115,15 @@ def main():
         elif f.endswith('.p.out'):
             test_name = f[:-len('.p.out')]
             ext = '.p.out'
+        elif f.endswith('.p.flags'):
+            test_name = f[:-len('.p.flags')]
+            ext = '.p.flags'
+        elif f.endswith('.p.absent'):
+            test_name = f[:-len('.p.absent')]
+            ext = '.p.absent'
+        elif f.endswith('.p.no_larger_than'):
+            test_name = f[:-len('.p.no_larger_than')]
+            ext = '.p.no_larger_than'
         else:
             continue
 
@@ -103,12 +136,22 @@ def main():
         elif ext == '.p.out':
             expected_output = open(absolute(f), 'r').read()
             tests[test_name]['out'] = expected_output
+        elif ext == '.p.flags':
+            tests[test_name]['flags'] = open(absolute(f), 'r').read().split()
+        elif ext == '.p.absent':
+            # lines of text that must not show up anywhere in what the compiler outputs
+            tests[test_name]['absent'] = open(absolute(f), 'r').read().splitlines()
+        elif ext == '.p.no_larger_than':
+            # flags that must not give fewer instructions than the test's own flags
+            tests[test_name]['no_larger_than'] = open(absolute(f), 'r').read().split()
         else: # ext == '.p'
             tests[test_name]['source'] = open(absolute(f), 'r').read()
 
     fails = []
     compiler_exe = absolute('opc')
-    interpret_command = execute_spim_code
+    compiler_flags = []
+    if options.run_ir:
+        compiler_flags = ['-run-ir']
     passed = 0
     test_list = sorted(tests.iteritems())
     if options.backwards:
@@ -126,7 +169,14 @@ def main():
             print("%s missing .out file for what the program should output" % test_name)
             continue
 
+    runs = []
     for test_name, test in test_list:
+        runs.append((test_name, test, compiler_flags))
+        if not options.run_ir and test_name.split('/')[1] in run_ir_folders and \
+                not [flag for flag in test.get('flags', []) if flag in output_format_flags]:
+            runs.append((test_name + " (-run-ir)", test, ['-run-ir']))
+
+    for test_name, test, run_flags in runs:
         if not test.has_key('source'):
             continue
         if not test.has_key('errors'):
@@ -138,7 +188,12 @@ def main():
         if options.verbose:
             sys.stdout.write(test_name + "...")
             sys.stdout.flush()
-        compiler = subprocess.Popen([compiler_exe], stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        flags = run_flags + test.get('flags', [])
+        interpret = execute_spim_code
+        if [flag for flag in flags if flag in output_format_flags]:
+            # the compiler's output is already what to check
+            interpret = lambda output: output
+        compiler = subprocess.Popen([compiler_exe] + flags, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
         stdout, stderr = compiler.communicate(test['source'])
         if compiler.returncode not in [0, 1]:
             if options.verbose:
@@ -168,9 +223,34 @@ def main():
             })
             if options.failfast:
                 break
+        elif [text for text in test.get('absent', []) if text in stdout]:
+            if options.verbose:
+                sys.stdout.write("fail\n")
+            else:
+                sys.stdout.write('F')
+            fails.append({
+                'unwanted': "".join([text + "\n" for text in test['absent'] if text in stdout]),
+                'name': test_name,
+                'crash': False,
+            })
+            if options.failfast:
+                break
+        elif test.has_key('no_larger_than') and interpret == execute_spim_code and \
+                assembly_size(stdout) > assembly_size(compile_source(compiler_exe, test['no_larger_than'], test['source'])):
+            if options.verbose:
+                sys.stdout.write("fail\n")
+            else:
+                sys.stdout.write('F')
+            fails.append({
+                'unwanted': "%i instructions, more than with %s\n" % (assembly_size(stdout), " ".join(test['no_larger_than'])),
+                'name': test_name,
+                'crash': False,
+            })
+            if options.failfast:
+                break
         elif compiler.returncode != 1:
             # compiler output correct, now test the generated code output
-            asm_output = interpret_command(stdout)
+            asm_output = interpret(stdout)
             if asm_output != test['out']:
                 if options.verbose:
                     sys.stdout.write("wrong\n")
@@ -204,7 +284,12 @@ def main():
             print("\n=========================================")
             for fail in fails:
                 print("Test name: %(name)s" % fail)
-                if 'expected_runout' in fail:
+                if 'unwanted' in fail:
+                    print("""\
+---- Compiler Output Has What It Shouldn't: ----
+%(unwanted)s\
+--------""" % fail)
+                elif 'expected_runout' in fail:
                     print("""\
 ---- Program Output: ----
 %(runout)s\
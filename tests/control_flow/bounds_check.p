@@ -0,0 +1,35 @@
+program Main;
+class Main begin
+    var data : array[1..10] of Integer;
+    var grid : array[0..3] of array[1..4] of Integer;
+    function Main;
+        var i : Integer;
+        var j : Integer;
+        var sum : Integer;
+    begin
+        i := 1;
+        while i <= 10 do begin
+            data[i] := i * 3;
+            i := i + 1
+        end;
+        sum := 0;
+        i := 0;
+        while i <= 3 do begin
+            j := 1;
+            while j <= 4 do begin
+                grid[i][j] := i + j;
+                sum := sum + grid[i][j] + data[i + j];
+                j := j + 1
+            end;
+            i := i + 1
+        end;
+        print sum;
+        i := 10;
+        while i >= 0 do begin
+            sum := sum - data[i];
+            i := i - 1
+        end;
+        print sum
+    end
+end
+.
@@ -0,0 +1,37 @@
+program Main;
+class Main begin
+    var total : Integer;
+    function Main;
+        var debug, verbose : Boolean;
+        var level, i, x : Integer;
+    begin
+        debug := false;
+        level := 2;
+        if level > 1 then
+            verbose := true
+        else
+            verbose := false;
+        x := 5;
+        if debug then begin
+            print 100;
+            x := 7
+        end;
+        if verbose and not debug then
+            x := x + level;
+        i := 0;
+        while i < 0 do begin
+            print i;
+            i := i + 1
+        end;
+        total := 0;
+        i := 0;
+        while i < x do begin
+            total := total + level;
+            i := i + 1
+        end;
+        print x;
+        print total;
+        print i
+    end
+end
+.
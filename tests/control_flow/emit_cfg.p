@@ -0,0 +1,16 @@
+program Main;
+class Main begin
+    function Main;
+        var i, sum : Integer;
+    begin
+        sum := 0;
+        i := 0;
+        while i < 10 do begin
+            if i mod 2 = 0 then
+                sum := sum + i;
+            i := i + 1
+        end;
+        print sum
+    end
+end
+.
@@ -0,0 +1,31 @@
+program Main;
+class Main begin
+    function compute(n : Integer) : Integer;
+        var a, b, c, d, i, sum : Integer;
+    begin
+        a := n * 3;
+        b := n;
+        if a > 10 then begin
+            c := b * 3 + 1;
+            d := 1
+        end else begin
+            c := a + 1;
+            d := 1
+        end;
+        print c;
+        print d + a;
+        sum := 0;
+        i := 0;
+        while i < n do begin
+            sum := sum + n * 3 + b * 3;
+            i := i + 1
+        end;
+        compute := sum + c
+    end;
+    function Main;
+    begin
+        print compute(4);
+        print compute(2)
+    end
+end
+.
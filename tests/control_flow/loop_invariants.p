@@ -0,0 +1,29 @@
+program Main;
+class Main begin
+    var n : Integer;
+    var k : Integer;
+    var data : array[1..10] of Integer;
+    function Main;
+        var i, j, sum : Integer;
+    begin
+        n := 10;
+        k := 3;
+        i := 1;
+        while i <= n do begin
+            data[i] := i * k + n;
+            i := i + 1;
+        end;
+        i := 1;
+        sum := 0;
+        while i <= n do begin
+            j := 1;
+            while j <= 3 do begin
+                sum := sum + data[i] * k;
+                j := j + 1
+            end;
+            i := i + 1;
+        end;
+        print sum;
+    end
+end
+.
@@ -0,0 +1,21 @@
+program Main;
+class Main begin
+    var data : array[1..10] of Integer;
+    function Main;
+        var i, sum : Integer;
+    begin
+        i := 1;
+        while i <= 10 do begin
+            data[i] := i * 3 + 1;
+            i := i + 1
+        end;
+        sum := 0;
+        i := 1;
+        while i <= 10 do begin
+            sum := sum + data[i] * 2;
+            i := i + 1
+        end;
+        print sum
+    end
+end
+.
@@ -0,0 +1,50 @@
+program Main;
+class Main begin
+    var n : Integer;
+    var k : Integer;
+    var grid : array[1..4] of array[1..4] of Integer;
+    function Main;
+        var i, j, m, sum, count : Integer;
+    begin
+        n := 4;
+        k := 7;
+        sum := 0;
+        count := 0;
+        i := 1;
+        while i <= n do begin
+            j := 1;
+            while j <= n do begin
+                grid[i][j] := i * 10 + j;
+                m := 1;
+                while m <= 2 do begin
+                    sum := sum + k * n + grid[i][j];
+                    m := m + 1
+                end;
+                j := j + 1
+            end;
+            j := 1;
+            while j <= 3 do begin
+                count := count + n * k;
+                j := j + 1
+            end;
+            i := i + 1
+        end;
+        print sum;
+        print count;
+        i := 1;
+        while i <= 3 do begin
+            j := 1;
+            while j <= 3 do begin
+                m := 1;
+                while m <= 3 do begin
+                    count := count + 1;
+                    m := m + 1
+                end;
+                j := j + 1
+            end;
+            i := i + 1
+        end;
+        print count;
+    end
+end
+.
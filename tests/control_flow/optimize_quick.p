@@ -0,0 +1,26 @@
+program Main;
+class Main begin
+    var data : array[0..9] of Integer;
+    function Main;
+        var i, a, b, sum : Integer;
+    begin
+        i := 0;
+        while i < 10 do begin
+            a := i * 4 + 1;
+            b := i * 4 + 1;
+            data[i] := a + b;
+            i := i + 1
+        end;
+        sum := 0;
+        i := 9;
+        while i >= 0 do begin
+            if data[i] > 20 then
+                sum := sum + data[i]
+            else
+                sum := sum - 1;
+            i := i - 1
+        end;
+        print sum
+    end
+end
+.
@@ -0,0 +1,19 @@
+program Main;
+class Main begin
+    var n : Integer;
+    var k : Integer;
+    function Main;
+        var i, sum : Integer;
+    begin
+        n := 10;
+        k := 3;
+        sum := 0;
+        i := 1;
+        while i <= n do begin
+            sum := sum + i * (k * n + 1);
+            i := i + 1
+        end;
+        print sum
+    end
+end
+.
@@ -0,0 +1,26 @@
+program Main;
+class Main begin
+    var total : Integer;
+    function Main;
+        var a, b, c, i : Integer;
+    begin
+        a := 6;
+        b := a * 7;
+        c := 6 * 7;
+        total := 0;
+        i := 0;
+        while i < 5 do begin
+            if b = c then
+                total := total + b
+            else
+                total := total - 1;
+            i := i + 1
+        end;
+        print total;
+        if total > 200 then
+            print a
+        else
+            print c;
+    end
+end
+.
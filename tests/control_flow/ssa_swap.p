@@ -0,0 +1,26 @@
+program Main;
+class Main begin
+    var i, s : Integer;
+    function f(n : Integer; m : Integer) : Integer;
+        var k, t : Integer;
+    begin
+        k := 1;
+        while n > 0 do begin
+            if k > n then k := k - n else k := k + n * m;
+            t := k;
+            k := m;
+            m := t;
+            n := n - 1
+        end;
+        f := k + m
+    end;
+    function Main;
+    begin
+        while i < 5 do begin
+            s := s + this.f(i, 2);
+            i := i + 1
+        end;
+        print s
+    end
+end
+.
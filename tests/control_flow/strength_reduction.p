@@ -0,0 +1,33 @@
+program Main;
+class Main begin
+    var data : array[0..11] of Integer;
+    function Main;
+        var i, j, sum : Integer;
+        var squares : array[1..10] of Integer;
+    begin
+        i := 10;
+        while i >= 1 do begin
+            squares[i] := i * i;
+            i := i - 1
+        end;
+        i := 0;
+        while i < 3 do begin
+            j := 0;
+            while j < 4 do begin
+                data[i * 4 + j] := squares[i + j + 1] - j;
+                j := j + 1
+            end;
+            i := i + 1
+        end;
+        sum := 0;
+        i := 0;
+        while i <= 11 do begin
+            sum := sum + data[i] * 2;
+            i := i + 2
+        end;
+        print sum;
+        print i;
+        print data[11]
+    end
+end
+.
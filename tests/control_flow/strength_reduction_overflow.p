@@ -0,0 +1,17 @@
+program Main;
+class Main begin
+    function Main;
+        var i, n, s : Integer;
+    begin
+        n := 1073742;
+        s := 0;
+        i := 0;
+        while i < n do begin
+            s := i * 2000;
+            i := i + 1000
+        end;
+        print i / 1000;
+        print s
+    end
+end
+.
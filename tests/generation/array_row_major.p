@@ -0,0 +1,57 @@
+program Main;
+class Main begin
+    var cube : array[1..3] of array[0..3] of array[2..4] of Integer;
+    var rows : array[5..6] of array[1..4] of Boolean;
+    function Main;
+        var i : Integer;
+        var j : Integer;
+        var k : Integer;
+        var sum : Integer;
+        var row : array[0..3] of array[2..4] of Integer;
+    begin
+        i := 1;
+        while i <= 3 do begin
+            j := 0;
+            while j <= 3 do begin
+                k := 2;
+                while k <= 4 do begin
+                    cube[i][j, k] := i * 100 + j * 10 + k;
+                    k := k + 1
+                end;
+                j := j + 1
+            end;
+            i := i + 1
+        end;
+        print cube[1, 0, 2];
+        print cube[3][3][4];
+        print cube[2, 1][3];
+
+        { a row is copied in, not shared }
+        cube[1] := cube[3];
+        cube[3, 2, 2] := 0;
+        print cube[1, 2, 2];
+        print cube[3, 2, 2];
+
+        { but reading a row out gives the row itself }
+        row := cube[2];
+        row[0, 4] := 7;
+        print cube[2, 0, 4];
+
+        sum := 0;
+        i := 1;
+        while i <= 3 do begin
+            j := 0;
+            while j <= 3 do begin
+                sum := sum + cube[i, j, 3];
+                j := j + 1
+            end;
+            i := i + 1
+        end;
+        print sum;
+
+        rows[5, 1] := true;
+        rows[6] := rows[5];
+        print rows[6, 1]
+    end
+end
+.
@@ -0,0 +1,41 @@
+program Main;
+class Main begin
+    var used : Used;
+    function Main;
+    begin
+        used := new Used;
+        print used.twice(21);
+    end;
+    function neverCalled;
+        var orphan : Orphan;
+    begin
+        orphan := new Orphan;
+        print 1;
+    end
+end
+class Used begin
+    var x : Integer;
+    function twice(n : Integer) : Integer;
+    begin
+        twice := n + n;
+    end;
+    function unusedHelper : Integer;
+    begin
+        unusedHelper := x;
+    end
+end
+class Library begin
+    var items : array[1..100] of Integer;
+    function Library;
+    begin
+        print 2;
+    end;
+    function size : Integer;
+    begin
+        size := 100;
+    end
+end
+class Orphan begin
+    var next : Orphan;
+end
+.
@@ -0,0 +1,55 @@
+program Main;
+class Main begin
+    var grid : array[1..3] of array[1..4] of Node;
+    var other : array[1..3] of array[1..4] of Node;
+    function Main;
+        var row : array[1..4] of Node;
+        var i : Integer;
+        var t : Node;
+    begin
+        i := 1;
+        while i <= 4 do begin
+            grid[2, i] := new Node;
+            grid[2, i].value := i * 11;
+            i := i + 1
+        end;
+        { the old grid is only reachable through the middle of it now }
+        row := grid[2];
+        grid := other;
+        i := 0;
+        while i < 30000 do begin
+            t := new Node;
+            t.value := i;
+            t.next := t;
+            i := i + 1
+        end;
+        print row[1].value + row[4].value;
+        print build(6)
+    end
+
+    function build(depth : Integer) : Integer;
+        var mine : Node;
+        var i : Integer;
+        var t : Node;
+    begin
+        mine := new Node;
+        mine.value := depth;
+        i := 0;
+        while i < 2000 do begin
+            t := new Node;
+            t.next := mine;
+            mine.next := t;
+            i := i + 1
+        end;
+        if depth > 0 then
+            build := build(depth - 1) + mine.value * 10 + t.next.value
+        else
+            build := mine.value
+    end
+end
+
+class Node begin
+    var value : Integer;
+    var next : Node;
+end
+.
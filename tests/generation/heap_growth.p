@@ -0,0 +1,44 @@
+program Main;
+class Main begin
+    function Main;
+        var i : Integer;
+        var sum : Integer;
+        var head : Node;
+        var node : Node;
+        var block : Block;
+    begin
+        head := new Node;
+        i := 1;
+        while i <= 6000 do begin
+            node := new Node;
+            node.value := i;
+            node.next := head;
+            head := node;
+            if i mod 2000 = 0 then begin
+                block := new Block;
+                block.data[5000] := i
+            end;
+            i := i + 1
+        end;
+        sum := 0;
+        i := 1;
+        node := head;
+        while i <= 6000 do begin
+            sum := sum + node.value;
+            node := node.next;
+            i := i + 1
+        end;
+        print sum;
+        print block.data[5000]
+    end
+end
+
+class Node begin
+    var value : Integer;
+    var next : Node;
+end
+
+class Block begin
+    var data : array[1..20000] of Integer;
+end
+.
@@ -0,0 +1,24 @@
+program Main;
+class Main begin
+    function Main;
+        var t : Table;
+    begin
+        t := new Table;
+        print t.first(3);
+        print t.second(4);
+        print t.second(11);
+    end
+end
+class Table begin
+    var data : array[1..10] of Integer;
+    function first(i : Integer) : Integer;
+    begin
+        first := data[i];
+    end;
+    function second(i : Integer) : Integer;
+    begin
+
+        second := data[i];
+    end
+end
+.
@@ -0,0 +1,60 @@
+program Main;
+class Main begin
+    function Main;
+        var p : Point;
+        var q : Point3;
+    begin
+        p := new Point;
+        p.setX(3);
+        p.setY(4);
+        print p.getX();
+        print p.getY();
+        q := new Point3;
+        q.setX(5);
+        q.setZ(6);
+        print q.getX();
+        print q.getZ();
+        print q.first();
+        print q.sum();
+    end
+end
+class Point begin
+    var x : Integer;
+    var y : Integer;
+    function getX : Integer;
+    begin
+        getX := x;
+    end;
+    function getY : Integer;
+    begin
+        getY := y;
+    end;
+    function setX(value : Integer);
+    begin
+        x := value;
+    end;
+    function setY(value : Integer);
+    begin
+        y := value;
+    end
+end
+class Point3 extends Point begin
+    var z : Integer;
+    function getZ : Integer;
+    begin
+        getZ := z;
+    end;
+    function setZ(value : Integer);
+    begin
+        z := value;
+    end;
+    function first : Integer;
+    begin
+        first := x;
+    end;
+    function sum : Integer;
+    begin
+        sum := x + y + z;
+    end
+end
+.
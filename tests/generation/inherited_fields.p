@@ -0,0 +1,52 @@
+program Main;
+class Main begin
+    var d : D;
+    function Main;
+        var i : Integer;
+        var t : A;
+    begin
+        d := new D;
+        d.x := 1;
+        d.y := 2;
+        d.z := 3;
+        d.w := 4;
+        d.values[3] := 30;
+        d.link := new A;
+        d.link.x := 77;
+        { the fields d inherits have to survive a collection }
+        i := 0;
+        while i < 20000 do begin
+            t := new A;
+            t.link := t;
+            i := i + 1
+        end;
+        print d.x * 1000 + d.y * 100 + d.z * 10 + d.w;
+        print d.values[3] + d.values[1];
+        print d.link.x;
+        print d.total()
+    end
+end
+
+class A begin
+    var x : Integer;
+    var link : A;
+end
+
+class B extends A begin
+    var y : Integer;
+    var values : array[1..3] of Integer;
+
+    function total : Integer;
+    begin
+        total := x + y + values[3]
+    end
+end
+
+class C extends B begin
+    var z : Integer;
+end
+
+class D extends C begin
+    var w : Integer;
+end
+.
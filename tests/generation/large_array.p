@@ -0,0 +1,34 @@
+program Main;
+class Main begin
+    var grid : Grid;
+    var other : Grid;
+    function Main;
+        var i : Integer;
+        var sum : Integer;
+    begin
+        grid := new Grid;
+        other := new Grid;
+        i := 1;
+        while i <= 100 do begin
+            grid.cells[i, i] := i;
+            grid.cells[i, 101 - i] := 1000;
+            other.cells[i][1] := 0 - i;
+            i := i + 1
+        end;
+        sum := 0;
+        i := 1;
+        while i <= 100 do begin
+            sum := sum + grid.cells[i, i] + other.cells[i, 1];
+            i := i + 1
+        end;
+        print sum;
+        print grid.cells[1, 100];
+        print grid.cells[100, 100];
+        print other.cells[100, 1]
+    end
+end
+
+class Grid begin
+    var cells : array[1..100] of array[1..100] of Integer;
+end
+.
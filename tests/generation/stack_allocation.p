@@ -0,0 +1,68 @@
+program Main;
+class Main begin
+    var keep : Node;
+    function Main;
+        var i, sum : Integer;
+        var counts : array[0..9] of Integer;
+        var t, prev : Node;
+        var box : Holder;
+    begin
+        { never leaves this method, so it lives in the frame }
+        i := 0;
+        while i < 100 do begin
+            counts[i mod 10] := counts[i mod 10] + i;
+            i := i + 1
+        end;
+        print counts[0] + counts[9];
+
+        { the holder is on the stack but what it points to is on the heap }
+        box := new Holder;
+        box.item := new Node;
+        box.item.value := 42;
+        i := 0;
+        while i < 20000 do begin
+            t := new Node;
+            t.next := t;
+            i := i + 1
+        end;
+        print box.item.value;
+
+        { the old node is still needed when the next one is made }
+        sum := 0;
+        prev := new Node;
+        i := 1;
+        while i <= 10 do begin
+            t := new Node;
+            t.value := i;
+            sum := sum + prev.value * 100 + t.value;
+            prev := t;
+            i := i + 1
+        end;
+        print sum;
+
+        { a fresh stack object starts out zeroed on every iteration }
+        i := 0;
+        sum := 0;
+        while i < 5 do begin
+            t := new Node;
+            sum := sum + t.value;
+            t.value := 7;
+            i := i + 1
+        end;
+        print sum;
+
+        keep := new Node;
+        keep.value := 9;
+        print keep.value
+    end
+end
+
+class Node begin
+    var value : Integer;
+    var next : Node;
+end
+
+class Holder begin
+    var item : Node;
+end
+.